@@ -0,0 +1,103 @@
+#!/bin/sh
+# Compile time of the compiler itself, phase by phase, on synthetic inputs.
+#
+# usage: bench/compile_bench.sh [compiler] [sysy_gen] [results]
+#
+# Every sysy_gen shape is compiled at three sizes (1x, 2x, 4x) with OPT
+# (default -O2), RUNS times each (default 5), keeping the minimum of every
+# number over the runs. Results go to `results` (default compile_bench.tsv)
+# as tab-separated "shape size phase value" rows in a fixed order: one row
+# per --time-report phase in ms, then total_ms and peak_rss_kb.
+#
+# The summary shows total ms per size and the growth of the time per unit
+# of size from 1x to 4x; much above 1 means the compiler is superlinear in
+# that shape. With BASELINE=<old results> every row of at least MIN_MS
+# (default 5) that got slower by more than THRESHOLD percent (default 10)
+# is listed, and the script exits with status 2.
+set -e
+
+COMPILER=${1:-build/compiler}
+GEN=${2:-build/sysy_gen}
+RESULTS=${3:-compile_bench.tsv}
+OPT=${OPT:--O2}
+RUNS=${RUNS:-5}
+THRESHOLD=${THRESHOLD:-10}
+MIN_MS=${MIN_MS:-5}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/compile_bench.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+# shape and size at 1x; nest stays under the parser's stack limit at 4x
+SHAPES="expr:1000 chain:500 funcs:1000 nest:200"
+
+# one --report-format=json line -> "phase<TAB>ms" rows, total_ms, peak_rss_kb
+rows() {
+  sed 's/},{/\n/g' "$1" | awk '
+    match($0, /"name":"[^"]*"/) {
+      name = substr($0, RSTART + 8, RLENGTH - 9)
+      match($0, /"ms":[0-9.]*/)
+      printf "%s\t%s\n", name, substr($0, RSTART + 5, RLENGTH - 5)
+    }
+    match($0, /"total_ms":[0-9.]*/) {
+      printf "total_ms\t%s\n", substr($0, RSTART + 11, RLENGTH - 11)
+    }
+    match($0, /"peak_rss_kb":[0-9]*/) {
+      printf "peak_rss_kb\t%s\n", substr($0, RSTART + 14, RLENGTH - 14)
+    }'
+}
+
+: > "$WORK/results"
+for entry in $SHAPES; do
+  shape=${entry%:*}
+  for scale in 1 2 4; do
+    size=$((${entry#*:} * scale))
+    "$GEN" "$shape" "$size" > "$WORK/input.c"
+    : > "$WORK/runs"
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+      "$COMPILER" -koopa "$WORK/input.c" -o "$WORK/out.koopa" $OPT \
+        --time-report --report-format=json 2> "$WORK/report" ||
+        { echo "$shape $size: compile failed" >&2; cat "$WORK/report" >&2; exit 1; }
+      rows "$WORK/report" >> "$WORK/runs"
+      i=$((i + 1))
+    done
+    awk -F'\t' -v shape="$shape" -v size="$size" '
+      !($1 in best) { order[n++] = $1; best[$1] = $2 }
+      $2 < best[$1] { best[$1] = $2 }
+      END {
+        for (i = 0; i < n; i++) print shape "\t" size "\t" order[i] "\t" best[order[i]]
+      }' "$WORK/runs" >> "$WORK/results"
+  done
+done
+cp "$WORK/results" "$RESULTS"
+
+echo "compile time ($OPT, min of $RUNS runs), per-phase rows in $RESULTS"
+awk -F'\t' '
+  $3 == "total_ms" {
+    if (!($1 in first)) { order[n++] = $1; first[$1] = $4 / $2 }
+    line[$1] = line[$1] sprintf(" %8d: %9.1f ms", $2, $4)
+    last[$1] = $4 / $2
+  }
+  END {
+    for (i = 0; i < n; i++) {
+      s = order[i]
+      growth = first[s] > 0 ? last[s] / first[s] : 0
+      printf "%-6s%s   growth %.2f\n", s, line[s], growth
+    }
+  }' "$RESULTS"
+
+if [ -n "$BASELINE" ]; then
+  awk -F'\t' -v limit="$THRESHOLD" -v floor="$MIN_MS" '
+    NR == FNR { old[$1 "\t" $2 "\t" $3] = $4; next }
+    $3 != "peak_rss_kb" && ($1 "\t" $2 "\t" $3) in old {
+      before = old[$1 "\t" $2 "\t" $3]
+      if (before >= floor && $4 > before * (1 + limit / 100)) {
+        printf "slower: %s %s %s %.1f -> %.1f ms (+%.0f%%)\n", $1, $2, $3,
+               before, $4, 100 * ($4 / before - 1)
+        slower++
+      }
+    }
+    END {
+      if (slower) exit 2
+      print "no regression over " limit "% against the baseline"
+    }' "$BASELINE" "$RESULTS"
+fi
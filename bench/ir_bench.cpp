@@ -0,0 +1,165 @@
+// Walks and rewrites a synthetic module of about a million instructions,
+// once as the IRList the passes use today and once as a CompactModule.
+//
+// usage: ir_bench [instructions] [runs]
+//
+// walk:    visit every operand, count variables and sum immediates
+// rewrite: turn `mul x, 2` into `sal x, 1` and rename one value in every
+//          function, the two kinds of edit passes make most
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include "compact_ir.h"
+#include "ir.h"
+
+using namespace std;
+using namespace ir;
+
+namespace {
+const int FUNCTION_SIZE = 1000;
+
+IRList makeModule(size_t size) {
+  IRList irs;
+  for (int f = 0; irs.size() < size; f++) {
+    irs.push_back(IR(OpCode::FUNCTION_BEGIN,
+                     "fun @f" + to_string(f) + "(%a: i32, %p: *i32): i32 {"));
+    for (int k = 0; k < FUNCTION_SIZE / 8; k++) {
+      string t = "%" + to_string(k);
+      string block = "%_b_" + to_string(k);
+      irs.push_back(IR(OpCode::LABEL, block));
+      irs.push_back(IR(OpCode::LOAD, OpName(t + "_l"), OpName("%p"), OpName(k * 4)));
+      irs.push_back(IR(OpCode::ADD, OpName(t), OpName(t + "_l"), OpName("%a")));
+      irs.push_back(IR(OpCode::MUL, OpName(t + "_m"), OpName(t), OpName(2)));
+      irs.push_back(IR(OpCode::SUB, OpName(t + "_s"), OpName(t + "_m"), OpName(1 << 30)));
+      irs.push_back(IR(OpCode::STORE, OpName(), OpName("@g"), OpName(k * 4), OpName(t + "_s")));
+      irs.push_back(IR(OpCode::cmp, OpName(), OpName(t + "_s"), OpName(0)));
+      irs.push_back(IR(OpCode::JLT, "%_b_" + to_string(k + 1)));
+    }
+    irs.push_back(IR(OpCode::RET, OpName(), OpName("%a")));
+    irs.push_back(IR(OpCode::FUNCTION_END, "}"));
+  }
+  return irs;
+}
+
+double bestMs(int runs, const function<void()>& setup, const function<void()>& body) {
+  double best = 1e300;
+  for (int r = 0; r < runs; r++) {
+    setup();
+    auto start = chrono::steady_clock::now();
+    body();
+    chrono::duration<double, milli> ms = chrono::steady_clock::now() - start;
+    best = min(best, ms.count());
+  }
+  return best;
+}
+
+// --- IRList ---
+
+long walkList(const IRList& irs) {
+  long vars = 0, imms = 0;
+  for (auto& ir : irs) {
+    ir.forEachOp([&](const OpName& op) {
+      if (op.is_var()) vars++;
+      else if (op.is_imm()) imms += op.value;
+    });
+  }
+  return vars + imms;
+}
+
+void rewriteList(IRList& irs) {
+  for (auto& ir : irs) {
+    if (ir.op_code == OpCode::MUL && ir.op2.is_imm() && ir.op2.value == 2) {
+      ir.op_code = OpCode::SAL;
+      ir.op2 = OpName(1);
+    }
+    for (OpName* op : {&ir.dest, &ir.op1, &ir.op2, &ir.op3}) {
+      if (op->is_var() && op->name == "%a") op->name = "%arg";
+    }
+  }
+}
+
+// --- CompactModule ---
+
+long walkCompact(const CompactModule& m) {
+  long vars = 0, imms = 0;
+  for (auto& inst : m.insts) {
+    for (int k = 0; k < 4; k++) {
+      Operand op = inst.operand(k);
+      if (op.isValue()) vars++;
+      else if (op.isImm()) imms += m.immValue(op);
+    }
+  }
+  return vars + imms;
+}
+
+void rewriteCompact(CompactModule& m) {
+  Operand two = m.imm(2), one = m.imm(1);
+  Operand from = m.value("%a"), to = m.value("%arg");
+  for (auto& inst : m.insts) {
+    if (inst.op_code == OpCode::MUL && inst.op2 == two) {
+      inst.op_code = OpCode::SAL;
+      inst.op2 = one;
+    }
+    for (int k = 0; k < 4; k++) {
+      if (inst.operand(k) == from) inst.operand(k) = to;
+    }
+  }
+}
+
+string text(const IRList& irs) {
+  ostringstream oss;
+  for (auto& ir : irs) ir.print(oss);
+  return oss.str();
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t size = argc > 1 ? atol(argv[1]) : 1000000;
+  int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+  const IRList original = makeModule(size);
+  const CompactModule compact_original = CompactModule::fromList(original);
+  size_t n = original.size();
+
+  IRList list;
+  CompactModule compact;
+  long list_sum = 0, compact_sum = 0;
+  double list_walk = bestMs(runs, [] {}, [&] { list_sum = walkList(original); });
+  double compact_walk =
+      bestMs(runs, [] {}, [&] { compact_sum = walkCompact(compact_original); });
+  double list_rewrite =
+      bestMs(runs, [&] { list = original; }, [&] { rewriteList(list); });
+  double compact_rewrite = bestMs(
+      runs, [&] { compact = compact_original; }, [&] { rewriteCompact(compact); });
+
+  if (list_sum != compact_sum || text(list) != text(compact.toList())) {
+    fprintf(stderr, "ir_bench: IRList and CompactModule disagree\n");
+    return 1;
+  }
+
+  // a list node is the IR plus two pointers; strings are counted by capacity
+  size_t list_bytes = 0;
+  for (auto& ir : original) {
+    list_bytes += sizeof(IR) + 2 * sizeof(void*);
+    for (auto* op : {&ir.dest, &ir.op1, &ir.op2, &ir.op3}) {
+      if (op->name.capacity() > 15) list_bytes += op->name.capacity() + 1;
+    }
+    if (ir.label.capacity() > 15) list_bytes += ir.label.capacity() + 1;
+  }
+
+  printf("%zu instructions, %zu functions, best of %d runs\n", n,
+         compact_original.functions.size(), runs);
+  printf("%-16s %12s %12s\n", "", "IRList", "Compact");
+  printf("%-16s %12zu %12zu\n", "bytes/inst", sizeof(IR) + 2 * sizeof(void*),
+         sizeof(Inst));
+  printf("%-16s %12.1f %12.1f\n", "module MB", list_bytes / 1e6,
+         compact_original.memoryBytes() / 1e6);
+  printf("%-16s %12.2f %12.2f\n", "walk ns/inst", list_walk * 1e6 / n,
+         compact_walk * 1e6 / n);
+  printf("%-16s %12.2f %12.2f\n", "rewrite ns/inst", list_rewrite * 1e6 / n,
+         compact_rewrite * 1e6 / n);
+  return 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/sh
+# Lexing throughput of the Flex lexer vs the hand-written one (--lexer=hand).
+#
+# usage: bench/lex_bench.sh [compiler] [size-in-MB] [runs]
+#
+# Generates a synthetic SysY file of the given size (identifiers, keywords,
+# decimal/octal/hex literals, every operator, both comment styles), lexes it
+# with each lexer `runs` times via --lex-only and prints the best MB/s.
+set -e
+
+COMPILER=${1:-build/compiler}
+SIZE_MB=${2:-32}
+RUNS=${3:-5}
+INPUT=${TMPDIR:-/tmp}/lex_bench_$$.c
+trap 'rm -f "$INPUT"' EXIT
+
+awk -v bytes=$((SIZE_MB * 1000000)) 'BEGIN {
+  n = 0
+  while (n < bytes) {
+    f = sprintf("int func_%d(int a, int b_%d[]) {\n", n, n)
+    f = f "  // line comment with <= and && inside\n"
+    f = f "  int counter = 0x1F + 017 * 42, total_sum = a;\n"
+    f = f "  /* block comment\n   * spanning ** lines */\n"
+    f = f "  while (counter <= 100 && total_sum != 0 || !a) {\n"
+    f = f "    if (counter % 3 == 0) total_sum = total_sum - b_" n "[counter / 2];\n"
+    f = f "    else if (counter >= 50) { counter = counter + 1; continue; }\n"
+    f = f "    else break;\n"
+    f = f "    counter = counter + (a > 7) * (total_sum < -1);\n"
+    f = f "  }\n  return total_sum;\n}\n\n"
+    printf "%s", f
+    n += length(f)
+  }
+}' > "$INPUT"
+
+best() {
+  lexer=$1
+  i=0
+  while [ $i -lt "$RUNS" ]; do
+    "$COMPILER" -koopa "$INPUT" --lex-only --lexer="$lexer" 2>&1 |
+      sed -n 's/.* \([0-9.]*\) MB\/s.*/\1/p'
+    i=$((i + 1))
+  done | sort -n | tail -1
+}
+
+FLEX=$(best flex)
+HAND=$(best hand)
+echo "input: $SIZE_MB MB, best of $RUNS runs"
+echo "flex: $FLEX MB/s"
+echo "hand: $HAND MB/s"
+awk -v f="$FLEX" -v h="$HAND" 'BEGIN { printf "speedup: %.2fx\n", h / f }'
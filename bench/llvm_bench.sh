@@ -0,0 +1,89 @@
+#!/bin/sh
+# Runtime of our output against a native toolchain on the same machine.
+#
+# usage: bench/llvm_bench.sh [compiler] [inputs...]
+#
+# Each input (a .c/.sy file, or a directory of them) is optimized by our
+# compiler (OPT, default -O2) and emitted with -llvm, then built by clang
+# (CLANG, default clang++) at -O0 and -O2 and linked against bench/sylib.cpp.
+# Every build runs once per RUNS (default 3) with <name>.in on stdin when
+# it exists; the table shows the best wall time in ms, next to -jit on the
+# same optimized IR. The exit status and output must agree across all of
+# them, or the row is marked MISMATCH.
+#
+# clang -O0 shows what our optimizer alone buys, clang -O2 is the native
+# baseline for our optimizer and backend.
+set -e
+
+COMPILER=${1:-build/compiler}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] || set -- hello.c
+OPT=${OPT:--O2}
+CLANG=${CLANG:-clang++}
+RUNS=${RUNS:-3}
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/llvm_bench.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+"$CLANG" -O2 -std=c++17 -I"$TOP/src" -c "$TOP/bench/sylib.cpp" -o "$WORK/sylib.o"
+"$CLANG" -O2 -std=c++17 -I"$TOP/src" -c "$TOP/src/runtime.cpp" -o "$WORK/runtime.o"
+
+now_ns() { date +%s%N; }
+
+# best_ms <out-file> <input> <command...>: runs the command RUNS times,
+# prints the best wall time and leaves "status + stdout" of the last run
+best_ms() {
+  out=$1 in=$2
+  shift 2
+  best=
+  i=0
+  while [ $i -lt "$RUNS" ]; do
+    start=$(now_ns)
+    set +e
+    "$@" < "$in" > "$out" 2> /dev/null
+    status=$?
+    set -e
+    end=$(now_ns)
+    echo "status $status" >> "$out"
+    ms=$(( (end - start) / 1000000 ))
+    if [ -z "$best" ] || [ $ms -lt $best ]; then best=$ms; fi
+    i=$((i + 1))
+  done
+  echo $best
+}
+
+bench_one() {
+  src=$1
+  name=$(basename "${src%.*}")
+  in=${src%.*}.in
+  [ -f "$in" ] || in=/dev/null
+  ll=$WORK/$name.ll
+  if ! "$COMPILER" -llvm "$src" -o "$ll" $OPT 2> "$WORK/err"; then
+    printf '%-24s %s\n' "$name" "compile failed: $(head -1 "$WORK/err")"
+    return
+  fi
+  row=
+  for level in -O0 -O2; do
+    exe=$WORK/$name$level
+    "$CLANG" $level "$ll" "$WORK/sylib.o" "$WORK/runtime.o" -lpthread -o "$exe" 2> /dev/null ||
+      { printf '%-24s %s\n' "$name" "clang $level failed"; return; }
+    row="$row $(best_ms "$WORK/out$level" "$in" "$exe")"
+  done
+  row="$row $(best_ms "$WORK/out-jit" "$in" "$COMPILER" -jit "$src" $OPT)"
+  verdict=
+  cmp -s "$WORK/out-O0" "$WORK/out-O2" && cmp -s "$WORK/out-O2" "$WORK/out-jit" ||
+    verdict=MISMATCH
+  set -- $row
+  printf '%-24s %10s %10s %10s  %s\n' "$name" "$1" "$2" "$3" "$verdict"
+}
+
+printf '%-24s %10s %10s %10s\n' "program ($OPT)" "clang -O0" "clang -O2" "-jit"
+for arg in "$@"; do
+  if [ -d "$arg" ]; then
+    for src in "$arg"/*.c "$arg"/*.sy; do
+      [ -f "$src" ] && bench_one "$src"
+    done
+  else
+    bench_one "$arg"
+  fi
+done
@@ -0,0 +1,135 @@
+#!/bin/sh
+# Runtime of the programs we compile, at each optimization level.
+#
+# usage: bench/run_bench.sh <compiler> <dir> [results]
+#
+# Every <name>.c/.sy in dir is compiled at each of LEVELS (default
+# "-O0 -O1 -O2") and run by each of EXECUTORS (default "run jit"), RUNS
+# times (default 3), with <name>.in on stdin when it exists. Its stdout
+# followed by the exit status on a line of its own must match <name>.out
+# when that exists, as in the SysY test suites.
+#
+# The time is the one the program reports between starttime() and
+# stoptime() (the TOTAL line on stderr), minimum over the runs; a program
+# that never calls stoptime gets its wall time instead, without the front
+# end and optimizer, which run once beforehand (--save-ir). Rows go to
+# `results` (default run_bench.tsv) as tab-separated
+# "program level executor us timer|wall ok|wrong|failed".
+#
+# Executors:
+#   run    the interpreter (-run)
+#   jit    the x86-64 JIT (-jit)
+#
+# There is no RISC-V executor: -riscv does not emit RISC-V assembly yet.
+#
+# With BASELINE=<old results> every row of at least MIN_US (default 1000)
+# that got slower by more than THRESHOLD percent (default 5) is listed and
+# the script exits with status 2. Wrong output or a failed run exits 1.
+set -e
+
+if [ $# -lt 2 ] || [ ! -d "$2" ]; then
+  echo "usage: $0 <compiler> <dir> [results]" >&2
+  exit 1
+fi
+COMPILER=$1
+DIR=$2
+RESULTS=${3:-run_bench.tsv}
+LEVELS=${LEVELS:--O0 -O1 -O2}
+EXECUTORS=${EXECUTORS:-run jit}
+RUNS=${RUNS:-3}
+THRESHOLD=${THRESHOLD:-5}
+MIN_US=${MIN_US:-1000}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/run_bench.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+for executor in $EXECUTORS; do
+  case $executor in
+    run | jit) ;;
+    *) echo "unknown executor '$executor' (run, jit)" >&2; exit 1 ;;
+  esac
+done
+
+now_us() { echo $(($(date +%s%N) / 1000)); }
+
+# the TOTAL line the SysY runtime prints at exit, in microseconds
+timer_us() {
+  sed -n 's/^TOTAL: \([0-9]*\)H-\([0-9]*\)M-\([0-9]*\)S-\([0-9]*\)us$/\1 \2 \3 \4/p' "$1" |
+    awk '{ print (($1 * 60 + $2) * 60 + $3) * 1000000 + $4 }'
+}
+
+# build <executor> <level> <src>: leaves the command to run in $command
+build() {
+  case $1 in
+    run | jit)
+      "$COMPILER" -koopa "$3" -o "$WORK/prog.koopa" $2 --save-ir 2> "$WORK/err" || return 1
+      command="$COMPILER -$1 $WORK/prog.koopa.sir"
+      ;;
+  esac
+}
+
+: > "$RESULTS"
+failures=0
+for src in "$DIR"/*.c "$DIR"/*.sy; do
+  [ -f "$src" ] || continue
+  name=$(basename "${src%.*}")
+  input=${src%.*}.in
+  [ -f "$input" ] || input=/dev/null
+  expected=${src%.*}.out
+  for level in $LEVELS; do
+    for executor in $EXECUTORS; do
+      if ! build "$executor" "$level" "$src"; then
+        verdict=failed best=0 clock=wall
+        echo "$name $level $executor: build failed: $(head -1 "$WORK/err")" >&2
+      else
+        verdict=ok best=
+        i=0
+        while [ $i -lt "$RUNS" ]; do
+          start=$(now_us)
+          set +e
+          $command < "$input" > "$WORK/stdout" 2> "$WORK/stderr"
+          status=$?
+          set -e
+          end=$(now_us)
+          us=$(timer_us "$WORK/stderr")
+          clock=timer
+          [ -n "$us" ] || { us=$((end - start)); clock=wall; }
+          if [ -z "$best" ] || [ "$us" -lt "$best" ]; then best=$us; fi
+          i=$((i + 1))
+        done
+        if [ -f "$expected" ]; then
+          { cat "$WORK/stdout"
+            [ -s "$WORK/stdout" ] && [ "$(tail -c 1 "$WORK/stdout")" != "" ] && echo
+            echo "$status"; } > "$WORK/actual"
+          diff -q -Z -B "$WORK/actual" "$expected" > /dev/null || verdict=wrong
+        elif grep -q '^run: ' "$WORK/stderr"; then
+          verdict=failed
+        fi
+      fi
+      [ "$verdict" = ok ] || failures=$((failures + 1))
+      printf '%s\t%s\t%s\t%s\t%s\t%s\n' "$name" "$level" "$executor" "$best" \
+        "$clock" "$verdict" >> "$RESULTS"
+      printf '%-24s %4s %-6s %12s us %-6s %s\n' "$name" "$level" "$executor" "$best" \
+        "$clock" "$verdict"
+    done
+  done
+done
+
+regressed=0
+if [ -n "$BASELINE" ]; then
+  awk -F'\t' -v limit="$THRESHOLD" -v floor="$MIN_US" '
+    NR == FNR { old[$1 "\t" $2 "\t" $3] = $4; next }
+    ($1 "\t" $2 "\t" $3) in old && $6 == "ok" {
+      before = old[$1 "\t" $2 "\t" $3]
+      if (before >= floor && $4 > before * (1 + limit / 100)) {
+        printf "slower: %s %s %s %d -> %d us (+%.1f%%)\n", $1, $2, $3, before,
+               $4, 100 * ($4 / before - 1)
+        slower++
+      }
+    }
+    END {
+      if (slower) exit 2
+      print "no regression over " limit "% against the baseline"
+    }' "$BASELINE" "$RESULTS" || regressed=1
+fi
+[ $failures -eq 0 ] || { echo "$failures runs with wrong output or failed" >&2; exit 1; }
+[ $regressed -eq 0 ] || exit 2
@@ -0,0 +1,31 @@
+// The SysY library for programs built from -llvm output by clang: the C
+// symbols the Koopa declarations name (IR_DUMP::libFuncDecls), on top of the
+// runtime -run and -jit use, so all three print the same output and timers.
+#include <cstdint>
+#include <cstdio>
+#include "runtime.h"
+
+extern "C" {
+int32_t getint() { return runtime::getint(); }
+int32_t getch() { return runtime::getch(); }
+int32_t getarray(int32_t* a) {
+  int32_t n = runtime::getint();
+  for (int32_t i = 0; i < n; i++) a[i] = runtime::getint();
+  return n;
+}
+void putint(int32_t v) { runtime::putint(v); }
+void putch(int32_t c) { runtime::putch(c); }
+void putarray(int32_t n, int32_t* a) { runtime::putarray(n, a); }
+void starttime() { runtime::starttime(); }
+void stoptime() { runtime::stoptime(); }
+}
+
+namespace {
+// the SysY library prints the timers once main has returned
+struct ReportAtExit {
+  ~ReportAtExit() {
+    fflush(stdout);
+    runtime::reportTimers();
+  }
+} report_at_exit;
+}  // namespace
@@ -0,0 +1,107 @@
+// Writes a synthetic SysY program of a given shape and size to stdout, for
+// timing the compiler on inputs far larger than anything hand-written.
+//
+// usage: sysy_gen <shape> <size> [seed]
+//
+// expr:  one balanced expression tree of <size> leaves
+// chain: one && / || chain of <size> comparisons
+// funcs: <size> small functions besides main
+// nest:  parentheses and unary operators nested <size> deep; the parser's
+//        stack runs out a little under 800
+//
+// The front end only takes `return <expression>;` as a function body, so
+// these are the shapes that scale; the output is the same for a given seed.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+namespace {
+uint64_t state;
+
+// small values only: constant folding must not overflow, and / and % stay
+// out so nothing divides by zero
+int next(int bound) {
+  state = state * 6364136223846793005ull + 1442695040888963407ull;
+  return int((state >> 33) % bound);
+}
+
+void leaf(string& out) {
+  out += to_string(next(10));
+}
+
+void tree(string& out, long leaves) {
+  static const char* const OPS[] = {" + ", " - ", " * ", " < ", " == ", " >= "};
+  if (leaves == 1) {
+    leaf(out);
+    return;
+  }
+  out += '(';
+  tree(out, leaves / 2);
+  out += OPS[next(6)];
+  tree(out, leaves - leaves / 2);
+  out += ')';
+}
+
+void expr(long size) {
+  string body;
+  tree(body, size);
+  printf("int main() {\n  return %s;\n}\n", body.c_str());
+}
+
+void chain(long size) {
+  printf("int main() {\n  return ");
+  for (long k = 0; k < size; k++) {
+    if (k) printf(next(3) ? " && " : " || ");
+    if (k % 8 == 7) printf("\n    ");
+    printf("%d < %d", next(10), next(10));
+  }
+  printf(";\n}\n");
+}
+
+void funcs(long size) {
+  for (long k = 0; k < size; k++) {
+    printf("int f%ld() {\n  return %d * %d + (%d < %d) - !%d;\n}\n", k, next(10),
+           next(10), next(10), next(10), next(2));
+  }
+  printf("int main() {\n  return 0;\n}\n");
+}
+
+void nest(long size) {
+  static const char* const PREFIXES[] = {"(", "-(", "!(", "+("};
+  static const char* const OPS[] = {" + ", " * ", " - ", " != "};
+  string open, close;
+  for (long k = 0; k < size; k++) {
+    open += PREFIXES[next(4)];
+    open += to_string(next(10));
+    open += OPS[next(4)];
+    close += ')';
+  }
+  printf("int main() {\n  return %s1%s;\n}\n", open.c_str(), close.c_str());
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3 || atol(argv[2]) <= 0) {
+    fprintf(stderr, "usage: sysy_gen expr|chain|funcs|nest <size> [seed]\n");
+    return 1;
+  }
+  state = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1;
+  long size = atol(argv[2]);
+  const char* shape = argv[1];
+  if (strcmp(shape, "expr") == 0) {
+    expr(size);
+  } else if (strcmp(shape, "chain") == 0) {
+    chain(size);
+  } else if (strcmp(shape, "funcs") == 0) {
+    funcs(size);
+  } else if (strcmp(shape, "nest") == 0) {
+    nest(size);
+  } else {
+    fprintf(stderr, "sysy_gen: unknown shape '%s'\n", shape);
+    return 1;
+  }
+  return 0;
+}
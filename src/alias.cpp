@@ -0,0 +1,115 @@
+#include "alias.h"
+
+namespace ir {
+bool MemLoc::operator==(const MemLoc& other) const {
+  return base == other.base && index == other.index && disp == other.disp;
+}
+
+AliasAnalysis::AliasAnalysis(const Function& func) {
+  for (auto it = func.begin; it != func.end; it++) {
+    if (it->op_code == OpCode::MALLOC_IN_STACK) {
+      stack_arrays.insert(it->dest.name);
+    }
+  }
+  // the base operand of a memory access is the only non-escaping use
+  for (auto it = func.begin; it != func.end; it++) {
+    bool is_mem = it->op_code == OpCode::LOAD || it->op_code == OpCode::STORE;
+    for (auto op : {&it->op1, &it->op2, &it->op3}) {
+      if (!op->is_var() || !stack_arrays.count(op->name)) continue;
+      if (is_mem && op == &it->op1) continue;
+      escaped.insert(op->name);
+    }
+  }
+
+  // the definitions of this block that still hold: redefining a name drops
+  // its own entry and those of every definition that read it
+  unordered_map<string, const IR*> defs;
+  for (auto it = func.begin; it != func.end; it++) {
+    if (it->op_code == OpCode::LABEL) defs.clear();
+    if (it->op_code == OpCode::LOAD || it->op_code == OpCode::STORE) {
+      MemLoc& loc = locations[&*it];
+      loc.base = it->op1;
+      decompose(it->op2, defs, loc.index, loc.disp);
+    }
+    if (it->dest.is_var()) {
+      auto& name = it->dest.name;
+      for (auto d = defs.begin(); d != defs.end();) {
+        const IR& def = *d->second;
+        bool stale = d->first == name || def.op1 == it->dest || def.op2 == it->dest;
+        d = stale ? defs.erase(d) : std::next(d);
+      }
+      if (!(it->op1 == it->dest) && !(it->op2 == it->dest)) defs[name] = &*it;
+    }
+    if (isTerminator(it->op_code)) defs.clear();
+  }
+}
+
+void AliasAnalysis::decompose(const OpName& offset,
+                              const unordered_map<string, const IR*>& defs,
+                              string& index, int& disp) {
+  index = "";
+  disp = 0;
+  if (offset.is_null()) return;
+  OpName cur = offset;
+  for (int depth = 0; depth < 8; depth++) {
+    int c;
+    if (cur.get_const(c)) {
+      disp += c;
+      return;
+    }
+    auto def = defs.find(cur.name);
+    if (def == defs.end()) break;
+    const IR& ir = *def->second;
+    int c1, c2;
+    bool k1 = ir.op1.get_const(c1), k2 = ir.op2.get_const(c2);
+    if (ir.op_code == OpCode::ADD && k2 && !k1 && !(ir.op1 == cur)) {
+      disp += c2;
+      cur = ir.op1;
+    } else if (ir.op_code == OpCode::ADD && k1 && !k2 && !(ir.op2 == cur)) {
+      disp += c1;
+      cur = ir.op2;
+    } else if (ir.op_code == OpCode::SUB && k2 && !k1 && !(ir.op1 == cur)) {
+      disp -= c2;
+      cur = ir.op1;
+    } else {
+      break;
+    }
+  }
+  index = cur.name;
+}
+
+MemLoc AliasAnalysis::location(const IR& ir) const {
+  auto it = locations.find(&ir);
+  if (it != locations.end()) return it->second;
+  MemLoc loc;
+  loc.base = ir.op1;
+  decompose(ir.op2, {}, loc.index, loc.disp);
+  return loc;
+}
+
+bool AliasAnalysis::isStackArray(const OpName& base) const {
+  return base.is_var() && stack_arrays.count(base.name);
+}
+
+bool AliasAnalysis::escapes(const OpName& base) const {
+  return base.is_var() && escaped.count(base.name);
+}
+
+bool AliasAnalysis::visibleToCalls(const MemLoc& loc) const {
+  return !isStackArray(loc.base) || escapes(loc.base);
+}
+
+AliasResult AliasAnalysis::alias(const MemLoc& a, const MemLoc& b) const {
+  if (a.base == b.base) {
+    if (a.index != b.index) return AliasResult::MayAlias;
+    return a.disp == b.disp ? AliasResult::MustAlias : AliasResult::NoAlias;
+  }
+  bool a_object = a.base.is_global_var() || isStackArray(a.base);
+  bool b_object = b.base.is_global_var() || isStackArray(b.base);
+  if (a_object && b_object) return AliasResult::NoAlias;
+  // an unknown pointer can only reach stack arrays whose address escaped
+  if (!visibleToCalls(a) || !visibleToCalls(b)) return AliasResult::NoAlias;
+  return AliasResult::MayAlias;
+}
+
+}  // namespace ir
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "cfg.h"
+#include "ir.h"
+
+using namespace std;
+namespace ir {
+    enum class AliasResult {
+        NoAlias,
+        MayAlias,
+        MustAlias,
+    };
+
+    // The address touched by a LOAD (op1[op2]) or STORE (op1[op2] = op3).
+    // The offset is split into a symbolic part and a constant displacement so
+    // that a[i] and a[i + 1] are known to be distinct.
+    struct MemLoc {
+        OpName base;
+        string index;  // "" when the offset is a constant
+        int disp;
+        bool operator==(const MemLoc& other) const;
+    };
+
+    // Intra-procedural alias analysis over one function. Globals (@x) and
+    // stack arrays (dest of MALLOC_IN_STACK) are distinct objects; any other
+    // base (pointer params, computed addresses) may point anywhere except into
+    // a stack array whose address never escapes.
+    //
+    // Offsets are decomposed at each access when the analysis is built, by
+    // following definitions earlier in the same block whose operands have not
+    // been redefined since; the IR is not SSA, so anything further away may
+    // no longer hold what its definition computed.
+    class AliasAnalysis {
+        public:
+            AliasAnalysis(const Function& func);
+            // the location of a LOAD or STORE of the function, as it was when
+            // the analysis was built
+            MemLoc location(const IR& ir) const;
+            AliasResult alias(const MemLoc& a, const MemLoc& b) const;
+            bool isStackArray(const OpName& base) const;
+            bool escapes(const OpName& base) const;
+            // true if a call to an unknown function may read or write loc
+            bool visibleToCalls(const MemLoc& loc) const;
+
+        private:
+            unordered_map<const IR*, MemLoc> locations;
+            unordered_set<string> stack_arrays;
+            unordered_set<string> escaped;
+            // defs: the definitions usable at the access, by name
+            static void decompose(const OpName& offset,
+                                  const unordered_map<string, const IR*>& defs,
+                                  string& index, int& disp);
+    };
+}  // namespace ir
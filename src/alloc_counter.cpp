@@ -0,0 +1,105 @@
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include "config.h"
+#include "stats.h"
+
+// Replaces the global operator new so --mem-report can count allocations.
+// Without --mem-report nothing is counted. With it, each thread counts into
+// its own counters, which only it writes, so threads never contend for a
+// cache line; allocations() sums them over the live threads and those that
+// have exited.
+
+namespace {
+struct Counters {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> bytes{0};
+  bool registered = false;
+  Counters* next = nullptr;
+};
+
+// trivially destructible, so counting stays safe while the thread exits
+thread_local Counters counters;
+
+std::mutex threads_mutex;
+Counters* threads = nullptr;  // the live threads that have allocated
+uint64_t exited_count = 0, exited_bytes = 0;
+
+// links the thread's counters in on its first allocation and folds them into
+// the exited totals when it ends
+struct Registration {
+  Registration() {
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    counters.next = threads;
+    threads = &counters;
+  }
+  ~Registration() {
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    for (Counters** p = &threads; *p; p = &(*p)->next) {
+      if (*p != &counters) continue;
+      *p = counters.next;
+      break;
+    }
+    exited_count += counters.count.load(std::memory_order_relaxed);
+    exited_bytes += counters.bytes.load(std::memory_order_relaxed);
+  }
+};
+
+void count(std::size_t size) {
+  if (!counters.registered) {
+    counters.registered = true;
+    thread_local Registration registration;
+  }
+  // only this thread writes its counters: no read-modify-write needed
+  auto& c = counters.count;
+  auto& b = counters.bytes;
+  c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  b.store(b.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+}
+
+void* countedAlloc(std::size_t size) {
+  if (config::mem_report) count(size);
+  void* p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+template <typename Field>
+uint64_t sum(Field field, const uint64_t& exited) {
+  std::lock_guard<std::mutex> lock(threads_mutex);
+  uint64_t total = exited;
+  for (Counters* t = threads; t; t = t->next) {
+    total += (t->*field).load(std::memory_order_relaxed);
+  }
+  return total;
+}
+}  // namespace
+
+namespace stats {
+uint64_t allocations() { return sum(&Counters::count, exited_count); }
+uint64_t allocatedBytes() { return sum(&Counters::bytes, exited_bytes); }
+uint64_t threadAllocations() { return counters.count.load(std::memory_order_relaxed); }
+uint64_t threadAllocatedBytes() { return counters.bytes.load(std::memory_order_relaxed); }
+}  // namespace stats
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,148 @@
+#include "ast_writer.h"
+
+#include <cstring>
+
+namespace {
+const size_t FLUSH_SIZE = 1 << 16;
+const std::string SPACES(256, ' ');
+}  // namespace
+
+bool AstWriter::parseFormat(const std::string& name, Format& format) {
+  if (name == "text") {
+    format = Format::Text;
+  } else if (name == "json") {
+    format = Format::Json;
+  } else if (name == "sexp") {
+    format = Format::Sexp;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void AstWriter::put(const char* s, size_t n) {
+  buf.append(s, n);
+  if (buf.size() >= FLUSH_SIZE) flush();
+}
+
+void AstWriter::put(const char* s) { put(s, strlen(s)); }
+
+void AstWriter::flush() {
+  if (buf.empty()) return;
+  fwrite(buf.data(), 1, buf.size(), out);
+  buf.clear();
+}
+
+void AstWriter::indent() {
+  size_t n = 2 * depth;
+  while (n > SPACES.size()) {
+    put(SPACES.data(), SPACES.size());
+    n -= SPACES.size();
+  }
+  put(SPACES.data(), n);
+}
+
+// json's comma, sexp's space
+void AstWriter::separate() {
+  if (has_children.empty()) return;
+  if (has_children.back()) put(format == Format::Json ? "," : " ");
+  has_children.back() = true;
+}
+
+void AstWriter::putQuoted(const std::string& s) {
+  put("\"", 1);
+  size_t start = 0;
+  for (size_t i = 0; i < s.size(); i++) {
+    char c = s[i];
+    if (c != '"' && c != '\\' && c != '\n') continue;
+    put(s.data() + start, i - start);
+    put(c == '\n' ? "\\n" : c == '"' ? "\\\"" : "\\\\");
+    start = i + 1;
+  }
+  put(s.data() + start, s.size() - start);
+  put("\"", 1);
+}
+
+void AstWriter::begin(const char* type, const std::string& value) {
+  switch (format) {
+    case Format::Text:
+      indent();
+      put(type);
+      if (!value.empty()) {
+        put(" ", 1);
+        put(value);
+      }
+      put(" {\n");
+      break;
+    case Format::Json:
+      separate();
+      put("{\"type\":\"");
+      put(type);
+      put("\"");
+      if (!value.empty()) {
+        put(",\"value\":");
+        putQuoted(value);
+      }
+      put(",\"children\":[");
+      break;
+    case Format::Sexp:
+      separate();
+      put("(", 1);
+      put(type);
+      if (!value.empty()) {
+        put(" ", 1);
+        putQuoted(value);
+      }
+      // a child always follows a space
+      break;
+  }
+  depth++;
+  has_children.push_back(format == Format::Sexp);
+}
+
+void AstWriter::end() {
+  depth--;
+  has_children.pop_back();
+  switch (format) {
+    case Format::Text:
+      indent();
+      put("}\n");
+      break;
+    case Format::Json:
+      put("]}");
+      break;
+    case Format::Sexp:
+      put(")", 1);
+      break;
+  }
+  if (depth == 0 && format != Format::Text) put("\n", 1);
+}
+
+void AstWriter::leaf(const char* type, const std::string& value) {
+  switch (format) {
+    case Format::Text:
+      indent();
+      put(type);
+      put(": ");
+      put(value);
+      put("\n", 1);
+      break;
+    case Format::Json:
+      separate();
+      put("{\"type\":\"");
+      put(type);
+      put("\",\"value\":");
+      putQuoted(value);
+      put("}");
+      break;
+    case Format::Sexp:
+      separate();
+      put("(", 1);
+      put(type);
+      put(" ", 1);
+      putQuoted(value);
+      put(")", 1);
+      break;
+  }
+  if (depth == 0 && format != Format::Text) put("\n", 1);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// AST output. Dump() only describes the tree's shape (begin/leaf/end) and the
+// writer picks the format; output collects in a buffer and is written out a
+// block at a time.
+class AstWriter {
+  public:
+    enum class Format {
+      Text,  // an indented tree, for people
+      Json,  // {"type":..,"value":..,"children":[..]}
+      Sexp,  // (type "value" children...)
+    };
+    // "text" / "json" / "sexp"; anything else returns false
+    static bool parseFormat(const std::string& name, Format& format);
+
+    AstWriter(FILE* out, Format format) : out(out), format(format) {}
+    ~AstWriter() { flush(); }
+    AstWriter(const AstWriter&) = delete;
+    AstWriter& operator=(const AstWriter&) = delete;
+
+    void begin(const char* type, const std::string& value = "");
+    void end();
+    void leaf(const char* type, const std::string& value);
+    void flush();
+
+  private:
+    FILE* out;
+    Format format;
+    std::string buf;
+    int depth = 0;
+    std::vector<bool> has_children;  // json/sexp: whether each open node has written a child yet
+
+    void indent();
+    void separate();
+    void put(const char* s, size_t n);
+    void put(const char* s);
+    void put(const std::string& s) { put(s.data(), s.size()); }
+    void putQuoted(const std::string& s);
+};
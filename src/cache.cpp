@@ -0,0 +1,208 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+#include "config.h"
+#include "hash.h"
+#include "source_buffer.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace cache {
+namespace {
+atomic<uint64_t> hits{0}, misses{0}, stores{0}, evictions{0};
+atomic<uint64_t> function_hits{0}, function_misses{0};  // --incremental
+
+// Estimated total size of the cache. The directory is scanned on the first
+// store, and later stores add what they wrote; only going over the limit
+// rescans and evicts, so a store does not walk the directory. Entries other
+// processes write count from the next scan, which makes the limit soft.
+mutex size_mutex;
+bool size_known = false;
+uintmax_t approx_size = 0;
+
+// a different compiler may give different output, so the hash of the
+// executable itself is part of the key
+const string& buildId() {
+  static const string id = [] {
+    SourceBuffer exe;
+    if (!exe.map("/proc/self/exe")) return toHex(xxh64(__DATE__ " " __TIME__));
+    return toHex(xxh64(exe.text()));
+  }();
+  return id;
+}
+
+fs::path entryPath(const string& key) {
+  return fs::path(config::cache_dir) / key.substr(0, 2) / key.substr(2);
+}
+
+bool isTemp(const fs::path& p) { return p.filename().string()[0] == '.'; }
+
+struct Entry {
+  fs::file_time_type time;
+  uintmax_t size;
+  fs::path path;
+};
+
+// scans the whole cache directory and returns its size; also collects the
+// entries when entries is not null
+uintmax_t scan(vector<Entry>* entries) {
+  error_code ec;
+  uintmax_t total = 0;
+  for (fs::recursive_directory_iterator it(config::cache_dir, ec), end;
+       !ec && it != end; it.increment(ec)) {
+    if (!it->is_regular_file(ec) || isTemp(it->path())) continue;
+    uintmax_t size = it->file_size(ec);
+    if (ec) continue;
+    total += size;
+    if (entries) entries->push_back({it->last_write_time(ec), size, it->path()});
+  }
+  return total;
+}
+
+uintmax_t capacity() { return uintmax_t(config::cache_size) << 20; }
+
+// deletes the least recently used entries until the size is down to 90% of
+// the limit, so that not every store has to evict
+void trim() {
+  vector<Entry> entries;
+  approx_size = scan(&entries);
+  if (approx_size <= capacity()) return;
+  sort(entries.begin(), entries.end(),
+       [](const Entry& a, const Entry& b) { return a.time < b.time; });
+  uintmax_t target = capacity() / 10 * 9;
+  for (auto& e : entries) {
+    if (approx_size <= target) break;
+    error_code ec;
+    if (fs::remove(e.path, ec)) {
+      approx_size -= e.size;
+      evictions++;
+    }
+  }
+}
+// the temporary file sits in the entry's directory, so the rename is atomic;
+// its name starts with '.', which scans skip
+bool makeTemp(const string& key, fs::path& temp) {
+  static atomic<unsigned> serial{0};
+  fs::path dir = entryPath(key).parent_path();
+  error_code ec;
+  fs::create_directories(dir, ec);
+  temp = dir / ("." + to_string(getpid()) + "-" + to_string(serial++));
+  return !ec;
+}
+
+// turns a written temporary file into the entry, evicting old ones if needed
+void publish(const fs::path& temp, const string& key) {
+  error_code ec;
+  uintmax_t size = fs::file_size(temp, ec);
+  fs::rename(temp, entryPath(key), ec);
+  if (ec) {
+    fs::remove(temp, ec);
+    return;
+  }
+  stores++;
+
+  lock_guard<mutex> lock(size_mutex);
+  if (!size_known) {
+    approx_size = scan(nullptr);
+    size_known = true;
+  } else {
+    approx_size += size;
+  }
+  if (approx_size > capacity()) trim();
+}
+}  // namespace
+
+bool enabled() { return !config::cache_dir.empty(); }
+
+// options that change the output; any new one like them belongs here
+string optionKey() {
+  return "O" + to_string(config::opt_level) + ";passes=" + config::passes +
+         ";rvv=" + to_string(config::rvv) + ";memoize=" +
+         to_string(config::memoize) + "," + to_string(config::memo_size);
+}
+
+string key(const string& mode, string_view source) {
+  // two seeds make 128 bits, so collisions are no worry however many entries
+  // there are. The source may be large and is hashed on its own rather than
+  // copied in with the rest
+  string data = buildId();
+  data += '\0';
+  data += mode;
+  data += '\0';
+  data += optionKey();
+  data += '\0';
+  data += toHex(xxh64(source, 0)) + toHex(xxh64(source, 1));
+  return toHex(xxh64(data, 0)) + toHex(xxh64(data, 1));
+}
+
+bool fetch(const string& key, const string& output) {
+  fs::path entry = entryPath(key);
+  error_code ec;
+  if (!fs::copy_file(entry, output, fs::copy_options::overwrite_existing, ec)) {
+    misses++;
+    return false;
+  }
+  // mtime serves as the last use time for eviction
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  hits++;
+  return true;
+}
+
+bool load(const string& key, string& data) {
+  fs::path entry = entryPath(key);
+  ifstream ifs(entry, ios::binary);
+  if (!ifs) {
+    function_misses++;
+    return false;
+  }
+  data.assign(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+  error_code ec;
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  function_hits++;
+  return true;
+}
+
+void store(const string& key, const string& output) {
+  fs::path temp;
+  if (!makeTemp(key, temp)) return;
+  error_code ec;
+  if (!fs::copy_file(output, temp, fs::copy_options::overwrite_existing, ec)) {
+    return;
+  }
+  publish(temp, key);
+}
+
+void save(const string& key, const string& data) {
+  fs::path temp;
+  if (!makeTemp(key, temp)) return;
+  {
+    ofstream ofs(temp, ios::binary | ios::trunc);
+    if (!ofs.write(data.data(), data.size())) return;
+  }
+  publish(temp, key);
+}
+
+void report(ostream& os) {
+  vector<Entry> entries;
+  uintmax_t total = scan(&entries);
+  uint64_t lookups = hits + misses;
+  os << "cache: " << hits << " hits, " << misses << " misses";
+  if (lookups) os << " (" << hits * 100 / lookups << "% hit rate)";
+  os << ", " << stores << " stored, " << evictions << " evicted; "
+     << entries.size() << " entries, " << (total >> 10) << " KiB of "
+     << config::cache_size << " MiB in " << config::cache_dir << endl;
+  if (function_hits + function_misses) {
+    os << "cache: " << function_hits << " functions reused, "
+       << function_misses << " recompiled" << endl;
+  }
+}
+}  // namespace cache
@@ -0,0 +1,37 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// --cache-dir: a content-addressed output cache. The key is an XXH64 over the
+// source, the mode, the options that change the output and the compiler
+// itself (the hash of the executable); on a hit the cached output is copied
+// over instead of compiling.
+//
+// The layout is ccache's: DIR/ab/cdef..., one file per entry. Stores write a
+// temporary file and rename it, so processes storing the same key at once
+// never read half a file. When the total goes over --cache-size, the least
+// recently used entries (by mtime, refreshed on hits) are deleted.
+namespace cache {
+    bool enabled();
+
+    // independent of the input's name: the same source under another path hits
+    std::string key(const std::string& mode, std::string_view source);
+    // the options part of the key: -O, --passes= and the others that change
+    // the output
+    std::string optionKey();
+
+    // on a hit, copies the entry to output and returns true
+    bool fetch(const std::string& key, const std::string& output);
+    // puts a freshly compiled output in the cache; failing to does not fail
+    // the compile
+    void store(const std::string& key, const std::string& output);
+
+    // --incremental's per-function entries, holding a string rather than an
+    // output file
+    bool load(const std::string& key, std::string& data);
+    void save(const std::string& key, const std::string& data);
+
+    // --cache-stats: this process's hits and misses, and the cache's size
+    void report(std::ostream& os);
+}  // namespace cache
@@ -0,0 +1,166 @@
+#include "cfg.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+namespace ir {
+vector<Function> splitFunctions(IRList& irs) {
+  vector<Function> funcs;
+  for (auto it = irs.begin(); it != irs.end(); it++) {
+    if (it->op_code != OpCode::FUNCTION_BEGIN) continue;
+    Function func;
+    func.begin = it;
+    func.name = functionName(*it);
+    while (it != irs.end() && it->op_code != OpCode::FUNCTION_END) it++;
+    assert(it != irs.end());
+    func.end = std::next(it);
+    funcs.push_back(func);
+  }
+  return funcs;
+}
+
+string functionName(const IR& func_begin) {
+  auto& label = func_begin.label;
+  auto at = label.find('@');
+  auto paren = label.find('(', at);
+  if (at == string::npos || paren == string::npos) return "";
+  return label.substr(at + 1, paren - at - 1);
+}
+
+bool isBranch(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::jm:
+    case OpCode::JEQ:
+    case OpCode::JNE:
+    case OpCode::JLE:
+    case OpCode::JLT:
+    case OpCode::JGE:
+    case OpCode::JGT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool isTerminator(OpCode op_code) {
+  return isBranch(op_code) || op_code == OpCode::RET;
+}
+
+OpCode invertBranch(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::JEQ: return OpCode::JNE;
+    case OpCode::JNE: return OpCode::JEQ;
+    case OpCode::JLT: return OpCode::JGE;
+    case OpCode::JGE: return OpCode::JLT;
+    case OpCode::JLE: return OpCode::JGT;
+    case OpCode::JGT: return OpCode::JLE;
+    default:
+      assert(false && "not a conditional jump");
+      return op_code;
+  }
+}
+
+CFG::CFG(const Function& func) {
+  auto body_end = std::prev(func.end);
+  for (auto it = std::next(func.begin); it != body_end; it++) {
+    bool starts = blocks.empty() || it->op_code == OpCode::LABEL ||
+                  isTerminator(std::prev(it)->op_code);
+    if (starts) {
+      if (!blocks.empty()) blocks.back().end = it;
+      BasicBlock bb;
+      bb.id = blocks.size();
+      if (it->op_code == OpCode::LABEL) {
+        bb.label = it->label;
+        label_to_block[it->label] = bb.id;
+      }
+      bb.begin = it;
+      blocks.push_back(bb);
+    }
+  }
+  if (!blocks.empty()) blocks.back().end = body_end;
+
+  for (auto& bb : blocks) {
+    auto last = std::prev(bb.end);
+    bool falls_through = true;
+    if (isBranch(last->op_code)) {
+      int target = blockOf(last->label);
+      if (target >= 0) bb.succs.push_back(target);
+      falls_through = last->op_code != OpCode::jm;
+    } else if (last->op_code == OpCode::RET) {
+      falls_through = false;
+    }
+    if (falls_through && bb.id + 1 < (int)blocks.size() &&
+        std::find(bb.succs.begin(), bb.succs.end(), bb.id + 1) ==
+            bb.succs.end()) {
+      bb.succs.push_back(bb.id + 1);
+    }
+  }
+  for (auto& bb : blocks) {
+    for (int s : bb.succs) blocks[s].preds.push_back(bb.id);
+  }
+}
+
+int CFG::blockOf(const string& label) const {
+  auto it = label_to_block.find(label);
+  return it == label_to_block.end() ? -1 : it->second;
+}
+
+vector<int> CFG::reversePostOrder() const {
+  vector<int> order;
+  vector<bool> visited(blocks.size(), false);
+  std::function<void(int)> dfs = [&](int b) {
+    visited[b] = true;
+    for (int s : blocks[b].succs) {
+      if (!visited[s]) dfs(s);
+    }
+    order.push_back(b);
+  };
+  if (!blocks.empty()) dfs(0);
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+vector<int> CFG::immediateDominators() const {
+  vector<int> idom(blocks.size(), -1);
+  if (blocks.empty()) return idom;
+  auto rpo = reversePostOrder();
+  vector<int> order(blocks.size(), -1);
+  for (int i = 0; i < (int)rpo.size(); i++) order[rpo[i]] = i;
+  auto intersect = [&](int a, int b) {
+    while (a != b) {
+      while (order[a] > order[b]) a = idom[a];
+      while (order[b] > order[a]) b = idom[b];
+    }
+    return a;
+  };
+  idom[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b : rpo) {
+      if (b == 0) continue;
+      int new_idom = -1;
+      for (int p : blocks[b].preds) {
+        if (idom[p] < 0) continue;
+        new_idom = new_idom < 0 ? p : intersect(p, new_idom);
+      }
+      if (new_idom != idom[b]) {
+        idom[b] = new_idom;
+        changed = true;
+      }
+    }
+  }
+  return idom;
+}
+
+bool CFG::dominates(const vector<int>& idom, int a, int b) {
+  if (idom[b] < 0) return false;
+  while (b != a) {
+    if (idom[b] == b) return false;
+    b = idom[b];
+  }
+  return true;
+}
+
+}  // namespace ir
@@ -0,0 +1,45 @@
+#pragma once
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+using namespace std;
+namespace ir {
+    // A function is the half-open range [begin, end) where begin points at
+    // FUNCTION_BEGIN and end points just past the matching FUNCTION_END.
+    struct Function {
+        IRList::iterator begin, end;
+        string name;
+    };
+    vector<Function> splitFunctions(IRList& irs);
+    string functionName(const IR& func_begin);
+
+    bool isBranch(OpCode op_code);
+    bool isTerminator(OpCode op_code);
+    // the conditional jump taken exactly when op_code's is not
+    OpCode invertBranch(OpCode op_code);
+
+    class BasicBlock {
+        public:
+            int id;
+            string label;
+            IRList::iterator begin, end;  // [begin, end), end may be FUNCTION_END
+            vector<int> succs, preds;
+    };
+
+    // Control flow graph of one function. Blocks start at a LABEL or after a
+    // branch; conditional jumps fall through to the next block.
+    class CFG {
+        public:
+            vector<BasicBlock> blocks;
+            unordered_map<string, int> label_to_block;
+            CFG(const Function& func);
+            int blockOf(const string& label) const;
+            vector<int> reversePostOrder() const;
+            // idom[entry] == entry, unreachable blocks get -1
+            vector<int> immediateDominators() const;
+            static bool dominates(const vector<int>& idom, int a, int b);
+    };
+}  // namespace ir
@@ -0,0 +1,110 @@
+#include "compact_ir.h"
+
+#include "cfg.h"
+
+namespace ir {
+Operand CompactModule::value(const string& name) {
+  auto [it, inserted] = value_ids.emplace(name, values.size());
+  if (inserted) values.push_back(name);
+  return Operand::make(Operand::Value, it->second);
+}
+
+Operand CompactModule::findValue(const string& name) const {
+  auto it = value_ids.find(name);
+  return it == value_ids.end() ? Operand()
+                               : Operand::make(Operand::Value, it->second);
+}
+
+Operand CompactModule::imm(int32_t v) {
+  if (Operand::fitsInline(v)) return Operand::make(Operand::Imm, uint32_t(v));
+  wide_imms.push_back(v);
+  return Operand::make(Operand::WideImm, wide_imms.size() - 1);
+}
+
+uint32_t CompactModule::label(const string& name) {
+  auto [it, inserted] = label_ids.emplace(name, labels.size());
+  if (inserted) labels.push_back(name);
+  return it->second;
+}
+
+Operand CompactModule::fromOpName(const OpName& op) {
+  if (op.is_var()) return value(op.name);
+  if (op.is_imm()) return imm(op.value);
+  return Operand();
+}
+
+OpName CompactModule::toOpName(Operand op) const {
+  switch (op.kind()) {
+    case Operand::Value:
+      return OpName(valueName(op));
+    case Operand::Imm:
+    case Operand::WideImm:
+      return OpName(immValue(op));
+    default:
+      return OpName();
+  }
+}
+
+Inst CompactModule::fromIR(const IR& ir) {
+  Inst inst(ir.op_code);
+  if (!ir.label.empty()) inst.label = label(ir.label);
+  inst.dest = fromOpName(ir.dest);
+  inst.op1 = fromOpName(ir.op1);
+  inst.op2 = fromOpName(ir.op2);
+  inst.op3 = fromOpName(ir.op3);
+  return inst;
+}
+
+IR CompactModule::toIR(const Inst& inst) const {
+  return IR(inst.op_code, toOpName(inst.dest), toOpName(inst.op1),
+            toOpName(inst.op2), toOpName(inst.op3),
+            inst.label == Inst::NO_LABEL ? "" : labels[inst.label]);
+}
+
+CompactModule CompactModule::fromList(const IRList& irs) {
+  CompactModule m;
+  m.insts.reserve(irs.size());
+  for (auto& ir : irs) m.insts.push_back(m.fromIR(ir));
+  m.findFunctions();
+  return m;
+}
+
+IRList CompactModule::toList() const {
+  IRList irs;
+  for (auto& inst : insts) irs.push_back(toIR(inst));
+  return irs;
+}
+
+void CompactModule::compact() {
+  size_t k = 0;
+  for (auto& inst : insts) {
+    if (inst.op_code != OpCode::NOOP) insts[k++] = inst;
+  }
+  insts.resize(k);
+  findFunctions();
+}
+
+void CompactModule::findFunctions() {
+  functions.clear();
+  for (uint32_t i = 0; i < insts.size(); i++) {
+    if (insts[i].op_code == OpCode::FUNCTION_BEGIN) {
+      uint32_t id = insts[i].label;
+      string header = id == Inst::NO_LABEL ? "" : labels[id];
+      uint32_t name = label(functionName(IR(OpCode::FUNCTION_BEGIN, header)));
+      functions.push_back({name, i, i});
+    } else if (insts[i].op_code == OpCode::FUNCTION_END &&
+               !functions.empty()) {
+      functions.back().end = i + 1;
+    }
+  }
+}
+
+size_t CompactModule::memoryBytes() const {
+  size_t bytes = insts.capacity() * sizeof(Inst) +
+                 functions.capacity() * sizeof(FunctionRange) +
+                 wide_imms.capacity() * sizeof(int32_t);
+  for (auto& s : values) bytes += sizeof(string) + s.capacity();
+  for (auto& s : labels) bytes += sizeof(string) + s.capacity();
+  return bytes;
+}
+}  // namespace ir
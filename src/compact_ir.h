@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+using namespace std;
+namespace ir {
+    // A 32-bit operand handle. The top two bits are the kind, the low 30 bits
+    // a value ID, an inline immediate, or an index into the module's table of
+    // immediates too wide for 30 bits.
+    class Operand {
+        public:
+            enum Kind : uint32_t {
+                Null = 0,
+                Value = 1,   // a named value: %1, @g, t, or a front-end "0"
+                Imm = 2,     // a signed 30-bit immediate
+                WideImm = 3, // index into CompactModule's wide immediates
+            };
+            static const uint32_t PAYLOAD = (1u << 30) - 1;
+
+            Operand() : bits(0) {}
+            static Operand make(Kind kind, uint32_t payload) {
+                return Operand((uint32_t(kind) << 30) | (payload & PAYLOAD));
+            }
+            static bool fitsInline(int32_t v) {
+                return v >= -(1 << 29) && v < (1 << 29);
+            }
+
+            Kind kind() const { return Kind(bits >> 30); }
+            uint32_t payload() const { return bits & PAYLOAD; }
+            // the inline immediate, sign-extended from 30 bits
+            int32_t inlineImm() const { return int32_t(bits << 2) >> 2; }
+            bool isNull() const { return bits == 0; }
+            bool isValue() const { return kind() == Value; }
+            bool isImm() const { return kind() == Imm || kind() == WideImm; }
+            uint32_t raw() const { return bits; }
+            bool operator==(Operand other) const { return bits == other.bits; }
+            bool operator!=(Operand other) const { return bits != other.bits; }
+
+        private:
+            explicit Operand(uint32_t bits) : bits(bits) {}
+            uint32_t bits;
+    };
+
+    // One instruction in 24 bytes. Strings live in side tables: value names
+    // behind the operand handles, and labels (block names, callee names,
+    // function headers, data names) behind `label`. A label ID indexes that
+    // one interned string table (label()/labelName()), so a branch and the
+    // LABEL it targets share an ID; it is not a block index.
+    //
+    // Branch targets stay label IDs on purpose. The same field names callees
+    // and data, block indices would go stale whenever a block is inserted or
+    // removed, and the executors already resolve each ID to a code position
+    // once, when threaded_code.cpp lowers the function.
+    struct Inst {
+        static const uint32_t NO_LABEL = ~0u;
+
+        OpCode op_code;
+        uint32_t label = NO_LABEL;
+        Operand dest, op1, op2, op3;
+
+        Inst(OpCode op_code = OpCode::NOOP) : op_code(op_code) {}
+        Operand& operand(int k) { return (&dest)[k]; }  // 0 is dest
+        Operand operand(int k) const { return (&dest)[k]; }
+    };
+    static_assert(sizeof(OpCode) == 4 && sizeof(Inst) == 24,
+                  "Inst is meant to pack into 24 bytes");
+
+    // A module in one flat instruction array. Functions are index ranges
+    // [begin, end) covering FUNCTION_BEGIN .. FUNCTION_END, as in
+    // splitFunctions. Converts to and from IRList without loss. The passes
+    // still run on IRList; -run, -jit and .sir images use this form.
+    class CompactModule {
+        public:
+            struct FunctionRange {
+                uint32_t name;  // label ID of the function's name
+                uint32_t begin, end;
+            };
+
+            vector<Inst> insts;
+            vector<FunctionRange> functions;
+
+            static CompactModule fromList(const IRList& irs);
+            IRList toList() const;
+            // drops NOOP instructions and rebuilds `functions`
+            void compact();
+            void findFunctions();
+
+            Operand value(const string& name);
+            // like value(), but a null operand if the name is not in use
+            Operand findValue(const string& name) const;
+            Operand imm(int32_t v);
+            uint32_t label(const string& name);
+
+            const string& valueName(Operand op) const { return values[op.payload()]; }
+            int32_t immValue(Operand op) const {
+                return op.kind() == Operand::Imm ? op.inlineImm()
+                                                 : wide_imms[op.payload()];
+            }
+            const string& labelName(uint32_t id) const { return labels[id]; }
+            size_t valueCount() const { return values.size(); }
+            size_t labelCount() const { return labels.size(); }
+            size_t wideImmCount() const { return wide_imms.size(); }
+
+            Operand fromOpName(const OpName& op);
+            OpName toOpName(Operand op) const;
+            Inst fromIR(const IR& ir);
+            IR toIR(const Inst& inst) const;
+
+            // bytes held by the instructions and side tables
+            size_t memoryBytes() const;
+
+        private:
+            vector<string> values;
+            unordered_map<string, uint32_t> value_ids;
+            vector<int32_t> wide_imms;
+            vector<string> labels;
+            unordered_map<string, uint32_t> label_ids;
+    };
+}  // namespace ir
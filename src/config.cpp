@@ -0,0 +1,198 @@
+#include "config.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace config {
+std::string mode;
+std::string input;
+std::string output;
+std::string batch;
+std::string server;
+std::string connect;
+bool stop_server = false;
+int jobs = 1;
+bool rvv = false;
+bool memoize = false;
+int memo_size = 1024;
+int opt_level = 0;
+std::string passes;
+bool pass_report = false;
+bool time_report = false;
+bool mem_report = false;
+bool report_json = false;
+std::string dump_ast;
+bool trace_reductions = false;
+bool hand_lexer = false;
+bool lex_only = false;
+std::string cache_dir;
+int cache_size = 512;
+bool cache_stats = false;
+bool incremental = false;
+bool save_ir = false;
+std::string profile_generate;
+std::string profile_use;
+
+static const char* const DEFAULT_PROFILE = "sysy.profile";
+
+static void usage(const char* argv0) {
+  std::cerr << "usage: " << argv0 << " -koopa|-riscv|-llvm <input> -o <output> [options]\n"
+            << "       " << argv0 << " -run|-jit <input|.sir> [options]\n"
+            << "       " << argv0
+            << " -koopa|-riscv|-llvm --batch=<manifest|dir> [-o <outdir>] [options]\n"
+            << "       " << argv0 << " --server=<socket> [options]\n"
+            << "       " << argv0 << " --connect=<socket> --stop-server\n"
+            << "options: [-j N] [--connect=<socket>]"
+            << " [-O0|-O1|-O2] [--passes=a,b,...] [--pass-report]"
+            << " [--time-report] [--mem-report] [--report-format=text|json]"
+            << " [--dump-ast[=text|json|sexp]] [--trace-reductions]"
+            << " [--lexer=flex|hand] [--lex-only]"
+            << " [--target-feature=[+-]v,...] [--memoize] [--memoize-size=N]"
+            << " [--cache-dir=<dir>] [--cache-size=MiB] [--cache-stats]"
+            << " [--incremental] [--save-ir]"
+            << " [-fprofile-generate[=file]] [-fprofile-use[=file]]"
+            << std::endl;
+  exit(1);
+}
+
+static void parse_features(const std::string& list) {
+  size_t pos = 0;
+  while (pos <= list.size()) {
+    size_t comma = list.find(',', pos);
+    if (comma == std::string::npos) comma = list.size();
+    std::string feature = list.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (feature.empty()) continue;
+    bool enable = feature[0] != '-';
+    if (feature[0] == '+' || feature[0] == '-') feature = feature.substr(1);
+    if (feature == "v") {
+      rvv = enable;
+    } else {
+      std::cerr << "warning: unknown target feature '" << feature << "'"
+                << std::endl;
+    }
+  }
+}
+
+void parse_arg(int argc, const char* argv[]) {
+  if (argc < 2) usage(argv[0]);
+  // 第一个参数是模式, 只有 --server 之类不需要模式
+  int first = 1;
+  if (strncmp(argv[1], "--", 2) != 0) mode = argv[first++];
+  for (int i = first; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "-o") == 0) {
+      if (i + 1 >= argc) usage(argv[0]);
+      output = argv[++i];
+    } else if (strncmp(arg, "--batch=", 8) == 0) {
+      batch = arg + 8;
+    } else if (strncmp(arg, "--server=", 9) == 0) {
+      server = arg + 9;
+    } else if (strncmp(arg, "--connect=", 10) == 0) {
+      connect = arg + 10;
+    } else if (strcmp(arg, "--stop-server") == 0) {
+      stop_server = true;
+    } else if (strcmp(arg, "-j") == 0) {
+      if (i + 1 >= argc) usage(argv[0]);
+      jobs = atoi(argv[++i]);
+      if (jobs < 0) usage(argv[0]);
+    } else if (strncmp(arg, "--jobs=", 7) == 0) {
+      jobs = atoi(arg + 7);
+      if (jobs < 0) usage(argv[0]);
+    } else if (strncmp(arg, "--target-feature=", 17) == 0) {
+      parse_features(arg + 17);
+    } else if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' &&
+               arg[2] <= '2' && arg[3] == '\0') {
+      opt_level = arg[2] - '0';
+    } else if (strncmp(arg, "--passes=", 9) == 0) {
+      passes = arg + 9;
+    } else if (strcmp(arg, "--pass-report") == 0) {
+      pass_report = true;
+    } else if (strcmp(arg, "--time-report") == 0) {
+      time_report = true;
+    } else if (strcmp(arg, "--mem-report") == 0) {
+      mem_report = true;
+    } else if (strncmp(arg, "--report-format=", 16) == 0) {
+      if (strcmp(arg + 16, "json") == 0) {
+        report_json = true;
+      } else if (strcmp(arg + 16, "text") != 0) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(arg, "--dump-ast") == 0) {
+      dump_ast = "text";
+    } else if (strncmp(arg, "--dump-ast=", 11) == 0) {
+      dump_ast = arg + 11;
+      if (dump_ast != "text" && dump_ast != "json" && dump_ast != "sexp") {
+        usage(argv[0]);
+      }
+    } else if (strcmp(arg, "--trace-reductions") == 0) {
+      trace_reductions = true;
+    } else if (strncmp(arg, "--lexer=", 8) == 0) {
+      if (strcmp(arg + 8, "hand") == 0) {
+        hand_lexer = true;
+      } else if (strcmp(arg + 8, "flex") == 0) {
+        hand_lexer = false;
+      } else {
+        usage(argv[0]);
+      }
+    } else if (strcmp(arg, "--lex-only") == 0) {
+      lex_only = true;
+    } else if (strcmp(arg, "--memoize") == 0) {
+      memoize = true;
+    } else if (strncmp(arg, "--memoize-size=", 15) == 0) {
+      memo_size = atoi(arg + 15);
+      if (memo_size <= 0) usage(argv[0]);
+    } else if (strncmp(arg, "--cache-dir=", 12) == 0) {
+      cache_dir = arg + 12;
+    } else if (strncmp(arg, "--cache-size=", 13) == 0) {
+      cache_size = atoi(arg + 13);
+      if (cache_size <= 0) usage(argv[0]);
+    } else if (strcmp(arg, "--cache-stats") == 0) {
+      cache_stats = true;
+    } else if (strcmp(arg, "--incremental") == 0) {
+      incremental = true;
+    } else if (strcmp(arg, "--save-ir") == 0) {
+      save_ir = true;
+    } else if (strcmp(arg, "-fprofile-generate") == 0) {
+      profile_generate = DEFAULT_PROFILE;
+    } else if (strncmp(arg, "-fprofile-generate=", 19) == 0) {
+      profile_generate = arg + 19;
+      if (profile_generate.empty()) usage(argv[0]);
+    } else if (strcmp(arg, "-fprofile-use") == 0) {
+      profile_use = DEFAULT_PROFILE;
+    } else if (strncmp(arg, "-fprofile-use=", 14) == 0) {
+      profile_use = arg + 14;
+      if (profile_use.empty()) usage(argv[0]);
+    } else if (arg[0] == '-' && arg[1] != '\0') {
+      std::cerr << "unknown option " << arg << std::endl;
+      usage(argv[0]);
+    } else {
+      input = arg;
+    }
+  }
+  if (stop_server && connect.empty()) usage(argv[0]);
+  if (incremental && cache_dir.empty()) usage(argv[0]);
+  if (incremental && save_ir) usage(argv[0]);
+  // -run/-jit 只执行一个文件, 不写输出
+  bool execute = mode == "-run" || mode == "-jit";
+  // 插桩的程序要执行才有计数; 计数按本进程读到的文件用, 不交给 daemon,
+  // 也不和按函数缓存的 --incremental 混用
+  if (!profile_generate.empty() && (!execute || !profile_use.empty())) usage(argv[0]);
+  if (!profile_use.empty() && (incremental || !connect.empty() || !server.empty())) {
+    usage(argv[0]);
+  }
+  // 向量指令没有 Koopa 的写法, 只有 -run/-jit 能执行它们
+  if (rvv && !execute) {
+    std::cerr << "--target-feature=+v: vector code has no Koopa form,"
+              << " use it with -run or -jit" << std::endl;
+    exit(1);
+  }
+  if (!server.empty() || stop_server) return;
+  if (execute && (!batch.empty() || !connect.empty())) usage(argv[0]);
+  if (batch.empty() &&
+      (input.empty() || (output.empty() && !lex_only && !execute))) {
+    usage(argv[0]);
+  }
+}
+}  // namespace config
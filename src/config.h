@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+
+namespace config {
+    extern std::string mode;    // -koopa / -riscv / -llvm / -run / -jit
+    extern std::string input;
+    extern std::string output;
+    extern std::string batch;   // --batch=<manifest|directory>
+    extern std::string server;  // --server=<socket>: run as a compile daemon
+    extern std::string connect; // --connect=<socket>: let the daemon compile
+    extern bool stop_server;    // --stop-server (with --connect)
+    extern int jobs;            // -j N / --jobs=N, 0: one per core; threads for
+                                // batch units, or for the functions of one file
+    extern bool rvv;            // --target-feature=+v (-run / -jit only)
+    extern bool memoize;        // --memoize
+    extern int memo_size;       // --memoize-size=N, arguments cached per function
+    extern int opt_level;       // -O0 / -O1 / -O2
+    extern std::string passes;  // --passes=a,b,c overrides the -O pipeline
+    extern bool pass_report;    // --pass-report: per-pass time, size and memory
+    extern bool time_report;    // --time-report: per-phase wall time
+    extern bool mem_report;     // --mem-report: allocations and peak RSS
+    extern bool report_json;    // --report-format=json
+    extern std::string dump_ast;  // --dump-ast[=text|json|sexp], empty: no dump
+    extern bool trace_reductions; // --trace-reductions: print the parser's rule trace
+    extern bool hand_lexer;       // --lexer=hand: hand-written lexer instead of Flex
+    extern bool lex_only;         // --lex-only: only lex the input, report throughput
+    extern std::string cache_dir; // --cache-dir=DIR: reuse outputs of identical compiles
+    extern int cache_size;        // --cache-size=N, MiB kept in the cache
+    extern bool cache_stats;      // --cache-stats: print hits and misses
+    extern bool incremental;      // --incremental: also cache each function (needs --cache-dir)
+    extern bool save_ir;          // --save-ir: also write the optimized IR, binary, to <output>.sir
+    extern std::string profile_generate;  // -fprofile-generate[=file]: count blocks and edges (-run / -jit)
+    extern std::string profile_use;       // -fprofile-use[=file]: optimize with those counts
+
+    // compiler 模式 输入文件 -o 输出文件 [选项...]
+    // compiler 模式 --batch=清单或目录 [-o 输出目录] [选项...]
+    // compiler --server=socket [选项...]
+    void parse_arg(int argc, const char* argv[]);
+}  // namespace config
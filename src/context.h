@@ -0,0 +1,80 @@
+#pragma once
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include "ir.h"
+#include "purity.h"
+
+namespace profile {
+    class Profile;
+}
+
+namespace ir {
+    // numbers for the labels and temporaries passes create, kept per function
+    // (see CompilationContext::names) so output does not depend on what was
+    // compiled before or on other threads
+    struct NameCounters {
+        int unroll = 0;
+        int vectorize = 0;
+        int memo = 0;
+        int layout = 0;
+    };
+}  // namespace ir
+
+// All mutable state of one compilation unit. The globals that used to be
+// spread over node.h and sysy.y live here, so threads can each compile their
+// own unit without interfering.
+class CompilationContext {
+  public:
+    int reg_count = 0;      // next temporary %N
+    int block_count = 0;    // next basic block %_b_N
+    ir::IRList ir;          // what toIr lowers, emitted as a whole after optimizing
+    std::string structure;  // the reductions --trace-reductions records
+    int jobs = 1;           // threads for function passes and emission
+    // --incremental: effects of the functions taken from the cache, whose IR
+    // is not in ir
+    std::map<std::string, ir::FuncEffect> external_effects;
+    // -fprofile-use counts, or nullptr; passes look them up by function name
+    // and block label
+    const profile::Profile* profile = nullptr;
+    // errors and warnings of this unit; the server collects them for the client
+    std::ostream* diagnostics = &std::cerr;
+
+    // Numbered per function: labels and temporaries are local to a function,
+    // so function passes running in parallel do not interfere, and the names
+    // they make do not depend on thread count or order.
+    ir::NameCounters& names(const std::string& func) {
+      std::lock_guard<std::mutex> lock(names_mutex);
+      return function_names[func];
+    }
+
+    // makes ctx the unit being compiled on this thread until the scope ends
+    class Scope {
+      public:
+        explicit Scope(CompilationContext& ctx) : saved(active) { active = &ctx; }
+        ~Scope() { active = saved; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        CompilationContext* saved;
+    };
+
+  private:
+    std::mutex names_mutex;
+    std::map<std::string, ir::NameCounters> function_names;
+
+    friend CompilationContext& context();
+    static inline thread_local CompilationContext* active = nullptr;
+};
+
+// the unit being compiled on this thread
+inline CompilationContext& context() {
+  assert(CompilationContext::active);
+  return *CompilationContext::active;
+}
+
+// where the current unit's errors go
+inline std::ostream& diagnostics() { return *context().diagnostics; }
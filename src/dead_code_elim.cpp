@@ -0,0 +1,94 @@
+#include <unordered_map>
+#include <vector>
+#include "cfg.h"
+#include "optimize.h"
+#include "purity.h"
+
+// Deletes instructions whose result is never used and that have no effect
+// besides producing it. Calls to pure and read-only functions count as such.
+// Uses are counted once per function and the deletions run off a worklist,
+// so a chain of dead values costs one visit per use rather than one sweep of
+// the function per link.
+
+namespace ir {
+namespace {
+bool isRemovable(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::MOV:
+    case OpCode::EQ:
+    case OpCode::NE:
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::MOD:
+    case OpCode::OR:
+    case OpCode::AND:
+    case OpCode::LT:
+    case OpCode::GT:
+    case OpCode::LE:
+    case OpCode::GE:
+    case OpCode::SAL:
+    case OpCode::SAR:
+    case OpCode::LOAD:
+    case OpCode::MALLOC_IN_STACK:
+    case OpCode::PHI_MOV:
+    case OpCode::VSETVL:
+    case OpCode::VLOAD:
+    case OpCode::VADD:
+    case OpCode::VSUB:
+    case OpCode::VMUL:
+    case OpCode::VREDSUM:
+      return true;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+void dead_code_elim(IRList& irs, const PurityInfo& purity) {
+  for (auto& func : splitFunctions(irs)) {
+    // by name: how many operands read it, and the instructions writing it
+    unordered_map<string, int> uses;
+    unordered_map<string, vector<IRList::iterator>> defs;
+    for (auto it = func.begin; it != func.end; it++) {
+      it->forEachOp(
+          [&](const OpName& op) {
+            if (op.is_var()) uses[op.name]++;
+          },
+          false);
+      if (it->dest.is_var()) defs[it->dest.name].push_back(it);
+    }
+    auto unused = [&](IRList::iterator it) {
+      if (it->op_code == OpCode::NOOP) return false;
+      bool unused = it->dest.is_null() ||
+                    (it->dest.is_var() && uses[it->dest.name] == 0);
+      if (!unused) return false;
+      if (it->op_code == OpCode::call) return purity.isReadOnlyCall(*it);
+      return !it->dest.is_null() && isRemovable(it->op_code);
+    };
+
+    // deleting an instruction can leave its operands unused, so their
+    // definitions go back on the worklist
+    vector<IRList::iterator> worklist;
+    for (auto it = func.end; it != func.begin;) worklist.push_back(--it);
+    while (!worklist.empty()) {
+      auto it = worklist.back();
+      worklist.pop_back();
+      if (!unused(it)) continue;
+      auto dead = it->op_code == OpCode::call ? callSequence(it, func.begin)
+                                              : vector<IRList::iterator>{it};
+      for (auto d : dead) {
+        d->forEachOp(
+            [&](const OpName& op) {
+              if (!op.is_var() || --uses[op.name] > 0) return;
+              for (auto def : defs[op.name]) worklist.push_back(def);
+            },
+            false);
+        d->op_code = OpCode::NOOP;
+      }
+    }
+  }
+  irs.remove_if([](const IR& ir) { return ir.op_code == OpCode::NOOP; });
+}
+}  // namespace ir
@@ -0,0 +1,350 @@
+#include "driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include "cache.h"
+#include "config.h"
+#include "context.h"
+#include "incremental.h"
+#include "interp.h"
+#include "jit.h"
+#include "node.h"
+#include "ir.h"
+#include "ir_image.h"
+#include "lexer.h"
+#include "optimize.h"
+#include "profile.h"
+#include "source_buffer.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// reentrant parser: all of its state is in the scanner and the CompilationContext
+extern int yyparse(unique_ptr<BaseAST> &ast, yyscan_t scanner);
+
+namespace driver {
+namespace {
+// A --save-ir image is already optimized, so it skips the front end and the
+// passes. The module read from it goes straight to execution or emission,
+// without converting back to an IRList.
+bool loadImage(const Unit& unit, const SourceBuffer& source, ir::CompactModule& module) {
+  stats::ScopedPhase phase("load-ir");
+  ir::ImageView image;
+  string error;
+  if (!image.open(source.text(), error)) {
+    diagnostics() << unit.input << ": " << error << endl;
+    return false;
+  }
+  module = image.toModule();
+  return true;
+}
+
+// -llvm goes through libkoopa to LLVM IR, other modes write Koopa IR as is
+bool emitText(const Unit& unit, const vector<string>& functions) {
+  ir::IR_DUMP ir_dump(unit.output);
+  if (unit.mode != "-llvm") {
+    ir_dump.writeOpIr(functions);
+    return true;
+  }
+  string error;
+  if (ir_dump.writeLlvm(functions, error)) return true;
+  diagnostics() << unit.output << ": " << error << endl;
+  return false;
+}
+
+bool emit(const Unit& unit, const ir::IRList& irs, int jobs) {
+  stats::ScopedPhase phase("emission");
+  return emitText(unit, ir::IR_DUMP::formatFunctions(irs, jobs));
+}
+
+bool emitImage(const Unit& unit, const SourceBuffer& source, int jobs) {
+  ir::CompactModule module;
+  if (!loadImage(unit, source, module)) return false;
+  stats::ScopedPhase phase("emission");
+  return emitText(unit, ir::IR_DUMP::formatFunctions(module, jobs));
+}
+
+// The lexer scans source in place, and IDENT values point into it too.
+// Returns null on failure.
+unique_ptr<BaseAST> parse(const Unit& unit, SourceBuffer& source) {
+  unique_ptr<BaseAST> ast;
+  int ret;
+  {
+    stats::ScopedPhase phase("parse");
+    lexer::Scanner scanner(source);
+    ret = yyparse(ast, scanner.get());
+  }
+  if (ret || !ast) {
+    diagnostics() << unit.input << ": parse failed" << endl;
+    return nullptr;
+  }
+  auto& structure = context().structure;
+  if (config::trace_reductions && !structure.empty()) {
+    diagnostics() << structure.substr(1) << endl;
+  }
+  return ast;
+}
+
+// -fprofile-use counts are read once per process; if they cannot be read,
+// warn and compile without them
+const profile::Profile* loadProfile() {
+  static const profile::Profile* loaded = []() -> const profile::Profile* {
+    if (config::profile_use.empty()) return nullptr;
+    static profile::Profile counts;
+    string error;
+    if (counts.load(config::profile_use, error)) return &counts;
+    cerr << "warning: " << config::profile_use << ": " << error
+         << ", compiling without profile" << endl;
+    return nullptr;
+  }();
+  return loaded;
+}
+
+// With counts, unlabeled blocks are first numbered the way
+// -fprofile-generate numbers them, so passes find their counts by label
+void optimize(CompilationContext& ctx) {
+  ctx.profile = loadProfile();
+  if (ctx.profile) profile::labelBlocks(ctx.ir);
+  ir::optimize(ctx.ir);
+}
+
+// adds this run's counts to the -fprofile-generate file, creating it if needed
+bool saveProfile(const vector<profile::Site>& sites, const interp::Readback& readback) {
+  profile::Profile counts;
+  string error;
+  if (!counts.load(config::profile_generate, error) &&
+      filesystem::exists(config::profile_generate)) {
+    cerr << config::profile_generate << ": " << error << endl;
+    return false;
+  }
+  counts.merge(profile::collect(sites, readback.words));
+  if (!counts.save(config::profile_generate)) {
+    cerr << config::profile_generate << ": cannot write" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool saveImage(const ir::IRList& irs, const string& path) {
+  stats::ScopedPhase phase("save-ir");
+  string image = ir::encodeImage(ir::CompactModule::fromList(irs));
+  ofstream ofs(path, ios::binary);
+  return ofs.write(image.data(), image.size()) && ofs.flush();
+}
+}  // namespace
+
+bool compileUnit(const Unit& unit, int jobs, ostream& diagnostics) {
+  CompilationContext ctx;
+  CompilationContext::Scope scope(ctx);
+  ctx.jobs = jobs;
+  ctx.diagnostics = &diagnostics;
+
+  SourceBuffer source;
+  if (unit.source.empty()) {
+    if (!source.map(unit.input)) {
+      diagnostics << unit.input << ": cannot open" << endl;
+      return false;
+    }
+  } else {
+    source.assign(unit.source);
+  }
+
+  if (ir::isImage(source.text())) return emitImage(unit, source, jobs);
+
+  if (config::lex_only) {
+    auto start = chrono::steady_clock::now();
+    size_t tokens = lexer::tokenize(source);
+    chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    double mb = source.text().size() / 1e6;
+    diagnostics << unit.input << ": " << tokens << " tokens, " << fixed
+         << setprecision(2) << mb << " MB in " << seconds.count() * 1000
+         << " ms, " << mb / seconds.count() << " MB/s ("
+         << (config::hand_lexer ? "hand" : "flex") << ")" << endl;
+    return true;
+  }
+
+  // the cache holds only the output file, not what --dump-ast and the like
+  // print or the .sir of --save-ir, so those skip it; the key does not cover
+  // -fprofile-use counts either
+  string key;
+  if (cache::enabled() && config::dump_ast.empty() &&
+      !config::trace_reductions && !config::save_ir && config::profile_use.empty()) {
+    stats::ScopedPhase phase("cache");
+    key = cache::key(unit.mode, source.text());
+    if (cache::fetch(key, unit.output)) return true;
+  }
+
+  unique_ptr<BaseAST> ast = parse(unit, source);
+  if (!ast) return false;
+
+  // dump the parsed AST
+  if (!config::dump_ast.empty()) {
+    stats::ScopedPhase phase("ast-dump");
+    AstWriter::Format format;
+    AstWriter::parseFormat(config::dump_ast, format);
+    AstWriter writer(stdout, format);
+    ast->Dump(writer);
+  }
+
+  // --incremental caches Koopa IR per function; -llvm always recompiles
+  // the whole unit
+  if (config::incremental && unit.mode != "-llvm") {
+    if (!incremental::compile(unit, *ast, jobs)) {
+      diagnostics << unit.output << ": cannot write" << endl;
+      return false;
+    }
+  } else {
+    {
+      stats::ScopedPhase phase("lowering");
+      ast->toIr(unit.output);
+    }
+    optimize(ctx);
+    if (config::save_ir && !saveImage(ctx.ir, unit.output + ".sir")) {
+      diagnostics << unit.output << ".sir: cannot write" << endl;
+      return false;
+    }
+    if (!emit(unit, ctx.ir, jobs)) return false;
+  }
+  if (!key.empty()) cache::store(key, unit.output);
+  return true;
+}
+
+int runUnit(const Unit& unit, int jobs) {
+  CompilationContext ctx;
+  CompilationContext::Scope scope(ctx);
+  ctx.jobs = jobs;
+
+  SourceBuffer source;
+  if (!source.map(unit.input)) {
+    cerr << unit.input << ": cannot open" << endl;
+    return 1;
+  }
+  bool generate = !config::profile_generate.empty();
+  vector<profile::Site> sites;
+  ir::CompactModule module;
+  if (ir::isImage(source.text())) {
+    // a .sir holds optimized IR, whose blocks do not match the IR that
+    // -fprofile-use regenerates from the source
+    if (generate) {
+      cerr << unit.input << ": -fprofile-generate needs the source, not a .sir" << endl;
+      return 1;
+    }
+    if (!loadImage(unit, source, module)) return 1;
+    ctx.profile = loadProfile();
+  } else {
+    unique_ptr<BaseAST> ast = parse(unit, source);
+    if (!ast) return 1;
+    {
+      stats::ScopedPhase phase("lowering");
+      ast->toIr(unit.output);
+    }
+    if (generate) {
+      // the instrumented program is not optimized: counts are kept by the
+      // labels of the freshly lowered IR
+      profile::labelBlocks(ctx.ir);
+      sites = profile::instrument(ctx.ir);
+    } else {
+      optimize(ctx);
+    }
+    stats::ScopedPhase phase("compact-ir");
+    module = ir::CompactModule::fromList(ctx.ir);
+  }
+  interp::Readback readback{profile::COUNTERS};
+  for (auto& site : sites) readback.count = max(readback.count, size_t(site.counter) + 1);
+  int exit_code;
+  bool ran;
+  {
+    stats::ScopedPhase phase("run");
+    auto counters = generate ? &readback : nullptr;
+    ran = unit.mode == "-jit" ? jit::run(module, exit_code, counters, ctx.profile)
+                              : interp::run(module, exit_code, counters);
+  }
+  if (ran && generate && !saveProfile(sites, readback)) return 1;
+  return ran ? exit_code : 1;
+}
+
+bool readManifest(const string& path, vector<Unit>& units) {
+  ifstream ifs(path);
+  if (!ifs) {
+    cerr << path << ": cannot open manifest" << endl;
+    return false;
+  }
+  string line;
+  int line_no = 0;
+  while (getline(ifs, line)) {
+    line_no++;
+    auto first = line.find_first_not_of(" \t\r");
+    if (first == string::npos || line[first] == '#') continue;
+    istringstream iss(line);
+    Unit unit;
+    string extra;
+    if (!(iss >> unit.mode >> unit.input >> unit.output) || (iss >> extra)) {
+      cerr << path << ":" << line_no << ": expected '<mode> <input> <output>'"
+           << endl;
+      return false;
+    }
+    units.push_back(unit);
+  }
+  return true;
+}
+
+bool scanDirectory(const string& dir, const string& mode, const string& out_dir,
+                   vector<Unit>& units) {
+  namespace fs = std::filesystem;
+  error_code ec;
+  vector<fs::path> inputs;
+  for (auto& entry : fs::directory_iterator(dir, ec)) {
+    auto ext = entry.path().extension();
+    if (entry.is_regular_file() && (ext == ".c" || ext == ".sy")) {
+      inputs.push_back(entry.path());
+    }
+  }
+  if (ec) {
+    cerr << dir << ": " << ec.message() << endl;
+    return false;
+  }
+  // directory order is unspecified; sort so the output order is stable
+  sort(inputs.begin(), inputs.end());
+  fs::path out = out_dir.empty() ? fs::path(dir) : fs::path(out_dir);
+  if (!out_dir.empty()) fs::create_directories(out, ec);
+  for (auto& input : inputs) {
+    auto output = out / input.filename();
+    output.replace_extension(mode == "-riscv"  ? ".S"
+                             : mode == "-llvm" ? ".ll"
+                                               : ".koopa");
+    units.push_back({mode, input.string(), output.string()});
+  }
+  return true;
+}
+
+int compileBatch(const string& path) {
+  vector<Unit> units;
+  bool ok = std::filesystem::is_directory(path)
+                ? scanDirectory(path, config::mode, config::output, units)
+                : readManifest(path, units);
+  if (!ok) return 1;
+  // each unit has its own CompilationContext and output file, so units run
+  // in parallel as they are; with that, a unit starts no threads of its own
+  vector<char> ok_units(units.size(), 0);
+  if (config::jobs == 1) {
+    for (size_t i = 0; i < units.size(); i++) ok_units[i] = compileUnit(units[i]);
+  } else {
+    ThreadPool pool(config::jobs);
+    for (size_t i = 0; i < units.size(); i++) {
+      pool.submit([&, i] { ok_units[i] = compileUnit(units[i]); });
+    }
+    pool.wait();
+  }
+  int failed = count(ok_units.begin(), ok_units.end(), 0);
+  cerr << "batch: " << units.size() << " units, " << failed << " failed"
+       << endl;
+  return failed;
+}
+}  // namespace driver
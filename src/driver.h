@@ -0,0 +1,39 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The compile pipeline for one file, from source to output. Each file's state
+// lives in its own CompilationContext, so batch mode can compile several on
+// different threads at once.
+namespace driver {
+    struct Unit {
+        std::string mode;    // -koopa / -riscv / -run
+        std::string input;
+        std::string output;
+        std::string source;  // if not empty, compiled instead of reading input
+    };
+
+    // On error, writes the reason to diagnostics and returns false; never
+    // exits the process. jobs: threads for function passes and emission,
+    // 0 for one per core.
+    bool compileUnit(const Unit& unit, int jobs = 1,
+                     std::ostream& diagnostics = std::cerr);
+
+    // -run/-jit: compiles without writing output and runs @main in the
+    // interpreter (or the JIT for -jit), returning its exit code. The input
+    // may also be a --save-ir .sir. Returns 1 if compiling or running fails.
+    // With -fprofile-generate it runs the instrumented program and adds the
+    // counts to the profile file.
+    int runUnit(const Unit& unit, int jobs = 1);
+
+    // one "mode input output" per line; blank lines and lines starting
+    // with # are skipped
+    bool readManifest(const std::string& path, std::vector<Unit>& units);
+    // every .c / .sy file in dir, with outputs in out_dir (next to the
+    // inputs when empty)
+    bool scanDirectory(const std::string& dir, const std::string& mode,
+                       const std::string& out_dir, std::vector<Unit>& units);
+    // --batch: compiles on config::jobs threads, returns how many units failed
+    int compileBatch(const std::string& path);
+}  // namespace driver
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// XXH64 (https://github.com/Cyan4973/xxHash), the 64-bit variant, written out
+// here so the cache needs no extra library. Output matches the reference
+// implementation for the same seed.
+uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0);
+
+inline uint64_t xxh64(std::string_view s, uint64_t seed = 0) {
+  return xxh64(s.data(), s.size(), seed);
+}
+
+// 16 lowercase hex digits
+std::string toHex(uint64_t value);
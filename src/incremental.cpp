@@ -0,0 +1,228 @@
+#include "incremental.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "context.h"
+#include "hash.h"
+#include "node.h"
+#include "optimize.h"
+#include "purity.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace incremental {
+namespace {
+struct Item {
+  const BaseAST* node;  // FuncDefAST or DeclAST
+  string function;      // function name, empty for declarations
+  vector<string> defines;
+  set<string> uses;
+  string own;  // hash of the normalized AST, blind to comments and whitespace
+  string key;  // own plus the own of every (indirect) dependency
+
+  bool cached = false;
+  string text;  // the emitted IR text
+  ir::FuncEffect effect = ir::FuncEffect::SideEffect;
+};
+
+// the same AST always gives the same text, whatever the source's layout
+string canonicalDump(const BaseAST& node) {
+  char* buf = nullptr;
+  size_t size = 0;
+  FILE* out = open_memstream(&buf, &size);
+  {
+    AstWriter writer(out, AstWriter::Format::Sexp);
+    node.Dump(writer);
+  }
+  fclose(out);
+  string text(buf, size);
+  free(buf);
+  return text;
+}
+
+// the values of the (type "value" ...) nodes in sexp whose type is one of types
+void collect(const string& dump, const vector<string>& types, set<string>& out) {
+  for (auto& type : types) {
+    string open = "(" + type + " \"";
+    for (size_t pos = dump.find(open); pos != string::npos;
+         pos = dump.find(open, pos)) {
+      pos += open.size();
+      size_t close = dump.find('"', pos);
+      if (close == string::npos) break;
+      out.insert(dump.substr(pos, close - pos));
+    }
+  }
+}
+
+// flattens SAST -> CompUnitAST -> DeclOrFuncDefsAST -> ... into a list
+void collectItems(const BaseAST& root, vector<Item>& items) {
+  auto add = [&](const BaseAST* decl_or_func_def) {
+    auto wrapper = dynamic_cast<const DeclOrFuncDefAST*>(decl_or_func_def);
+    if (!wrapper) return false;
+    Item item;
+    item.node = wrapper->decl_or_func_def.get();
+    string dump = canonicalDump(*item.node);
+    item.own = toHex(xxh64(dump, 0)) + toHex(xxh64(dump, 1));
+    if (auto func = dynamic_cast<const FuncDefAST*>(item.node)) {
+      item.function = func->ident;
+      item.defines.push_back(func->ident);
+    } else {
+      set<string> names;
+      collect(dump, {"ConstDefAST", "VarDefAST"}, names);
+      item.defines.assign(names.begin(), names.end());
+    }
+    // called functions and used variables; picking up locals too only adds
+    // a few needless dependencies
+    collect(dump, {"IDENT", "LValAST"}, item.uses);
+    items.push_back(move(item));
+    return true;
+  };
+  auto s = dynamic_cast<const SAST*>(&root);
+  auto unit = s ? dynamic_cast<const CompUnitAST*>(s->comp_unit.get()) : nullptr;
+  if (!unit) return;
+  add(unit->decl_or_func_def.get());
+  const BaseAST* rest = unit->decl_or_func_defs.get();
+  while (auto list = dynamic_cast<const DeclOrFuncDefsAST*>(rest)) {
+    if (!add(list->decl_or_func_def.get())) break;
+    rest = list->decl_or_func_defs.get();
+  }
+}
+
+// Each item's key hashes its own and that of its transitive dependencies,
+// sorted by name. The key also changes when a name comes to refer to another
+// item, e.g. a newly added global of the same name.
+void computeKeys(const string& mode, vector<Item>& items) {
+  map<string, vector<size_t>> definers;
+  for (size_t i = 0; i < items.size(); i++) {
+    for (auto& name : items[i].defines) definers[name].push_back(i);
+  }
+  for (size_t i = 0; i < items.size(); i++) {
+    map<string, string> closure;  // name -> own
+    vector<size_t> stack{i};
+    set<size_t> seen{i};
+    while (!stack.empty()) {
+      size_t k = stack.back();
+      stack.pop_back();
+      for (auto& name : items[k].uses) {
+        auto it = definers.find(name);
+        if (it == definers.end()) continue;
+        for (size_t d : it->second) {
+          closure[name] += items[d].own;
+          if (seen.insert(d).second) stack.push_back(d);
+        }
+      }
+    }
+    string data = items[i].own + "\n";
+    for (auto& [name, own] : closure) data += name + " " + own + "\n";
+    items[i].key = cache::key(mode + " function", data);
+  }
+}
+
+// a cache entry: an "effect N" line, then the function's IR text
+bool loadCached(Item& item) {
+  string data;
+  if (!cache::load(item.key, data)) return false;
+  if (data.compare(0, 7, "effect ") != 0 || data.size() < 9 ||
+      data[8] != '\n' || data[7] < '0' || data[7] > '2') {
+    return false;
+  }
+  item.effect = ir::FuncEffect(data[7] - '0');
+  item.text = data.substr(9);
+  return true;
+}
+
+void saveCached(const Item& item) {
+  cache::save(item.key, "effect " + to_string(int(item.effect)) + "\n" +
+                            item.text);
+}
+
+// the name in a segment's "fun @name("
+string functionOf(const string& text) {
+  size_t pos = text.find("fun @");
+  if (pos == string::npos) return "";
+  pos += 5;
+  return text.substr(pos, text.find('(', pos) - pos);
+}
+}  // namespace
+
+bool compile(const driver::Unit& unit, const BaseAST& ast, int jobs) {
+  CompilationContext& ctx = context();
+  vector<Item> items;
+  {
+    stats::ScopedPhase phase("fingerprint");
+    collectItems(ast, items);
+    computeKeys(unit.mode, items);
+    for (auto& item : items) {
+      if (!item.function.empty() && loadCached(item)) {
+        item.cached = true;
+        ctx.external_effects[item.function] = item.effect;
+      }
+    }
+  }
+
+  {
+    stats::ScopedPhase phase("lowering");
+    for (auto& item : items) {
+      size_t before = ctx.ir.size();
+      if (!item.cached) item.node->toIr(unit.output);
+      if (item.function.empty() && ctx.ir.size() != before) {
+        // the front end emits no IR for global declarations today; if it
+        // ever does, that output cannot be attributed to an item yet, so
+        // just recompile everything
+        ctx.ir.clear();
+        ctx.external_effects.clear();
+        for (auto& it : items) it.cached = false;
+        ast.toIr(unit.output);
+        break;
+      }
+    }
+  }
+
+  // callers' optimizations need these functions' effects, which later runs
+  // take from the cache. As in a full compile they are computed after
+  // lowering and before optimizing (only memoize, last in the pipeline,
+  // could change them)
+  map<string, ir::FuncEffect> effects;
+  {
+    stats::ScopedPhase phase("fingerprint");
+    ir::PurityInfo purity(ctx.ir, ctx.external_effects);
+    for (auto& item : items) {
+      if (!item.cached && !item.function.empty()) {
+        item.effect = purity.effect(item.function);
+      }
+    }
+  }
+
+  ir::optimize(ctx.ir);
+
+  stats::ScopedPhase phase("emission");
+  map<string, string> texts;
+  string trailer;
+  for (auto& text : ir::IR_DUMP::formatFunctions(ctx.ir, jobs)) {
+    string name = functionOf(text);
+    if (name.empty()) {
+      trailer += text;
+    } else {
+      texts[name] += text;
+    }
+  }
+  ofstream ofs(unit.output, ios::out | ios::trunc);
+  for (auto& item : items) {
+    if (item.function.empty()) continue;
+    if (!item.cached) {
+      item.text = texts[item.function];
+      saveCached(item);
+    }
+    ofs << item.text;
+  }
+  ofs << trailer;
+  return bool(ofs);
+}
+}  // namespace incremental
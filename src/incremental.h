@@ -0,0 +1,16 @@
+#pragma once
+#include "driver.h"
+
+class BaseAST;
+
+// --incremental: caches each top-level function and declaration (each item
+// of DeclOrFuncDefsAST) separately. An item's fingerprint covers its own AST
+// and those of every top-level item it refers to, directly or not, so after
+// editing one function only it and its (indirect) callers are lowered,
+// optimized and emitted again. The other functions' output and effects (for
+// their callers' purity analysis) come from --cache-dir.
+namespace incremental {
+    // compiles the already parsed ast in the current CompilationContext and
+    // writes unit.output
+    bool compile(const driver::Unit& unit, const BaseAST& ast, int jobs);
+}  // namespace incremental
@@ -0,0 +1,296 @@
+#include "interp.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include "runtime.h"
+#include "threaded_code.h"
+
+namespace interp {
+namespace {
+using namespace ir;
+
+const size_t FRAME_SLOTS = 16u << 20;    // all live frames together
+const size_t THREAD_STACK = 512u << 20;  // execute() recurses once per call
+
+// calloc'd, so pages are only touched once the program uses them
+class Words {
+ public:
+  explicit Words(size_t n) : p(static_cast<int32_t*>(calloc(n, sizeof(int32_t)))), n(n) {
+    if (!p) throw bad_alloc();
+  }
+  ~Words() { free(p); }
+  Words(const Words&) = delete;
+  Words& operator=(const Words&) = delete;
+  int32_t& operator[](size_t k) { return p[k]; }
+  size_t size() const { return n; }
+
+ private:
+  int32_t* p;
+  size_t n;
+};
+
+class Machine;
+int32_t execute(Machine& vm, const Function* fn, const int32_t* args);
+
+class Machine {
+ public:
+  const Program& program;
+  Words memory;
+  uint32_t heap_top;  // bytes in use by globals and live stack arrays
+  Words frames;
+  size_t sp = 0;
+  const void* const* handlers = nullptr;
+
+  explicit Machine(const Program& program)
+      : program(program), memory(MEMORY_BYTES / 4), frames(FRAME_SLOTS) {
+    copy(program.data.begin(), program.data.end(), &memory[0]);
+    heap_top = program.data.size() * 4;
+  }
+
+  [[noreturn]] void trap(const Function& fn, const string& what) {
+    fflush(stdout);
+    cerr << "run: " << what << " in @" << fn.name << endl;
+    exit(1);
+  }
+
+  int32_t* word(const Function& fn, int32_t addr, int32_t count = 1) {
+    uint32_t a = addr;
+    if ((a & 3) || a >= MEMORY_BYTES || count > int32_t((MEMORY_BYTES - a) / 4)) {
+      trap(fn, "bad address " + to_string(a));
+    }
+    return &memory[a / 4];
+  }
+
+  int32_t builtin(const Function& caller, int k, const int32_t* args) {
+    switch (runtime::Builtin(k)) {
+      case runtime::GETINT:
+        return runtime::getint();
+      case runtime::GETCH:
+        return runtime::getch();
+      case runtime::GETARRAY: {
+        int32_t n = runtime::getint();
+        int32_t* a = word(caller, args[0], n);
+        for (int32_t i = 0; i < n; i++) a[i] = runtime::getint();
+        return n;
+      }
+      case runtime::PUTINT:
+        runtime::putint(args[0]);
+        break;
+      case runtime::PUTCH:
+        runtime::putch(args[0]);
+        break;
+      case runtime::PUTARRAY:
+        runtime::putarray(args[0], word(caller, args[1], args[0]));
+        break;
+      case runtime::STARTTIME:
+        runtime::starttime();
+        break;
+      case runtime::STOPTIME:
+        runtime::stoptime();
+        break;
+      default:
+        break;
+    }
+    return 0;
+  }
+};
+
+// fn == nullptr only hands out the handler addresses
+int32_t execute(Machine& vm, const Function* fn, const int32_t* args) {
+  static const void* const table[HANDLER_COUNT] = {
+      &&mov, &&add, &&sub, &&mul, &&div, &&mod, &&and_, &&or_,
+      &&eq, &&ne, &&lt, &&gt, &&le, &&ge, &&sal, &&sar,
+      &&cmp, &&jm, &&jeq, &&jne, &&jlt, &&jgt, &&jle, &&jge,
+      &&moveq, &&movne, &&movlt, &&movgt, &&movle, &&movge,
+      &&load, &&store, &&alloc, &&set_arg, &&call, &&ret,
+      &&vsetvl, &&vload, &&vstore, &&vadd, &&vsub, &&vmul,
+      &&vaddx, &&vsubx, &&vmulx, &&vredsum,
+  };
+  if (!fn) {
+    vm.handlers = table;
+    return 0;
+  }
+
+  if (vm.sp + fn->frame_size > vm.frames.size()) vm.trap(*fn, "stack overflow");
+  int32_t* r = &vm.frames[vm.sp];
+  size_t saved_sp = vm.sp;
+  uint32_t saved_heap = vm.heap_top;
+  vm.sp += fn->frame_size;
+  size_t n = fn->consts.size();
+  memcpy(r, fn->consts.data(), n * sizeof(int32_t));
+  memset(r + n, 0, (fn->frame_size - n) * sizeof(int32_t));
+  if (args) {
+    for (size_t k = 0; k < fn->params.size(); k++) r[fn->params[k]] = args[k];
+  }
+
+  const Code* code = fn->code.data();
+  const Code* pc = code;
+  int32_t lhs = 0, rhs = 0;  // operands of the last cmp
+  int32_t vl = 0;
+  int32_t result;
+
+#define NEXT goto *(++pc)->handler
+#define JUMP(cond)                                   \
+  do {                                               \
+    if (cond) pc = code + pc->d;                     \
+    else pc++;                                       \
+    goto *pc->handler;                               \
+  } while (0)
+#define BINARY(expr)                                 \
+  do {                                               \
+    int32_t x = r[pc->b], y = r[pc->c];              \
+    r[pc->a] = (expr);                               \
+    NEXT;                                            \
+  } while (0)
+#define WRAP(op) int32_t(uint32_t(x) op uint32_t(y))
+#define SELECT(cond) r[pc->a] = (cond) ? r[pc->b] : r[pc->c]; NEXT
+#define VECTOR(op, scalar)                                             \
+  do {                                                                 \
+    for (int32_t i = 0; i < vl; i++) {                                 \
+      uint32_t x = r[pc->b + i], y = r[pc->c + (scalar ? 0 : i)];      \
+      r[pc->a + i] = int32_t(x op y);                                  \
+    }                                                                  \
+    NEXT;                                                              \
+  } while (0)
+
+  goto *pc->handler;
+mov:
+  r[pc->a] = r[pc->b];
+  NEXT;
+add: BINARY(WRAP(+));
+sub: BINARY(WRAP(-));
+mul: BINARY(WRAP(*));
+div:
+  if (r[pc->c] == 0) vm.trap(*fn, "division by zero");
+  BINARY(y == -1 ? WRAP(*) : x / y);
+mod:
+  if (r[pc->c] == 0) vm.trap(*fn, "division by zero");
+  BINARY(y == -1 ? 0 : x % y);
+and_: BINARY(x & y);
+or_: BINARY(x | y);
+eq: BINARY(x == y);
+ne: BINARY(x != y);
+lt: BINARY(x < y);
+gt: BINARY(x > y);
+le: BINARY(x <= y);
+ge: BINARY(x >= y);
+sal: BINARY(int32_t(uint32_t(x) << (y & 31)));
+sar: BINARY(x >> (y & 31));
+cmp:
+  lhs = r[pc->b];
+  rhs = r[pc->c];
+  NEXT;
+jm:
+  pc = code + pc->d;
+  goto *pc->handler;
+jeq: JUMP(lhs == rhs);
+jne: JUMP(lhs != rhs);
+jlt: JUMP(lhs < rhs);
+jgt: JUMP(lhs > rhs);
+jle: JUMP(lhs <= rhs);
+jge: JUMP(lhs >= rhs);
+moveq: SELECT(lhs == rhs);
+movne: SELECT(lhs != rhs);
+movlt: SELECT(lhs < rhs);
+movgt: SELECT(lhs > rhs);
+movle: SELECT(lhs <= rhs);
+movge: SELECT(lhs >= rhs);
+load:
+  r[pc->a] = *vm.word(*fn, r[pc->b] + r[pc->c]);
+  NEXT;
+store:
+  *vm.word(*fn, r[pc->a] + r[pc->b]) = r[pc->c];
+  NEXT;
+alloc: {
+  uint32_t size = (uint32_t(r[pc->b]) + 3) & ~3u;
+  if (size > MEMORY_BYTES - vm.heap_top) vm.trap(*fn, "out of memory");
+  r[pc->a] = vm.heap_top;
+  vm.heap_top += size;
+  NEXT;
+}
+set_arg:
+  r[pc->a] = r[pc->b];
+  NEXT;
+call: {
+  const int32_t* out = r + pc->c;
+  r[pc->a] = pc->d >= 0
+                 ? execute(vm, &vm.program.functions[pc->d], out)
+                 : vm.builtin(*fn, -1 - pc->d, out);
+  NEXT;
+}
+ret:
+  result = r[pc->b];
+  goto done;
+vsetvl:
+  vl = r[pc->b] < 0 ? 0 : min(r[pc->b], VLMAX);
+  r[pc->a] = vl;
+  NEXT;
+vload:
+  memcpy(&r[pc->a], vm.word(*fn, r[pc->b] + r[pc->c], vl), vl * 4);
+  NEXT;
+vstore:
+  memcpy(vm.word(*fn, r[pc->a] + r[pc->b], vl), &r[pc->c], vl * 4);
+  NEXT;
+vadd: VECTOR(+, false);
+vsub: VECTOR(-, false);
+vmul: VECTOR(*, false);
+vaddx: VECTOR(+, true);
+vsubx: VECTOR(-, true);
+vmulx: VECTOR(*, true);
+vredsum: {
+  uint32_t sum = r[pc->b];
+  for (int32_t i = 0; i < vl; i++) sum += uint32_t(r[pc->c + i]);
+  r[pc->a] = int32_t(sum);
+  NEXT;
+}
+
+#undef NEXT
+#undef JUMP
+#undef BINARY
+#undef WRAP
+#undef SELECT
+#undef VECTOR
+
+done:
+  vm.sp = saved_sp;
+  vm.heap_top = saved_heap;
+  return result;
+}
+// swaps handler numbers for addresses
+void link(Program& program, const void* const* handlers) {
+  for (auto& fn : program.functions) {
+    for (auto& code : fn.code) {
+      code.handler = handlers[reinterpret_cast<uintptr_t>(code.handler)];
+    }
+  }
+}
+
+}  // namespace
+
+bool run(const CompactModule& m, int& exit_code, Readback* readback) {
+  Program program;
+  string error;
+  if (!decode(m, program, error)) {
+    cerr << "run: " << error << endl;
+    return false;
+  }
+  Machine vm(program);
+  execute(vm, nullptr, nullptr);
+  link(program, vm.handlers);
+
+  // deep recursion in the program is deep recursion in execute(), so it
+  // gets a thread with a stack to match
+  int32_t result = 0;
+  runtime::runWithStack(THREAD_STACK, [&] {
+    result = execute(vm, &program.functions[program.main_index], nullptr);
+  });
+  fflush(stdout);
+  runtime::reportTimers();
+  if (readback) readBack(program, &vm.memory[0], *readback);
+  exit_code = result & 0xff;
+  return true;
+}
+}  // namespace interp
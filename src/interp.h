@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "compact_ir.h"
+
+// -run: executes a module directly, with no backend, assembler or emulator.
+//
+// Each function is decoded once into threaded code (threaded_code.h): an
+// array of records that hold the address of their handler (computed goto)
+// and the frame slots of their operands. Immediates, globals' addresses and
+// front-end constants such as "0" become slots too, preloaded on entry, so
+// every handler just indexes the frame. Calls into the SysY library go to
+// runtime.h.
+namespace interp {
+    // Words of a global to copy out once @main has returned, such as the
+    // counters of -fprofile-generate. words ends up with `count` entries,
+    // or empty if the global does not exist or is shorter.
+    struct Readback {
+        std::string global;
+        size_t count = 0;
+        std::vector<int32_t> words;
+    };
+
+    // Runs @main. Returns false, with the reason on stderr, if the module
+    // cannot be run; a runtime error (division by zero, a load outside
+    // memory, ...) is reported and ends the process with status 1.
+    bool run(const ir::CompactModule& m, int& exit_code,
+             Readback* readback = nullptr);
+}  // namespace interp
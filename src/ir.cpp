@@ -1,13 +1,20 @@
 #pragma once
 #include "ir.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
 #include <string>
+#include "compact_ir.h"
+#include "koopa.h"
+#include "thread_pool.h"
 
 namespace ir {
 OpName::OpName() : type(OpName::Type::Null) {}
-OpName::OpName(std::string name) : type(OpName::Type::Var), name(name) {}
-OpName::OpName(int value) : type(OpName::Type::Imm), value(value) {}
+OpName::OpName(std::string name) : name(name), type(OpName::Type::Var) {}
+OpName::OpName(int value) : value(value), type(OpName::Type::Imm) {}
 bool OpName::is_var() const { return this->type == OpName::Type::Var; }
 bool OpName::is_local_var() const {
   return (this->is_var()) && (this->name[0] == '%');
@@ -17,6 +24,19 @@ bool OpName::is_global_var() const {
 }
 bool OpName::is_imm() const { return this->type == OpName::Type::Imm; }
 bool OpName::is_null() const { return this->type == OpName::Type::Null; }
+bool OpName::get_const(int& value) const {
+  if (this->is_imm()) {
+    value = this->value;
+    return true;
+  }
+  if (!this->is_var() || this->name.empty()) return false;
+  const char* str = this->name.c_str();
+  char* end = nullptr;
+  long v = strtol(str, &end, 10);
+  if (end == str || *end != '\0') return false;
+  value = (int)v;
+  return true;
+}
 
 bool OpName::operator==(const OpName& other) const {
   if (this->type != other.type) return false;
@@ -30,6 +50,7 @@ bool OpName::operator==(const OpName& other) const {
   }
 }
 string OpName::toString() const {
+    if (this->is_imm()) return to_string(this->value);
     return this->name;
 }
 
@@ -64,84 +85,193 @@ IR::IR(OpCode op_code, std::string label)
       op2(OpName()),
       op3(OpName()),
       label(label) {}
-// bool IR::some(decltype(&syc::ir::OpName::is_var) callback,
-//               bool include_dest) const {
-//   return this->some([callback](OpName op) { return (op.*callback)(); },
-//                     include_dest);
-// }
-// bool IR::some(std::function<bool(const syc::ir::OpName&)> callback,
-//               bool include_dest) const {
-//   return (include_dest && callback(this->dest)) || callback(this->op1) ||
-//          callback(this->op2) || callback(this->op3);
-// }
-// void IR::forEachOp(std::function<void(const syc::ir::OpName&)> callback,
-//                    bool include_dest) const {
-//   this->some(
-//       [callback](const syc::ir::OpName& op) {
-//         callback(op);
-//         return false;
-//       },
-//       include_dest);
-// }
+bool IR::some(decltype(&ir::OpName::is_var) callback,
+              bool include_dest) const {
+  return this->some([callback](const OpName& op) { return (op.*callback)(); },
+                    include_dest);
+}
+bool IR::some(std::function<bool(const ir::OpName&)> callback,
+              bool include_dest) const {
+  return (include_dest && callback(this->dest)) || callback(this->op1) ||
+         callback(this->op2) || callback(this->op3);
+}
+void IR::forEachOp(std::function<void(const ir::OpName&)> callback,
+                   bool include_dest) const {
+  this->some(
+      [callback](const ir::OpName& op) {
+        callback(op);
+        return false;
+      },
+      include_dest);
+}
+
+// 条件跳转和条件传送的助记符
+static const char* opName(OpCode op_code) {
+    switch (op_code) {
+        case OpCode::JEQ: return "jeq";
+        case OpCode::JNE: return "jne";
+        case OpCode::JLE: return "jle";
+        case OpCode::JLT: return "jlt";
+        case OpCode::JGE: return "jge";
+        case OpCode::JGT: return "jgt";
+        case OpCode::MOVEQ: return "moveq";
+        case OpCode::MOVNE: return "movne";
+        case OpCode::MOVLE: return "movle";
+        case OpCode::MOVLT: return "movlt";
+        case OpCode::MOVGE: return "movge";
+        case OpCode::MOVGT: return "movgt";
+        default: return "?";
+    }
+}
 
 void IR::print(string filename, bool verbose) const {
     ofstream ofs;
     ofs.open(filename, ios::out|ios::app);
+    print(ofs, verbose);
+}
+
+void IR::print(ostream& ofs, bool verbose) const {
     switch(this->op_code) {
         case OpCode::FUNCTION_BEGIN:
         case OpCode::FUNCTION_END:
-            ofs << this->label<< endl;
+            ofs << this->label<< "\n";
             break;
         case OpCode::INFO:
-            ofs << this->label<< endl;
+            ofs << this->label<< "\n";
+            break;
+        case OpCode::LABEL:
+            ofs << this->label << ":" << "\n";
             break;
         case OpCode::RET:
-            ofs << "ret " << this->op1.toString() << endl;
+            ofs << "ret " << this->op1.toString() << "\n";
             break;
         case OpCode::EQ:
-            ofs << this->dest.toString() << " = eq " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = eq " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::NE:
-            ofs << this->dest.toString() << " = ne " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = ne " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::ADD:
-            ofs << this->dest.toString() << " = add " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = add " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::SUB:
-            ofs << this->dest.toString() << " = sub " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = sub " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::MUL:
-            ofs << this->dest.toString() << " = mul " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = mul " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::DIV:
-            ofs << this->dest.toString() << " = div " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = div " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::MOD:
-            ofs << this->dest.toString() << " = mod " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = mod " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::OR:
-            ofs << this->dest.toString() << " = or " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = or " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::AND:
-            ofs << this->dest.toString() << " = and " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = and " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::LT:
-            ofs << this->dest.toString() << " = lt " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = lt " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::GT:
-            ofs << this->dest.toString() << " = gt " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = gt " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::LE:
-            ofs << this->dest.toString() << " = le " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = le " << this->op1.toString() << ", " << this->op2.toString() << "\n";
             break;
         case OpCode::GE:
-            ofs << this->dest.toString() << " = ge " << this->op1.toString() << ", " << this->op2.toString() << endl;
+            ofs << this->dest.toString() << " = ge " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::SAL:
+            ofs << this->dest.toString() << " = shl " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::SAR:
+            ofs << this->dest.toString() << " = sar " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::jm:
+            ofs << "jump " << this->label << "\n";
+            break;
+        // 下面这些 Koopa 里没有对应的指令 (标志位, 按字节偏移的访存, 数据段,
+        // 向量), 用 IR 自己的写法原样打印出来, 不能悄悄丢掉
+        case OpCode::MALLOC_IN_STACK:
+            ofs << this->dest.toString() << " = alloca " << this->op1.toString() << "\n";
+            break;
+        case OpCode::MOV:
+            ofs << this->dest.toString() << " = mov " << this->op1.toString() << "\n";
+            break;
+        case OpCode::PHI_MOV:
+            ofs << this->dest.toString() << " = phi_mov " << this->op1.toString() << "\n";
+            break;
+        case OpCode::SET_ARG:
+            ofs << "arg " << this->dest.toString() << ", " << this->op1.toString() << "\n";
+            break;
+        case OpCode::call:
+            if (!this->dest.is_null()) ofs << this->dest.toString() << " = ";
+            ofs << "call " << this->label << "\n";
+            break;
+        case OpCode::cmp:
+            ofs << "cmp " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::JEQ:
+        case OpCode::JNE:
+        case OpCode::JLE:
+        case OpCode::JLT:
+        case OpCode::JGE:
+        case OpCode::JGT:
+            ofs << opName(this->op_code) << " " << this->label << "\n";
+            break;
+        case OpCode::MOVEQ:
+        case OpCode::MOVNE:
+        case OpCode::MOVLE:
+        case OpCode::MOVLT:
+        case OpCode::MOVGE:
+        case OpCode::MOVGT:
+            ofs << this->dest.toString() << " = " << opName(this->op_code) << " " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::LOAD:
+            ofs << this->dest.toString() << " = load " << this->op1.toString() << "[" << this->op2.toString() << "]\n";
+            break;
+        case OpCode::STORE:
+            ofs << "store " << this->op3.toString() << ", " << this->op1.toString() << "[" << this->op2.toString() << "]\n";
+            break;
+        case OpCode::DATA_BEGIN:
+            ofs << "data " << this->label << " {\n";
+            break;
+        case OpCode::DATA_WORD:
+            ofs << "  word " << this->op1.toString() << "\n";
+            break;
+        case OpCode::DATA_SPACE:
+            ofs << "  space " << this->op1.toString() << "\n";
+            break;
+        case OpCode::DATA_END:
+            ofs << "}\n";
+            break;
+        case OpCode::VSETVL:
+            ofs << this->dest.toString() << " = vsetvl " << this->op1.toString() << "\n";
+            break;
+        case OpCode::VLOAD:
+            ofs << this->dest.toString() << " = vload " << this->op1.toString() << "[" << this->op2.toString() << "]\n";
+            break;
+        case OpCode::VSTORE:
+            ofs << "vstore " << this->op3.toString() << ", " << this->op1.toString() << "[" << this->op2.toString() << "]\n";
+            break;
+        case OpCode::VADD:
+            ofs << this->dest.toString() << " = vadd " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::VSUB:
+            ofs << this->dest.toString() << " = vsub " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::VMUL:
+            ofs << this->dest.toString() << " = vmul " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::VREDSUM:
+            ofs << this->dest.toString() << " = vredsum " << this->op1.toString() << ", " << this->op2.toString() << "\n";
+            break;
+        case OpCode::NOOP:
             break;
-        // case OpCode::
-        default:break;
     }
-    ofs.flush();
-    ofs.close();
 }
 
 IR_DUMP::IR_DUMP(string filename): filename(filename) {}
@@ -149,27 +279,113 @@ void IR_DUMP::writeALL(vector<IR*>IRList) {
     this->writeLibFuncs();
     this->writeOpIr(IRList);
 }
+const string& IR_DUMP::libFuncDecls() {
+    // 只拼一次; server 模式下启动时就准备好
+    static const string decls =
+        "decl @getint(): i32\n"
+        "decl @getch(): i32\n"
+        "decl @getarray(*i32): i32\n"
+        "decl @putint(i32)\n"
+        "decl @putch(i32)\n"
+        "decl @putarray(i32, *i32)\n"
+        "decl @starttime()\n"
+        "decl @stoptime()\n\n";
+    return decls;
+}
 void IR_DUMP::writeLibFuncs() {
-    ofstream ofs;
-    ofs.open(this->filename, ios::out|ios::app);
-
-    ofs.open(filename, ios::trunc);
-    ofs << "decl @getint(): i32\n";
-    ofs << "decl @getch(): i32\n";
-    ofs << "decl @getarray(*i32): i32\n";
-    ofs << "decl @putint(i32)\n";
-    ofs << "decl @putch(i32)\n";
-    ofs << "decl @putarray(i32, *i32)\n";
-    ofs << "decl @starttime()\n";
-    ofs << "decl @stoptime()\n\n";
-
-    ofs.flush();
-    ofs.close();
+    ofstream ofs(this->filename, ios::out|ios::trunc);
+    ofs << libFuncDecls();
 }
 void IR_DUMP::writeOpIr(vector<IR*>IRList) {
     for (auto it = IRList.begin(); it != IRList.end(); it++) {
         (*it)->print(this->filename);
     }
 }
+void IR_DUMP::writeOpIr(const ir::IRList& irs) {
+    writeOpIr(irs, 1);
+}
+// count 段分别用 format 格式化成字符串, jobs 个线程同时做
+static vector<string> formatSegments(size_t count, int jobs,
+                                     const function<void(size_t, ostream&)>& format) {
+    vector<string> texts(count);
+    auto run = [&](size_t k) {
+        ostringstream oss;
+        format(k, oss);
+        texts[k] = oss.str();
+    };
+    if (jobs == 1 || count <= 1) {
+        for (size_t k = 0; k < count; k++) run(k);
+    } else {
+        ThreadPool pool(jobs > 0 ? min<int>(jobs, count) : 0);
+        for (size_t k = 0; k < count; k++) {
+            pool.submit([&run, k] { run(k); });
+        }
+        pool.wait();
+    }
+    return texts;
+}
+vector<string> IR_DUMP::formatFunctions(const ir::IRList& irs, int jobs) {
+    // 按函数切段, 各段分别格式化成字符串
+    vector<pair<IRList::const_iterator, IRList::const_iterator>> segments;
+    auto start = irs.begin();
+    for (auto it = irs.begin(); it != irs.end(); it++) {
+        if (it->op_code == OpCode::FUNCTION_END) {
+            segments.push_back({start, std::next(it)});
+            start = std::next(it);
+        }
+    }
+    if (start != irs.end()) segments.push_back({start, irs.end()});
+    return formatSegments(segments.size(), jobs, [&](size_t k, ostream& os) {
+        for (auto it = segments[k].first; it != segments[k].second; it++) {
+            if (it->op_code != OpCode::NOOP) it->print(os);
+        }
+    });
+}
+vector<string> IR_DUMP::formatFunctions(const CompactModule& m, int jobs) {
+    // 切法和上面一样, 段是 insts 的下标区间
+    vector<pair<size_t, size_t>> segments;
+    size_t start = 0;
+    for (size_t i = 0; i < m.insts.size(); i++) {
+        if (m.insts[i].op_code == OpCode::FUNCTION_END) {
+            segments.push_back({start, i + 1});
+            start = i + 1;
+        }
+    }
+    if (start != m.insts.size()) segments.push_back({start, m.insts.size()});
+    return formatSegments(segments.size(), jobs, [&](size_t k, ostream& os) {
+        for (size_t i = segments[k].first; i < segments[k].second; i++) {
+            if (m.insts[i].op_code != OpCode::NOOP) m.toIR(m.insts[i]).print(os);
+        }
+    });
+}
+void IR_DUMP::writeOpIr(const ir::IRList& irs, int jobs) {
+    writeOpIr(formatFunctions(irs, jobs));
+}
+void IR_DUMP::writeOpIr(const vector<string>& functions) {
+    // 按原来的顺序写出去
+    ofstream ofs(this->filename, ios::out|ios::trunc);
+    for (auto& text : functions) ofs << text;
+}
+bool IR_DUMP::writeLlvm(const ir::IRList& irs, int jobs, string& error) {
+    return writeLlvm(formatFunctions(irs, jobs), error);
+}
+bool IR_DUMP::writeLlvm(const vector<string>& functions, string& error) {
+    // libkoopa 只认完整的程序, 用到的库函数要先声明
+    string text = libFuncDecls();
+    for (auto& function : functions) text += function;
+    koopa_program_t program;
+    koopa_error_code_t ret = koopa_parse_from_string(text.c_str(), &program);
+    if (ret != KOOPA_EC_SUCCESS) {
+        error = "libkoopa rejected the Koopa IR (error " + to_string(ret) + ")";
+        return false;
+    }
+    ret = koopa_dump_llvm_to_file(program, this->filename.c_str());
+    koopa_delete_program(program);
+    if (ret != KOOPA_EC_SUCCESS) {
+        error = "cannot write LLVM IR (error " + to_string(ret) + ")";
+        return false;
+    }
+    return true;
+}
 
 }  // namespace syc::ir
@@ -17,9 +17,11 @@ namespace ir {
                 Null,
             };
         public:
-            Type type;
+            // name first: with the two ints packed after it an OpName is 40
+            // bytes instead of 48
             string name;
             int value;
+            Type type;
             OpName();
             OpName(std::string name_);
             OpName(int value_);
@@ -28,13 +30,15 @@ namespace ir {
             bool is_global_var() const;
             bool is_imm() const;
             bool is_null() const;
+            // immediates, including the ones the front end spells as names
+            bool get_const(int& value) const;
             bool operator==(const OpName& other) const;
             string toString() const;
 
     };
     enum class OpCode {
-        // MALLOC_IN_STACK,  // dest = offset(new StackArray(size op1))
-        // MOV,              // dest = op1
+        MALLOC_IN_STACK,  // dest = offset(new StackArray(size op1))
+        MOV,              // dest = op1
         FUNCTION_BEGIN,   // FUNCTION_BEGIN
         FUNCTION_END,     // FUNCTION_END
         INFO,             // info for compiler
@@ -53,8 +57,8 @@ namespace ir {
         LE,               // dest = op1 <= op2
         GE,               // dest = op1 >= op2
 
-        // SET_ARG,          // if dest < 4: R(dest)) = op1 else: push_stack(op1)
-        call,             // call label
+        SET_ARG,          // if dest < 4: R(dest)) = op1 else: push_stack(op1)
+        call,             // dest = call label(args from the SET_ARGs right before)
         cmp,              // cmp op1, op2
         jm,               // jmp label
         JEQ,              // if EQ: jmp label
@@ -79,15 +83,20 @@ namespace ir {
         DATA_SPACE,       //.space
         DATA_END,         // nothing
         PHI_MOV,          // PHI
+        VSETVL,           // dest = min(op1, VLMAX), element count of this strip
+        VLOAD,            // dest[0:vl] = op1[op2 : op2 + vl]
+        VSTORE,           // op1[op2 : op2 + vl] = op3[0:vl]
+        VADD,             // dest = op1 + op2, op2 may be a scalar
+        VSUB,             // dest = op1 - op2, op2 may be a scalar
+        VMUL,             // dest = op1 * op2, op2 may be a scalar
+        VREDSUM,          // dest = op1 + sum(op2[0:vl])
         NOOP,             // no operation
     };
     class IR {
         public:
-            int line, column;
             OpCode op_code;
             OpName dest, op1, op2, op3;
             string label;
-            list<IR>::iterator phi_block;
             IR(OpCode op_code, OpName dest, OpName op1, OpName op2, OpName op3,
                 string label = "");
             IR(OpCode op_code, OpName dest, OpName op1, OpName op2,
@@ -96,15 +105,18 @@ namespace ir {
             IR(OpCode op_code, OpName dest, string label = "");
             IR(OpCode op_code, string label = "");
 
-            // bool some(decltype(&ir::OpName::is_var) callback,
-            //             bool include_dest = true) const;
-            // bool some(std::function<bool(const ir::OpName&)> callback,
-            //             bool include_dest = true) const;
-            // void forEachOp(std::function<void(const ir::OpName&)> callback,
-            //                 bool include_dest = true) const;
+            bool some(decltype(&ir::OpName::is_var) callback,
+                        bool include_dest = true) const;
+            bool some(std::function<bool(const ir::OpName&)> callback,
+                        bool include_dest = true) const;
+            void forEachOp(std::function<void(const ir::OpName&)> callback,
+                            bool include_dest = true) const;
             void print(string filename, bool verbose = false) const;
+            void print(ostream& os, bool verbose = false) const;
 
     };
+    typedef list<IR> IRList;
+    class CompactModule;
         
     class IR_DUMP {
         public:
@@ -114,7 +126,22 @@ namespace ir {
         void writeALL(vector<IR*>IRList);
 
         void writeLibFuncs();
+        static const string& libFuncDecls();
         void writeOpIr(vector<IR*>IRList);
+        void writeOpIr(const ir::IRList& irs);
+        // jobs 个线程同时格式化各个函数, 输出顺序不变
+        void writeOpIr(const ir::IRList& irs, int jobs);
+        // 按函数切段格式化: 每段是一个函数和它前面的非函数部分 (比如 memoize
+        // 加的全局表), 最后一个函数之后还有东西时单独成一段
+        static vector<string> formatFunctions(const ir::IRList& irs, int jobs);
+        // 同上, 直接从 CompactModule (比如读进来的 .sir) 格式化, 不先转回 IRList
+        static vector<string> formatFunctions(const CompactModule& m, int jobs);
+        // 写出 formatFunctions 格式化好的各段
+        void writeOpIr(const vector<string>& functions);
+        // -llvm: 拼上库函数的声明, 交给 libkoopa 转成 LLVM IR 写到 filename.
+        // libkoopa 不接受这段 Koopa IR 时返回 false, 原因在 error 里
+        bool writeLlvm(const ir::IRList& irs, int jobs, string& error);
+        bool writeLlvm(const vector<string>& functions, string& error);
         
     };
     
@@ -0,0 +1,219 @@
+#include "ir_image.h"
+
+#include <cstring>
+#include <type_traits>
+#include <unordered_set>
+#include "hash.h"
+
+namespace ir {
+namespace {
+const char MAGIC[4] = {'S', 'Y', 'I', 'R'};
+
+static_assert(std::is_trivially_copyable<Inst>::value &&
+                  std::is_trivially_copyable<CompactModule::FunctionRange>::value,
+              "image records are copied as raw bytes");
+
+uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+// where each section starts, from the counts in the header; 64-bit so that
+// the counts of a corrupt header cannot wrap around
+struct Layout {
+  uint64_t string_offsets, wide_imms, functions, insts, strings, end;
+
+  explicit Layout(const ImageHeader& h) {
+    string_offsets = sizeof(ImageHeader);
+    wide_imms = align8(string_offsets +
+                       (uint64_t(h.value_count) + h.label_count + 1) * 4);
+    functions = align8(wide_imms + uint64_t(h.wide_count) * 4);
+    insts = align8(functions + uint64_t(h.function_count) *
+                                   sizeof(CompactModule::FunctionRange));
+    strings = align8(insts + uint64_t(h.inst_count) * sizeof(Inst));
+    end = strings + h.strings_size;
+  }
+};
+
+template <typename T>
+void put(string& out, uint64_t offset, const T* data, size_t n) {
+  if (n > 0) memcpy(&out[offset], data, n * sizeof(T));
+}
+}  // namespace
+
+string encodeImage(const CompactModule& m) {
+  ImageHeader h;
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = IMAGE_VERSION;
+  h.value_count = m.valueCount();
+  h.label_count = m.labelCount();
+  h.wide_count = m.wideImmCount();
+  h.function_count = m.functions.size();
+  h.inst_count = m.insts.size();
+
+  string strings;
+  vector<uint32_t> offsets;
+  offsets.reserve(h.value_count + h.label_count + 1);
+  for (uint32_t id = 0; id < h.value_count; id++) {
+    offsets.push_back(strings.size());
+    strings += m.valueName(Operand::make(Operand::Value, id));
+  }
+  for (uint32_t id = 0; id < h.label_count; id++) {
+    offsets.push_back(strings.size());
+    strings += m.labelName(id);
+  }
+  offsets.push_back(strings.size());
+  h.strings_size = strings.size();
+
+  vector<int32_t> wide_imms;
+  for (uint32_t k = 0; k < h.wide_count; k++) {
+    wide_imms.push_back(m.immValue(Operand::make(Operand::WideImm, k)));
+  }
+
+  Layout layout(h);
+  h.size = layout.end;
+  string out(layout.end, '\0');
+  put(out, layout.string_offsets, offsets.data(), offsets.size());
+  put(out, layout.wide_imms, wide_imms.data(), wide_imms.size());
+  put(out, layout.functions, m.functions.data(), m.functions.size());
+  put(out, layout.insts, m.insts.data(), m.insts.size());
+  put(out, layout.strings, strings.data(), strings.size());
+  h.checksum = xxh64(out.data() + sizeof(h), out.size() - sizeof(h));
+  memcpy(&out[0], &h, sizeof(h));
+  return out;
+}
+
+bool isImage(string_view data) {
+  return data.size() >= sizeof(MAGIC) &&
+         memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool ImageView::open(string_view data, string& error) {
+  if (reinterpret_cast<uintptr_t>(data.data()) % 8 != 0) {
+    error = "image is not 8-byte aligned in memory";
+    return false;
+  }
+  if (data.size() < sizeof(ImageHeader) || !isImage(data)) {
+    error = "not an IR image";
+    return false;
+  }
+  auto h = reinterpret_cast<const ImageHeader*>(data.data());
+  if (h->version != IMAGE_VERSION) {
+    error = "IR image version " + to_string(h->version) + ", expected " +
+            to_string(IMAGE_VERSION);
+    return false;
+  }
+  Layout layout(*h);
+  if (h->size != data.size() || layout.end != data.size()) {
+    error = "IR image is truncated or has a corrupt header";
+    return false;
+  }
+  if (xxh64(data.data() + sizeof(*h), data.size() - sizeof(*h)) !=
+      h->checksum) {
+    error = "IR image checksum mismatch";
+    return false;
+  }
+
+  const char* base = data.data();
+  header = h;
+  string_offsets = reinterpret_cast<const uint32_t*>(base + layout.string_offsets);
+  wide_imms = reinterpret_cast<const int32_t*>(base + layout.wide_imms);
+  function_table = reinterpret_cast<const CompactModule::FunctionRange*>(
+      base + layout.functions);
+  inst_table = reinterpret_cast<const Inst*>(base + layout.insts);
+  strings = base + layout.strings;
+  if (!checkIds(error)) {
+    header = nullptr;
+    return false;
+  }
+  return true;
+}
+
+// the checksum catches damage, this catches images that were written wrong;
+// after it every accessor stays inside the data
+bool ImageView::checkIds(string& error) const {
+  uint32_t string_count = header->value_count + header->label_count;
+  for (uint32_t k = 0; k < string_count; k++) {
+    if (string_offsets[k] > string_offsets[k + 1]) {
+      error = "IR image has a corrupt string table";
+      return false;
+    }
+  }
+  if (string_offsets[0] != 0 ||
+      string_offsets[string_count] != header->strings_size) {
+    error = "IR image has a corrupt string table";
+    return false;
+  }
+  for (uint32_t k = 0; k < header->wide_count; k++) {
+    if (Operand::fitsInline(wide_imms[k])) {
+      error = "IR image has a corrupt immediate table";
+      return false;
+    }
+  }
+  // toModule interns the names in ID order, so a repeated name would give
+  // every later one the wrong ID
+  unordered_set<string_view> names;
+  for (uint32_t id = 0; id < header->value_count; id++) {
+    if (!names.insert(valueName(id)).second) {
+      error = "IR image repeats the value name " + string(valueName(id));
+      return false;
+    }
+  }
+  names.clear();
+  for (uint32_t id = 0; id < header->label_count; id++) {
+    if (!names.insert(labelName(id)).second) {
+      error = "IR image repeats the label " + string(labelName(id));
+      return false;
+    }
+  }
+  // functions are ascending, disjoint FUNCTION_BEGIN .. FUNCTION_END ranges
+  uint32_t prev_end = 0;
+  for (uint32_t f = 0; f < header->function_count; f++) {
+    auto& func = function_table[f];
+    bool ok = func.name < header->label_count && prev_end <= func.begin &&
+              func.begin < func.end && func.end <= header->inst_count &&
+              inst_table[func.begin].op_code == OpCode::FUNCTION_BEGIN &&
+              inst_table[func.end - 1].op_code == OpCode::FUNCTION_END;
+    if (!ok) {
+      error = "IR image has a corrupt function table";
+      return false;
+    }
+    prev_end = func.end;
+  }
+  auto in_range = [&](Operand op) {
+    switch (op.kind()) {
+      case Operand::Value:
+        return op.payload() < header->value_count;
+      case Operand::WideImm:
+        return op.payload() < header->wide_count;
+      case Operand::Null:
+        return op.payload() == 0;
+      default:
+        return true;
+    }
+  };
+  for (uint32_t i = 0; i < header->inst_count; i++) {
+    auto& inst = inst_table[i];
+    bool ok = uint32_t(inst.op_code) <= uint32_t(OpCode::NOOP) &&
+              (inst.label == Inst::NO_LABEL || inst.label < header->label_count);
+    for (int k = 0; ok && k < 4; k++) ok = in_range(inst.operand(k));
+    if (!ok) {
+      error = "IR image instruction " + to_string(i) + " is corrupt";
+      return false;
+    }
+  }
+  return true;
+}
+
+CompactModule ImageView::toModule() const {
+  // interning the names in ID order gives each one the ID it had
+  CompactModule m;
+  for (uint32_t id = 0; id < header->value_count; id++) {
+    m.value(string(valueName(id)));
+  }
+  for (uint32_t id = 0; id < header->label_count; id++) {
+    m.label(string(labelName(id)));
+  }
+  for (uint32_t k = 0; k < header->wide_count; k++) m.imm(wide_imms[k]);
+  m.insts.assign(inst_table, inst_table + header->inst_count);
+  m.functions.assign(function_table, function_table + header->function_count);
+  return m;
+}
+}  // namespace ir
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "compact_ir.h"
+
+using namespace std;
+namespace ir {
+    // Binary form of a CompactModule, for keeping optimized IR between
+    // pipeline stages and moving it between machines without going through
+    // Koopa text. Host byte order; every section starts 8-byte aligned:
+    //
+    //   ImageHeader
+    //   uint32_t      string_offsets[value_count + label_count + 1]
+    //   int32_t       wide_imms[wide_count]
+    //   FunctionRange functions[function_count]
+    //   Inst          insts[inst_count]
+    //   char          strings[strings_size]  value names, then labels
+    //
+    // The instruction records are the in-memory Inst, so a mapped image is
+    // used where it lies: opening one checks the header, the checksum and
+    // that every ID is in range, but decodes nothing.
+    struct ImageHeader {
+        char magic[4];      // "SYIR"
+        uint32_t version;
+        uint64_t checksum;  // xxh64 of everything after the header
+        uint64_t size;      // of the whole image
+        uint32_t value_count, label_count, wide_count;
+        uint32_t function_count, inst_count, strings_size;
+    };
+    static_assert(sizeof(ImageHeader) == 48, "ImageHeader has no padding");
+
+    // bump whenever the layout above, Inst or OpCode changes
+    const uint32_t IMAGE_VERSION = 1;
+
+    string encodeImage(const CompactModule& m);
+    // whether data starts like an image; open() does the real checking
+    bool isImage(string_view data);
+
+    // Read-only view of an image, e.g. a mapped file. The data has to stay
+    // alive as long as the view and be 8-byte aligned.
+    class ImageView {
+        public:
+            // false with the reason in error if data is not a usable image
+            bool open(string_view data, string& error);
+
+            const Inst* insts() const { return inst_table; }
+            size_t instCount() const { return header->inst_count; }
+            const CompactModule::FunctionRange* functions() const { return function_table; }
+            size_t functionCount() const { return header->function_count; }
+            string_view valueName(uint32_t id) const { return str(id); }
+            string_view labelName(uint32_t id) const { return str(header->value_count + id); }
+
+            // a module with the same IDs; the instructions are one copy. Relies
+            // on open() having rejected repeated names and bad function ranges
+            CompactModule toModule() const;
+
+        private:
+            const ImageHeader* header = nullptr;
+            const uint32_t* string_offsets = nullptr;
+            const int32_t* wide_imms = nullptr;
+            const CompactModule::FunctionRange* function_table = nullptr;
+            const Inst* inst_table = nullptr;
+            const char* strings = nullptr;
+
+            string_view str(uint32_t k) const {
+                return {strings + string_offsets[k],
+                        string_offsets[k + 1] - string_offsets[k]};
+            }
+            bool checkIds(string& error) const;
+    };
+}  // namespace ir
@@ -0,0 +1,743 @@
+#include "jit.h"
+
+#include <iostream>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+#include "profile.h"
+#include "runtime.h"
+#include "threaded_code.h"
+
+namespace jit {
+namespace {
+using namespace interp;
+
+const size_t THREAD_STACK = 512u << 20;
+// program memory: MEMORY_BYTES usable, then guard pages out to 4 GiB plus
+// the widest access, so base + any uint32 offset faults rather than escapes
+const size_t RESERVATION = (size_t(1) << 32) + 65536;
+const size_t ALT_STACK = 64 * 1024;
+
+enum Reg {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+};
+const Reg ALLOCATABLE[] = {RBX, R12, R13, R14};  // callee-saved
+
+enum Cond { CC_B = 2, CC_E = 4, CC_NE = 5, CC_S = 8, CC_L = 12, CC_GE = 13, CC_LE = 14, CC_G = 15 };
+
+// --- state the generated code and the helpers share ---
+
+char* memory;         // r15 in generated code
+uint32_t heap_top;    // bytes used by globals and live stack arrays
+const Program* program;
+
+[[noreturn]] void trap(const char* what, const string& where) {
+  fflush(stdout);
+  cerr << "run: " << what << (where.empty() ? "" : " in @" + where) << endl;
+  exit(1);
+}
+
+int32_t* checked(int32_t fn, uint32_t addr, int32_t n) {
+  if ((addr & 3) || addr >= MEMORY_BYTES ||
+      n > int32_t((MEMORY_BYTES - addr) / 4)) {
+    trap("bad address", program->functions[fn].name);
+  }
+  return reinterpret_cast<int32_t*>(memory + addr);
+}
+
+// helpers called from generated code; plain SysV functions
+
+void divideByZero(int32_t fn) {
+  trap("division by zero", program->functions[fn].name);
+}
+void badAddress(int32_t fn, uint32_t addr) {
+  trap(("bad address " + to_string(addr)).c_str(), program->functions[fn].name);
+}
+
+int32_t stackAlloc(int32_t size, int32_t fn) {
+  uint32_t bytes = (uint32_t(size) + 3) & ~3u;
+  if (bytes > MEMORY_BYTES - heap_top) trap("out of memory", program->functions[fn].name);
+  int32_t addr = heap_top;
+  heap_top += bytes;
+  return addr;
+}
+int32_t heapMark() { return heap_top; }
+void heapRelease(int32_t mark) { heap_top = mark; }
+
+int32_t callGetint(int32_t, int32_t) { return runtime::getint(); }
+int32_t callGetch(int32_t, int32_t) { return runtime::getch(); }
+int32_t callGetarray(int32_t addr, int32_t) {
+  int32_t n = runtime::getint();
+  int32_t* a = checked(program->main_index, addr, n);
+  for (int32_t i = 0; i < n; i++) a[i] = runtime::getint();
+  return n;
+}
+int32_t callPutint(int32_t v, int32_t) {
+  runtime::putint(v);
+  return 0;
+}
+int32_t callPutch(int32_t c, int32_t) {
+  runtime::putch(c);
+  return 0;
+}
+int32_t callPutarray(int32_t n, int32_t addr) {
+  runtime::putarray(n, checked(program->main_index, addr, n));
+  return 0;
+}
+int32_t callStarttime(int32_t, int32_t) {
+  runtime::starttime();
+  return 0;
+}
+int32_t callStoptime(int32_t, int32_t) {
+  runtime::stoptime();
+  return 0;
+}
+int32_t (*const BUILTINS[runtime::BUILTIN_COUNT])(int32_t, int32_t) = {
+    callGetint, callGetch, callGetarray, callPutint,
+    callPutch, callPutarray, callStarttime, callStoptime,
+};
+
+void vectorLoad(int32_t* dst, uint32_t addr, int32_t vl) {
+  memcpy(dst, checked(program->main_index, addr, vl), vl * 4);
+}
+void vectorStore(uint32_t addr, const int32_t* src, int32_t vl) {
+  memcpy(checked(program->main_index, addr, vl), src, vl * 4);
+}
+// op: 0 add, 1 sub, 2 mul; 3-5 the same with a scalar y
+void vectorArith(int32_t* d, const int32_t* x, const int32_t* y, int32_t vl,
+                 int32_t op) {
+  bool scalar = op >= 3;
+  for (int32_t i = 0; i < vl; i++) {
+    uint32_t a = x[i], b = y[scalar ? 0 : i];
+    d[i] = int32_t(op % 3 == 0 ? a + b : op % 3 == 1 ? a - b : a * b);
+  }
+}
+int32_t vectorSum(int32_t init, const int32_t* v, int32_t vl) {
+  uint32_t sum = init;
+  for (int32_t i = 0; i < vl; i++) sum += uint32_t(v[i]);
+  return int32_t(sum);
+}
+
+void onFault(int, siginfo_t* info, void*) {
+  auto addr = static_cast<char*>(info->si_addr);
+  const char* what = addr >= memory && addr < memory + RESERVATION
+                         ? "run: bad address\n"
+                         : "run: stack overflow or crash in generated code\n";
+  fflush(stdout);
+  ssize_t ignored = write(STDERR_FILENO, what, strlen(what));
+  (void)ignored;
+  _exit(1);
+}
+
+// --- x86-64 encoding ---
+
+class Assembler {
+ public:
+  vector<uint8_t> buf;
+
+  size_t size() const { return buf.size(); }
+  void byte(uint8_t b) { buf.push_back(b); }
+  void bytes(initializer_list<uint8_t> bs) {
+    for (auto b : bs) byte(b);
+  }
+  void imm32(int32_t v) {
+    for (int k = 0; k < 4; k++) byte(uint32_t(v) >> (8 * k));
+  }
+  void imm64(uint64_t v) {
+    for (int k = 0; k < 8; k++) byte(v >> (8 * k));
+  }
+  void patch32(size_t at, int32_t v) { memcpy(&buf[at], &v, 4); }
+
+  void rex(bool w, int reg, int base, int index = 0) {
+    uint8_t r = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if (r != 0x40) byte(r);
+  }
+  // op reg, rm (both registers)
+  void rr(initializer_list<uint8_t> op, int reg, int rm, bool w = false) {
+    rex(w, reg, rm);
+    bytes(op);
+    byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+  }
+  // op reg, [base + disp32]
+  void rm(initializer_list<uint8_t> op, int reg, int base, int32_t disp,
+          bool w = false) {
+    rex(w, reg, base);
+    bytes(op);
+    byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) byte(0x24);
+    imm32(disp);
+  }
+  // op reg, [base + index]; base is not rbp or r13
+  void rmi(initializer_list<uint8_t> op, int reg, int base, int index) {
+    rex(false, reg, base, index);
+    bytes(op);
+    byte(0x04 | ((reg & 7) << 3));
+    byte(((index & 7) << 3) | (base & 7));
+  }
+
+  void movRR(Reg dst, Reg src) { if (dst != src) rr({0x89}, src, dst); }
+  void movRI(Reg dst, int32_t v) {
+    rex(false, 0, dst);
+    byte(0xB8 + (dst & 7));
+    imm32(v);
+  }
+  void movRM(Reg dst, Reg base, int32_t disp) { rm({0x8B}, dst, base, disp); }
+  void movMR(Reg base, int32_t disp, Reg src) { rm({0x89}, src, base, disp); }
+  void lea(Reg dst, Reg base, int32_t disp) { rm({0x8D}, dst, base, disp, true); }
+  void push(Reg r) {
+    rex(false, 0, r);
+    byte(0x50 + (r & 7));
+  }
+  void pop(Reg r) {
+    rex(false, 0, r);
+    byte(0x58 + (r & 7));
+  }
+  void callAbsolute(const void* f) {
+    rex(true, 0, RAX);
+    byte(0xB8);
+    imm64(reinterpret_cast<uint64_t>(f));
+    rr({0xFF}, 2, RAX);
+  }
+  // jcc/jmp/call with a rel32 to fill in later; returns where it goes
+  size_t jcc(Cond cc) {
+    bytes({0x0F, uint8_t(0x80 | cc)});
+    imm32(0);
+    return size() - 4;
+  }
+  size_t jmp() {
+    byte(0xE9);
+    imm32(0);
+    return size() - 4;
+  }
+  size_t call() {
+    byte(0xE8);
+    imm32(0);
+    return size() - 4;
+  }
+  void bindHere(size_t rel) { patch32(rel, size() - (rel + 4)); }
+};
+
+// --- translation ---
+
+class Translator {
+ public:
+  Translator(Assembler& as, const Program& program, const profile::Profile* profile)
+      : as(as), program(program), profile(profile) {}
+  void function(int index);
+  // (rel32 position, callee) for calls between generated functions
+  vector<pair<size_t, int>> calls;
+
+ private:
+  vector<pair<size_t, int32_t>> jumps;  // (rel32 position, code index)
+  Assembler& as;
+  const Program& program;
+  const profile::Profile* profile;
+  const Function* fn;
+  int index;
+  int32_t consts, frame_bytes;
+  vector<int> reg_of;  // slot -> ALLOCATABLE index, or -1
+  bool has_alloc;
+  bool flags_valid;
+
+  enum Extra { LHS, RHS, VL, HEAP, TMP, EXTRA_COUNT };
+
+  bool isConst(int32_t s) const { return s < consts; }
+  int32_t disp(int32_t s) const { return -(32 + frame_bytes) + 4 * (s - consts); }
+  int32_t extra(Extra k) const { return disp(fn->frame_size + k); }
+  void allocate();
+  void load(Reg r, int32_t s);
+  void store(int32_t s, Reg r);
+  void compare();
+  void checkAddress();
+  void epilogue();
+  void emit(const Code& code);
+};
+
+// rbx, r12-r14 go to the scalar values used most, a use inside a loop (a
+// backward jump's range) counting ten. With a profile of the function a use
+// counts as often as its block ran instead; a block a pass made counts as
+// the one it was copied from, or else as the block before it.
+void Translator::allocate() {
+  reg_of.assign(fn->frame_size, -1);
+  vector<long> weight(fn->code.size(), 1);
+  auto counts = profile ? profile->function(fn->name) : nullptr;
+  if (counts) {
+    long current = counts->entry;
+    size_t next = 0;
+    for (size_t i = 0; i < fn->code.size(); i++) {
+      for (; next < fn->labels.size() && fn->labels[next].first <= int32_t(i); next++) {
+        uint64_t n;
+        if (counts->find(fn->labels[next].second, n)) current = n;
+      }
+      weight[i] = current;
+    }
+  } else {
+    for (size_t i = 0; i < fn->code.size(); i++) {
+      auto h = handlerOf(fn->code[i]);
+      bool jump = h >= H_JM && h <= H_JGE;
+      if (jump && fn->code[i].d <= int32_t(i)) {
+        for (size_t k = fn->code[i].d; k <= i; k++) weight[k] = 10;
+      }
+    }
+  }
+  vector<long> uses(fn->frame_size, 0);
+  vector<bool> memory_only(fn->frame_size, false);
+  for (int32_t p : fn->params) uses[p] += 1;
+  for (size_t i = 0; i < fn->code.size(); i++) {
+    auto& code = fn->code[i];
+    auto h = handlerOf(code);
+    if (h >= H_JM && h <= H_JGE) continue;
+    bool is_vector = h >= H_VLOAD && h <= H_VREDSUM;
+    for (int32_t s : {code.a, code.b, code.c}) {
+      if (s < consts || s >= fn->frame_size) continue;
+      uses[s] += weight[i];
+      if (is_vector) {
+        for (int k = 0; k < VLMAX && s + k < fn->frame_size; k++) memory_only[s + k] = true;
+      }
+    }
+    if (h == H_SET_ARG) memory_only[code.a] = true;
+    if (h == H_CALL) {
+      for (int32_t s = code.c; s < fn->frame_size; s++) memory_only[s] = true;
+    }
+  }
+  vector<int32_t> order;
+  for (int32_t s = consts; s < fn->frame_size; s++) {
+    if (!memory_only[s] && uses[s] > 0) order.push_back(s);
+  }
+  sort(order.begin(), order.end(),
+       [&](int32_t x, int32_t y) { return uses[x] > uses[y] || (uses[x] == uses[y] && x < y); });
+  for (size_t k = 0; k < order.size() && k < 4; k++) reg_of[order[k]] = k;
+}
+
+void Translator::load(Reg r, int32_t s) {
+  if (isConst(s)) {
+    as.movRI(r, fn->consts[s]);
+  } else if (reg_of[s] >= 0) {
+    as.movRR(r, ALLOCATABLE[reg_of[s]]);
+  } else {
+    as.movRM(r, RBP, disp(s));
+  }
+}
+
+void Translator::store(int32_t s, Reg r) {
+  if (isConst(s)) return;  // only a missing dest maps to a constant
+  if (reg_of[s] >= 0) {
+    as.movRR(ALLOCATABLE[reg_of[s]], r);
+  } else {
+    as.movMR(RBP, disp(s), r);
+  }
+}
+
+// sets the flags from the last cmp unless they are still live
+void Translator::compare() {
+  if (flags_valid) return;
+  as.movRM(RAX, RBP, extra(LHS));
+  as.rm({0x3B}, RAX, RBP, extra(RHS));
+  flags_valid = true;
+}
+
+void Translator::epilogue() {
+  if (has_alloc) {
+    as.movMR(RBP, extra(TMP), RAX);
+    as.movRM(RDI, RBP, extra(HEAP));
+    as.callAbsolute(reinterpret_cast<const void*>(heapRelease));
+    as.movRM(RAX, RBP, extra(TMP));
+  }
+  as.lea(RSP, RBP, -32);
+  as.pop(R14);
+  as.pop(R13);
+  as.pop(R12);
+  as.pop(RBX);
+  as.pop(RBP);
+  as.byte(0xC3);
+}
+
+// traps unless eax is an aligned offset below MEMORY_BYTES, as -run does;
+// the guard pages alone would let unaligned and out-of-range accesses
+// through, or report them without the function
+void Translator::checkAddress() {
+  as.byte(0xA9);  // test eax, 3
+  as.imm32(3);
+  size_t unaligned = as.jcc(CC_NE);
+  as.byte(0x3D);  // cmp eax, MEMORY_BYTES
+  as.imm32(MEMORY_BYTES);
+  size_t ok = as.jcc(CC_B);
+  as.bindHere(unaligned);
+  as.movRR(RSI, RAX);
+  as.movRI(RDI, index);
+  as.callAbsolute(reinterpret_cast<const void*>(badAddress));
+  as.bindHere(ok);
+}
+
+void Translator::emit(const Code& code) {
+  static const Cond JCC[] = {CC_E, CC_NE, CC_L, CC_G, CC_LE, CC_GE};  // H_JEQ..
+  static const Cond MOVCC[] = {CC_E, CC_NE, CC_L, CC_G, CC_LE, CC_GE};  // H_MOVEQ..
+  static const Cond SETCC[] = {CC_E, CC_NE, CC_L, CC_G, CC_LE, CC_GE};  // H_EQ..
+  auto h = handlerOf(code);
+  bool keeps_flags = false;
+  switch (h) {
+    case H_MOV:
+      if (isConst(code.b) && !isConst(code.a) && reg_of[code.a] >= 0) {
+        as.movRI(ALLOCATABLE[reg_of[code.a]], fn->consts[code.b]);
+      } else {
+        load(RAX, code.b);
+        store(code.a, RAX);
+      }
+      break;
+    case H_ADD:
+    case H_SUB:
+    case H_AND:
+    case H_OR: {
+      static const uint8_t OPS[] = {0x01, 0x29, 0, 0, 0, 0x21, 0x09};
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({OPS[h - H_ADD]}, RCX, RAX);
+      store(code.a, RAX);
+      break;
+    }
+    case H_MUL:
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({0x0F, 0xAF}, RAX, RCX);
+      store(code.a, RAX);
+      break;
+    case H_DIV:
+    case H_MOD: {
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({0x85}, RCX, RCX);
+      size_t nonzero = as.jcc(CC_NE);
+      as.movRI(RDI, index);
+      as.callAbsolute(reinterpret_cast<const void*>(divideByZero));
+      as.bindHere(nonzero);
+      // x / -1 is -x (wrapping at INT_MIN), x % -1 is 0; idiv would fault
+      as.rr({0x83}, 7, RCX);
+      as.byte(0xFF);
+      size_t other = as.jcc(CC_NE);
+      as.rr({0xF7}, 3, RAX);  // neg eax
+      as.movRI(RDX, 0);
+      size_t done = as.jmp();
+      as.bindHere(other);
+      as.byte(0x99);          // cdq
+      as.rr({0xF7}, 7, RCX);  // idiv ecx
+      as.bindHere(done);
+      store(code.a, h == H_DIV ? RAX : RDX);
+      break;
+    }
+    case H_EQ:
+    case H_NE:
+    case H_LT:
+    case H_GT:
+    case H_LE:
+    case H_GE:
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({0x39}, RCX, RAX);
+      as.rr({0x0F, uint8_t(0x90 | SETCC[h - H_EQ])}, 0, RAX);
+      as.rr({0x0F, 0xB6}, RAX, RAX);
+      store(code.a, RAX);
+      break;
+    case H_SAL:
+    case H_SAR:
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({0xD3}, h == H_SAL ? 4 : 7, RAX);
+      store(code.a, RAX);
+      break;
+    case H_CMP:
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.movMR(RBP, extra(LHS), RAX);
+      as.movMR(RBP, extra(RHS), RCX);
+      as.rr({0x39}, RCX, RAX);
+      flags_valid = keeps_flags = true;
+      break;
+    case H_JM:
+      jumps.push_back({as.jmp(), code.d});
+      break;
+    case H_JEQ:
+    case H_JNE:
+    case H_JLT:
+    case H_JGT:
+    case H_JLE:
+    case H_JGE:
+      compare();
+      jumps.push_back({as.jcc(JCC[h - H_JEQ]), code.d});
+      keeps_flags = true;
+      break;
+    case H_MOVEQ:
+    case H_MOVNE:
+    case H_MOVLT:
+    case H_MOVGT:
+    case H_MOVLE:
+    case H_MOVGE:
+      compare();
+      load(RAX, code.c);
+      load(RCX, code.b);
+      as.rr({0x0F, uint8_t(0x40 | MOVCC[h - H_MOVEQ])}, RAX, RCX);
+      store(code.a, RAX);
+      keeps_flags = true;
+      break;
+    case H_LOAD:
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({0x01}, RCX, RAX);
+      checkAddress();
+      as.rmi({0x8B}, RAX, R15, RAX);
+      store(code.a, RAX);
+      break;
+    case H_STORE:
+      load(RAX, code.a);
+      load(RCX, code.b);
+      as.rr({0x01}, RCX, RAX);
+      checkAddress();
+      load(RDX, code.c);
+      as.rmi({0x89}, RDX, R15, RAX);
+      break;
+    case H_ALLOC:
+      load(RDI, code.b);
+      as.movRI(RSI, index);
+      as.callAbsolute(reinterpret_cast<const void*>(stackAlloc));
+      store(code.a, RAX);
+      break;
+    case H_SET_ARG:
+      load(RAX, code.b);
+      store(code.a, RAX);
+      break;
+    case H_CALL:
+      if (code.d >= 0) {
+        as.lea(RDI, RBP, disp(code.c));
+        calls.push_back({as.call(), code.d});
+      } else {
+        as.movRM(RDI, RBP, disp(code.c));
+        as.movRM(RSI, RBP, disp(code.c + 1));
+        as.callAbsolute(reinterpret_cast<const void*>(BUILTINS[-1 - code.d]));
+      }
+      store(code.a, RAX);
+      break;
+    case H_RET:
+      load(RAX, code.b);
+      epilogue();
+      break;
+    case H_VSETVL:
+      load(RAX, code.b);
+      as.movRI(RCX, VLMAX);
+      as.rr({0x39}, RCX, RAX);
+      as.rr({0x0F, 0x40 | CC_G}, RAX, RCX);
+      as.movRI(RCX, 0);
+      as.rr({0x85}, RAX, RAX);
+      as.rr({0x0F, 0x40 | CC_S}, RAX, RCX);
+      store(code.a, RAX);
+      as.movMR(RBP, extra(VL), RAX);
+      break;
+    case H_VLOAD:
+      load(RAX, code.b);
+      load(RCX, code.c);
+      as.rr({0x01}, RCX, RAX);
+      as.movRR(RSI, RAX);
+      as.lea(RDI, RBP, disp(code.a));
+      as.movRM(RDX, RBP, extra(VL));
+      as.callAbsolute(reinterpret_cast<const void*>(vectorLoad));
+      break;
+    case H_VSTORE:
+      load(RAX, code.a);
+      load(RCX, code.b);
+      as.rr({0x01}, RCX, RAX);
+      as.movRR(RDI, RAX);
+      as.lea(RSI, RBP, disp(code.c));
+      as.movRM(RDX, RBP, extra(VL));
+      as.callAbsolute(reinterpret_cast<const void*>(vectorStore));
+      break;
+    case H_VADD:
+    case H_VSUB:
+    case H_VMUL:
+    case H_VADDX:
+    case H_VSUBX:
+    case H_VMULX:
+      if (h >= H_VADDX) {
+        load(RAX, code.c);
+        as.movMR(RBP, extra(TMP), RAX);
+        as.lea(RDX, RBP, extra(TMP));
+      } else {
+        as.lea(RDX, RBP, disp(code.c));
+      }
+      as.lea(RDI, RBP, disp(code.a));
+      as.lea(RSI, RBP, disp(code.b));
+      as.movRM(RCX, RBP, extra(VL));
+      as.movRI(R8, h - H_VADD);
+      as.callAbsolute(reinterpret_cast<const void*>(vectorArith));
+      break;
+    case H_VREDSUM:
+      load(RDI, code.b);
+      as.lea(RSI, RBP, disp(code.c));
+      as.movRM(RDX, RBP, extra(VL));
+      as.callAbsolute(reinterpret_cast<const void*>(vectorSum));
+      store(code.a, RAX);
+      break;
+    default:
+      break;
+  }
+  if (!keeps_flags) flags_valid = false;
+}
+
+void Translator::function(int i) {
+  index = i;
+  fn = &program.functions[i];
+  consts = fn->consts.size();
+  frame_bytes = ((fn->frame_size - consts + EXTRA_COUNT) * 4 + 15) & ~15;
+  has_alloc = false;
+  vector<bool> target(fn->code.size() + 1, false);
+  for (auto& code : fn->code) {
+    auto h = handlerOf(code);
+    if (h == H_ALLOC) has_alloc = true;
+    if (h >= H_JM && h <= H_JGE) target[code.d] = true;
+  }
+  allocate();
+
+  // prologue: after the four pushes rsp is 16-byte aligned again, and
+  // frame_bytes keeps it that way for the calls in the body
+  as.push(RBP);
+  as.rr({0x89}, RSP, RBP, true);
+  for (Reg r : ALLOCATABLE) as.push(r);
+  as.rex(true, 0, RSP);
+  as.bytes({0x81, 0xEC});
+  as.imm32(frame_bytes);
+  // values start out 0, as in -run
+  as.movRI(RAX, 0);
+  for (int32_t off = 0; off < frame_bytes; off += 8) {
+    as.rm({0x89}, RAX, RBP, -(32 + frame_bytes) + off, true);
+  }
+  for (Reg r : ALLOCATABLE) as.movRI(r, 0);
+  for (size_t k = 0; k < fn->params.size(); k++) {
+    as.movRM(RAX, RDI, 4 * k);
+    store(fn->params[k], RAX);
+  }
+  if (has_alloc) {
+    as.callAbsolute(reinterpret_cast<const void*>(heapMark));
+    as.movMR(RBP, extra(HEAP), RAX);
+  }
+
+  vector<size_t> offset(fn->code.size());
+  jumps.clear();
+  flags_valid = false;
+  for (size_t k = 0; k < fn->code.size(); k++) {
+    offset[k] = as.size();
+    if (target[k]) flags_valid = false;
+    // a jump to the next instruction needs no code; block_layout drops
+    // these, but pipelines without it leave them in
+    if (handlerOf(fn->code[k]) == H_JM && fn->code[k].d == int32_t(k + 1)) continue;
+    emit(fn->code[k]);
+  }
+  for (auto [rel, to] : jumps) as.patch32(rel, offset[to] - (rel + 4));
+}
+
+// entry(code, memory, args): sets r15 and calls a generated function
+void emitEntry(Assembler& as) {
+  as.push(RBP);
+  as.rr({0x89}, RSP, RBP, true);
+  as.push(R15);
+  as.push(RBX);
+  as.rr({0x89}, RSI, R15, true);
+  as.rr({0x89}, RDI, RAX, true);
+  as.rr({0x89}, RDX, RDI, true);
+  as.rr({0xFF}, 2, RAX);  // call rax
+  as.pop(RBX);
+  as.pop(R15);
+  as.pop(RBP);
+  as.byte(0xC3);
+}
+}  // namespace
+
+bool run(const ir::CompactModule& m, int& exit_code, interp::Readback* readback,
+         const profile::Profile* profile) {
+  Program decoded;
+  string error;
+  if (!decode(m, decoded, error)) {
+    cerr << "jit: " << error << endl;
+    return false;
+  }
+  program = &decoded;
+
+  Assembler as;
+  emitEntry(as);
+  Translator translator(as, decoded, profile);
+  vector<size_t> entries;
+  for (size_t k = 0; k < decoded.functions.size(); k++) {
+    entries.push_back(as.size());
+    translator.function(k);
+  }
+  for (auto [rel, callee] : translator.calls) {
+    as.patch32(rel, entries[callee] - (rel + 4));
+  }
+
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t code_bytes = (as.size() + page - 1) / page * page;
+  void* code = mmap(nullptr, code_bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* mem = mmap(nullptr, RESERVATION, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (code == MAP_FAILED || mem == MAP_FAILED ||
+      mprotect(mem, MEMORY_BYTES, PROT_READ | PROT_WRITE) < 0) {
+    cerr << "jit: cannot map memory: " << strerror(errno) << endl;
+    return false;
+  }
+  memcpy(code, as.buf.data(), as.size());
+  mprotect(code, code_bytes, PROT_READ | PROT_EXEC);
+  memory = static_cast<char*>(mem);
+  memcpy(memory, decoded.data.data(), decoded.data.size() * 4);
+  heap_top = decoded.data.size() * 4;
+
+  using Entry = int32_t (*)(const void*, char*, const int32_t*);
+  auto entry = reinterpret_cast<Entry>(code);
+  const void* main_code = static_cast<char*>(code) + entries[decoded.main_index];
+  int32_t result = 0;
+  runtime::runWithStack(THREAD_STACK, [&] {
+    // faults are reported from a stack of their own, since running out of
+    // the thread's stack is one of them
+    vector<char> alt(ALT_STACK);
+    stack_t ss{};
+    ss.ss_sp = alt.data();
+    ss.ss_size = alt.size();
+    sigaltstack(&ss, nullptr);
+    struct sigaction sa {}, old_segv, old_bus;
+    sa.sa_sigaction = onFault;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigaction(SIGSEGV, &sa, &old_segv);
+    sigaction(SIGBUS, &sa, &old_bus);
+    result = entry(main_code, memory, nullptr);
+    sigaction(SIGSEGV, &old_segv, nullptr);
+    sigaction(SIGBUS, &old_bus, nullptr);
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, nullptr);
+  });
+  fflush(stdout);
+  runtime::reportTimers();
+  if (readback) readBack(decoded, reinterpret_cast<int32_t*>(memory), *readback);
+  munmap(code, code_bytes);
+  munmap(mem, RESERVATION);
+  program = nullptr;
+  exit_code = result & 0xff;
+  return true;
+}
+}  // namespace jit
+
+#else
+
+namespace jit {
+bool run(const ir::CompactModule&, int&, interp::Readback*, const profile::Profile*) {
+  std::cerr << "jit: -jit needs an x86-64 Linux host, use -run" << std::endl;
+  return false;
+}
+}  // namespace jit
+
+#endif
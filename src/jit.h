@@ -0,0 +1,30 @@
+#pragma once
+#include "compact_ir.h"
+#include "interp.h"
+
+namespace profile {
+    class Profile;
+}
+
+// -jit: compiles the module to x86-64 machine code in executable memory and
+// calls @main directly, for timing long-running programs on the build host.
+//
+// A template JIT over the interpreter's decoded form (threaded_code.h): each
+// instruction becomes a fixed sequence of machine code. Frame slots live on
+// the native stack, except the four most used scalar values of each function
+// (uses inside loops count ten times, or with -fprofile-use each use counts
+// as often as its block ran), which get rbx and r12-r14. Loads and stores
+// check alignment and range inline and trap as -run does. Program memory is
+// a 4 GiB reservation addressed by zero-extended 32-bit offsets from r15, so
+// anything else that goes astray faults in its guard pages instead of
+// corrupting the compiler. The SysY library is the same native code -run
+// uses (runtime.h).
+namespace jit {
+    // Runs @main. Returns false, with the reason on stderr, if the module
+    // cannot be compiled or this is not an x86-64 host; runtime errors end
+    // the process with status 1, as with -run. `readback` as for
+    // interp::run; `profile`, if given, weighs register allocation.
+    bool run(const ir::CompactModule& m, int& exit_code,
+             interp::Readback* readback = nullptr,
+             const profile::Profile* profile = nullptr);
+}  // namespace jit
@@ -0,0 +1,258 @@
+#include "lexer.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include "config.h"
+#include "sysy.tab.hpp"
+
+// the lexer Flex generates
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+extern int yylex_init(yyscan_t *scanner);
+extern int yylex_destroy(yyscan_t scanner);
+extern YY_BUFFER_STATE yy_scan_buffer(char *base, size_t size,
+                                      yyscan_t scanner);
+extern void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+extern int yylex(YYSTYPE *yylval, yyscan_t scanner);
+
+namespace lexer {
+namespace {
+struct HandScanner {
+  const char *p;
+  const char *end;
+};
+
+// SWAR: test 8 bytes at once in a uint64_t. In the result, bytes that match
+// have their top bit set and every other bit clear; ctz finds the first one
+// that does not. Little-endian hosts only.
+const uint64_t ONES = 0x0101010101010101ULL;
+const uint64_t HIGH = 0x8080808080808080ULL;
+
+inline uint64_t load(const char *p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+// bytes equal to c, with no false positives
+inline uint64_t bytesEqual(uint64_t x, unsigned char c) {
+  uint64_t t = x ^ (ONES * c);
+  return ~(((t & ~HIGH) + ~HIGH) | t) & HIGH;
+}
+
+// bytes with lo <= byte <= hi (both < 0x80). The top bit is cleared first so
+// the additions cannot carry into the next byte, and bytes that had it set
+// are excluded at the end
+inline uint64_t bytesInRange(uint64_t x, unsigned char lo, unsigned char hi) {
+  uint64_t y = x & ~HIGH;
+  uint64_t ge = y + ONES * (0x80 - lo);
+  uint64_t le = y + ONES * (0x7f - hi);
+  return ge & ~le & ~x & HIGH;
+}
+
+// the first byte, from the low end, that mask says does not match
+inline int firstMiss(uint64_t mask) {
+  return __builtin_ctzll(~mask & HIGH) / 8;
+}
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool isIdent(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+const char *skipSpace(const char *p, const char *end) {
+  while (end - p >= 8) {
+    uint64_t x = load(p);
+    uint64_t mask = bytesEqual(x, ' ') | bytesEqual(x, '\n') |
+                    bytesEqual(x, '\t') | bytesEqual(x, '\r');
+    if (mask != HIGH) return p + firstMiss(mask);
+    p += 8;
+  }
+  while (p < end && isSpace(*p)) p++;
+  return p;
+}
+
+const char *skipIdent(const char *p, const char *end) {
+  while (end - p >= 8) {
+    uint64_t x = load(p);
+    uint64_t mask = bytesInRange(x, 'a', 'z') | bytesInRange(x, 'A', 'Z') |
+                    bytesInRange(x, '0', '9') | bytesEqual(x, '_');
+    if (mask != HIGH) return p + firstMiss(mask);
+    p += 8;
+  }
+  while (p < end && isIdent(*p)) p++;
+  return p;
+}
+
+// perfect hash of the keywords: (first letter * 7 + length) & 15 gives each
+// of the 9 keywords its own slot
+struct Keyword {
+  const char *text;
+  size_t size;
+  int token;
+};
+
+const Keyword keywords[16] = {
+    {},
+    {"if", 2, IF},
+    {"int", 3, INT},
+    {"break", 5, BREAK},
+    {"return", 6, RETURN},
+    {},
+    {"while", 5, WHILE},
+    {"else", 4, ELSE},
+    {},
+    {},
+    {"const", 5, CONST},
+    {},
+    {},
+    {"continue", 8, CONTINUE},
+    {"void", 4, VOID},
+    {},
+};
+
+int keyword(const char *text, size_t size) {
+  const Keyword &k = keywords[(text[0] * 7 + size) & 15];
+  if (k.size == size && memcmp(k.text, text, size) == 0) return k.token;
+  return 0;
+}
+
+inline int digitValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return 16;
+}
+
+// as sysy.l's strtol(yytext, nullptr, 0): saturates at LONG_MAX on overflow,
+// then truncates to int
+const char *scanNumber(const char *p, const char *end, int &value) {
+  int base = 10;
+  if (*p == '0') {
+    if (end - p >= 3 && (p[1] == 'x' || p[1] == 'X') && digitValue(p[2]) < 16) {
+      base = 16;
+      p += 2;
+    } else {
+      base = 8;
+    }
+  }
+  unsigned long acc = 0;
+  bool overflow = false;
+  for (int d; p < end && (d = digitValue(*p)) < base; p++) {
+    if (acc > (unsigned long)(LONG_MAX - d) / base) overflow = true;
+    acc = acc * base + d;
+  }
+  value = (int)(overflow ? LONG_MAX : (long)acc);
+  return p;
+}
+
+int handLex(HandScanner &s, YYSTYPE *yylval) {
+  const char *end = s.end;
+  for (;;) {
+    const char *p = skipSpace(s.p, end);
+    if (p == end) {
+      s.p = p;
+      return 0;
+    }
+    char c = *p;
+    switch (c) {
+      case 'a' ... 'z':
+      case 'A' ... 'Z':
+      case '_': {
+        const char *e = skipIdent(p + 1, end);
+        s.p = e;
+        size_t size = e - p;
+        if (size >= 2 && size <= 8) {
+          if (int token = keyword(p, size)) return token;
+        }
+        yylval->text_val = {p, size};
+        return IDENT;
+      }
+      case '0' ... '9':
+        s.p = scanNumber(p, end, yylval->int_val);
+        return INT_CONST;
+      case '/':
+        if (p + 1 < end && p[1] == '/') {
+          auto nl = static_cast<const char *>(memchr(p, '\n', end - p));
+          s.p = nl ? nl : end;
+          continue;
+        }
+        if (p + 1 < end && p[1] == '*') {
+          const char *q = p + 2;
+          while ((q = static_cast<const char *>(memchr(q, '*', end - q))) &&
+                 q + 1 < end && q[1] != '/') {
+            q++;
+          }
+          if (q && q + 1 < end) {
+            s.p = q + 2;
+            continue;
+          }
+          // an unterminated comment: Flex also takes just the '/' here
+        }
+        s.p = p + 1;
+        return '/';
+      case '<':
+      case '>':
+      case '=':
+      case '!':
+        if (p + 1 < end && p[1] == '=') {
+          s.p = p + 2;
+          return c == '<' ? LE : c == '>' ? GE : c == '=' ? EQ : NE;
+        }
+        s.p = p + 1;
+        return c;
+      case '&':
+      case '|':
+        if (p + 1 < end && p[1] == c) {
+          s.p = p + 2;
+          return c == '&' ? AND : OR;
+        }
+        s.p = p + 1;
+        return c;
+      default:
+        s.p = p + 1;
+        return c;
+    }
+  }
+}
+}  // namespace
+
+int lex(YYSTYPE *yylval, yyscan_t scanner) {
+  return handLex(*static_cast<HandScanner *>(scanner), yylval);
+}
+
+Scanner::Scanner(SourceBuffer &source) {
+  if (config::hand_lexer) {
+    auto text = source.text();
+    scanner = new HandScanner{text.data(), text.data() + text.size()};
+  } else {
+    yylex_init(&scanner);
+    flex_buffer = yy_scan_buffer(source.scanBase(), source.scanSize(), scanner);
+  }
+}
+
+Scanner::~Scanner() {
+  if (config::hand_lexer) {
+    delete static_cast<HandScanner *>(scanner);
+  } else {
+    yy_delete_buffer(static_cast<YY_BUFFER_STATE>(flex_buffer), scanner);
+    yylex_destroy(scanner);
+  }
+}
+
+size_t tokenize(SourceBuffer &source) {
+  Scanner scanner(source);
+  YYSTYPE yylval;
+  size_t tokens = 0;
+  if (config::hand_lexer) {
+    while (lex(&yylval, scanner.get())) tokens++;
+  } else {
+    while (yylex(&yylval, scanner.get())) tokens++;
+  }
+  return tokens;
+}
+}  // namespace lexer
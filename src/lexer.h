@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include "source_buffer.h"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+// Entry point for lexing. The Flex lexer generated from sysy.l is the default;
+// --lexer=hand switches to the hand-written one in lexer.cpp, which switches
+// on the first byte, looks at whitespace and identifiers 8 bytes at a time
+// (SWAR) and finds keywords with a perfect hash. Both accept the same language
+// and return the same tokens. The hand-written token function is lexer::lex,
+// declared in sysy.y since it needs YYSTYPE.
+namespace lexer {
+    // a scanner over source, without copying it; freed on destruction
+    class Scanner {
+      public:
+        explicit Scanner(SourceBuffer& source);
+        ~Scanner();
+        Scanner(const Scanner&) = delete;
+        Scanner& operator=(const Scanner&) = delete;
+
+        yyscan_t get() const { return scanner; }
+
+      private:
+        yyscan_t scanner;
+        void* flex_buffer = nullptr;
+    };
+
+    // lexes only and returns the token count; --lex-only measures lexer
+    // throughput with it
+    size_t tokenize(SourceBuffer& source);
+}  // namespace lexer
@@ -0,0 +1,154 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "cfg.h"
+#include "loop.h"
+#include "optimize.h"
+#include "purity.h"
+
+// Loop-invariant code motion. Arithmetic that cannot trap and calls to pure
+// functions whose operands are not defined inside the loop are moved in
+// front of the loop header. Only loops entered by falling through (or
+// jumping) from the block laid out right before the header are handled.
+//
+// A pure call may still trap or not return, so it only moves from a block
+// that dominates every way out of the loop: such a block runs whenever the
+// loop is entered, and the call would have been made anyway.
+
+namespace ir {
+namespace {
+bool isHoistable(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::MOV:
+    case OpCode::EQ:
+    case OpCode::NE:
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::OR:
+    case OpCode::AND:
+    case OpCode::LT:
+    case OpCode::GT:
+    case OpCode::LE:
+    case OpCode::GE:
+    case OpCode::SAL:
+    case OpCode::SAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Hoists what it can out of one loop, returns true if anything moved.
+bool hoistLoop(IRList& irs, const CFG& cfg, const vector<int>& idom,
+               const Loop& loop, const PurityInfo& purity,
+               const unordered_map<string, int>& def_count) {
+  if (loop.preheader < 0 || loop.preheader != loop.header - 1) return false;
+  auto& pre = cfg.blocks[loop.preheader];
+  auto& hb = cfg.blocks[loop.header];
+  auto pos = pre.end;
+  auto last = std::prev(pre.end);
+  if (last->op_code == OpCode::jm && last->label == hb.label) {
+    pos = last;
+  } else if (isTerminator(last->op_code)) {
+    return false;
+  }
+
+  unordered_set<string> defined;
+  for (int b : loop.blocks) {
+    for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+      if (it->dest.is_var()) defined.insert(it->dest.name);
+    }
+  }
+  auto invariant = [&](const OpName& op) {
+    return !op.is_var() || !defined.count(op.name);
+  };
+  // blocks the loop can be left from, by a branch out or a return
+  vector<int> exiting;
+  for (int b : loop.blocks) {
+    auto& succs = cfg.blocks[b].succs;
+    bool exits = succs.empty();
+    for (int s : succs) exits = exits || !loop.contains(s);
+    if (exits) exiting.push_back(b);
+  }
+  auto runs_on_entry = [&](int b) {
+    for (int e : exiting) {
+      if (!CFG::dominates(idom, b, e)) return false;
+    }
+    return !exiting.empty();
+  };
+  auto single_def = [&](const OpName& op) {
+    auto it = def_count.find(op.name);
+    return op.is_var() && it != def_count.end() && it->second == 1;
+  };
+
+  bool moved = false, changed = true;
+  while (changed) {
+    changed = false;
+    for (int b : loop.blocks) {
+      for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+        if (!single_def(it->dest) || !defined.count(it->dest.name)) continue;
+        vector<IRList::iterator> seq;
+        if (isHoistable(it->op_code)) {
+          seq = {it};
+        } else if (purity.isPureCall(*it) && runs_on_entry(b)) {
+          seq = callSequence(it, cfg.blocks[b].begin);
+        } else {
+          continue;
+        }
+        bool ok = true;
+        for (auto s : seq) {
+          ok = ok && invariant(s->op1) && invariant(s->op2) && invariant(s->op3);
+        }
+        if (!ok) continue;
+        // a block boundary between the SET_ARGs and the call is not expected,
+        // but never split a sequence that does not start at a SET_ARG
+        if (seq.size() > 1 && seq.front()->op_code != OpCode::SET_ARG) continue;
+        for (auto s : seq) {
+          irs.insert(pos, *s);
+          s->op_code = OpCode::NOOP;
+        }
+        defined.erase(it->dest.name);
+        moved = changed = true;
+      }
+    }
+  }
+  return moved;
+}
+}  // namespace
+
+void licm(IRList& irs, const PurityInfo& purity) {
+  for (auto& func : splitFunctions(irs)) {
+    unordered_map<string, int> def_count;
+    for (auto it = func.begin; it != func.end; it++) {
+      if (it->dest.is_var()) def_count[it->dest.name]++;
+    }
+    // inner loops first, so invariants bubble out through every level
+    unordered_set<string> done;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      CFG cfg(func);
+      LoopInfo loop_info(cfg);
+      auto idom = cfg.immediateDominators();
+      for (auto& loop : loop_info.loops) {
+        auto& label = cfg.blocks[loop.header].label;
+        if (label.empty() || done.count(label)) continue;
+        bool inner_pending = false;
+        for (auto& other : loop_info.loops) {
+          auto& other_label = cfg.blocks[other.header].label;
+          if (&other != &loop && loop.contains(other.header) &&
+              !done.count(other_label)) {
+            inner_pending = true;
+          }
+        }
+        if (inner_pending) continue;
+        done.insert(label);
+        hoistLoop(irs, cfg, idom, loop, purity, def_count);
+        irs.remove_if([](const IR& ir) { return ir.op_code == OpCode::NOOP; });
+        changed = true;
+        break;
+      }
+    }
+  }
+}
+}  // namespace ir
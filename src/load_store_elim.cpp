@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "alias.h"
+#include "cfg.h"
+#include "optimize.h"
+#include "purity.h"
+
+// Store-to-load forwarding, redundant load elimination and dead store
+// elimination, driven by AliasAnalysis. The forward pass tracks which value
+// is known to live at each location; the backward pass tracks locations that
+// are overwritten (or discarded at return) before being read.
+//
+// A load whose value is known becomes a copy of it. The IR is not SSA, so
+// later uses in the same block read the value directly only until either
+// name is defined again; uses further on keep the copy, and DCE drops the
+// copies nothing reads.
+
+namespace ir {
+namespace {
+struct Avail {
+  MemLoc loc;
+  OpName value;
+  bool operator==(const Avail& other) const {
+    return loc == other.loc && value == other.value;
+  }
+};
+
+struct AvailState {
+  bool top = true;
+  vector<Avail> entries;
+  bool operator==(const AvailState& other) const {
+    return top == other.top && entries == other.entries;
+  }
+};
+
+struct DeadState {
+  bool top = true;
+  vector<MemLoc> overwritten;
+  bool stack_dead = false;
+  vector<MemLoc> stack_reads;
+  unordered_set<string> read_bases;
+  bool operator==(const DeadState& other) const {
+    return top == other.top && overwritten == other.overwritten &&
+           stack_dead == other.stack_dead &&
+           stack_reads == other.stack_reads &&
+           read_bases == other.read_bases;
+  }
+};
+
+class LoadStoreElim {
+ public:
+  LoadStoreElim(const Function& func, const PurityInfo& purity)
+      : func(func), cfg(func), aa(func), purity(purity) {}
+  void run();
+
+ private:
+  const Function& func;
+  CFG cfg;
+  AliasAnalysis aa;
+  const PurityInfo& purity;
+  // loaded name -> the value it copies, valid from the load to the next
+  // definition of either name in the block being rewritten
+  unordered_map<string, OpName> rename;
+
+  OpName resolve(OpName op) const;
+  void redefine(const OpName& dest);
+  void forward(IR& ir, vector<Avail>& avail, bool rewrite);
+  void backward(IR& ir, DeadState& state, bool rewrite);
+  void forwardPass();
+  void backwardPass();
+};
+
+bool uses(const MemLoc& loc, const string& name) {
+  return loc.index == name || (loc.base.is_var() && loc.base.name == name);
+}
+
+OpName LoadStoreElim::resolve(OpName op) const {
+  if (!op.is_var()) return op;
+  auto it = rename.find(op.name);
+  return it == rename.end() ? op : it->second;
+}
+
+void LoadStoreElim::redefine(const OpName& dest) {
+  if (!dest.is_var()) return;
+  for (auto it = rename.begin(); it != rename.end();) {
+    bool stale = it->first == dest.name ||
+                 (it->second.is_var() && it->second.name == dest.name);
+    it = stale ? rename.erase(it) : std::next(it);
+  }
+}
+
+void LoadStoreElim::forward(IR& ir, vector<Avail>& avail, bool rewrite) {
+  auto kill_def = [&](const OpName& dest) {
+    if (!dest.is_var()) return;
+    avail.erase(std::remove_if(avail.begin(), avail.end(),
+                               [&](const Avail& a) {
+                                 return uses(a.loc, dest.name) ||
+                                        (a.value.is_var() &&
+                                         a.value.name == dest.name);
+                               }),
+                avail.end());
+  };
+  auto must = [&](const MemLoc& loc) -> const Avail* {
+    for (auto& a : avail) {
+      if (aa.alias(a.loc, loc) == AliasResult::MustAlias) return &a;
+    }
+    return nullptr;
+  };
+
+  switch (ir.op_code) {
+    case OpCode::LOAD: {
+      auto loc = aa.location(ir);
+      auto hit = must(loc);
+      if (hit && rewrite) {
+        OpName value = hit->value;
+        if (value == ir.dest) {
+          ir.op_code = OpCode::NOOP;
+        } else {
+          ir = IR(OpCode::MOV, ir.dest, value);
+          rename[ir.dest.name] = value;
+        }
+      }
+      // forwarded or not, the loaded name holds the location's value, and
+      // still does once the name it was forwarded from changes
+      kill_def(ir.dest);
+      if (!uses(loc, ir.dest.name)) avail.push_back({loc, ir.dest});
+      return;
+    }
+    case OpCode::STORE: {
+      auto loc = aa.location(ir);
+      auto hit = must(loc);
+      if (hit && resolve(hit->value) == resolve(ir.op3)) {
+        // the location already holds this value
+        if (rewrite) ir.op_code = OpCode::NOOP;
+        return;
+      }
+      avail.erase(std::remove_if(avail.begin(), avail.end(),
+                                 [&](const Avail& a) {
+                                   return aa.alias(a.loc, loc) !=
+                                          AliasResult::NoAlias;
+                                 }),
+                  avail.end());
+      avail.push_back({loc, ir.op3});
+      return;
+    }
+    case OpCode::call:
+      // pure and read-only callees leave memory as it was
+      if (!purity.isReadOnlyCall(ir)) {
+        avail.erase(std::remove_if(avail.begin(), avail.end(),
+                                   [&](const Avail& a) {
+                                     return aa.visibleToCalls(a.loc);
+                                   }),
+                    avail.end());
+      }
+      kill_def(ir.dest);
+      return;
+    default:
+      kill_def(ir.dest);
+      return;
+  }
+}
+
+void LoadStoreElim::backward(IR& ir, DeadState& state, bool rewrite) {
+  auto kill_def = [&](const OpName& dest) {
+    if (!dest.is_var()) return;
+    auto& ow = state.overwritten;
+    ow.erase(std::remove_if(ow.begin(), ow.end(),
+                            [&](const MemLoc& l) { return uses(l, dest.name); }),
+             ow.end());
+    auto& reads = state.stack_reads;
+    for (auto it = reads.begin(); it != reads.end();) {
+      if (uses(*it, dest.name)) {
+        // the address read below is unknown above this definition
+        state.read_bases.insert(it->base.name);
+        it = reads.erase(it);
+      } else {
+        it++;
+      }
+    }
+  };
+
+  switch (ir.op_code) {
+    case OpCode::STORE: {
+      auto loc = aa.location(ir);
+      bool overwritten = false;
+      for (auto& l : state.overwritten) {
+        if (aa.alias(l, loc) == AliasResult::MustAlias) overwritten = true;
+      }
+      bool discarded = state.stack_dead && !aa.visibleToCalls(loc) &&
+                       !state.read_bases.count(loc.base.name);
+      for (auto& l : state.stack_reads) {
+        if (aa.alias(l, loc) != AliasResult::NoAlias) discarded = false;
+      }
+      if (overwritten || discarded) {
+        if (rewrite) ir.op_code = OpCode::NOOP;
+        return;
+      }
+      state.overwritten.push_back(loc);
+      auto& reads = state.stack_reads;
+      reads.erase(std::remove_if(reads.begin(), reads.end(),
+                                 [&](const MemLoc& l) {
+                                   return aa.alias(l, loc) ==
+                                          AliasResult::MustAlias;
+                                 }),
+                  reads.end());
+      return;
+    }
+    case OpCode::LOAD: {
+      auto loc = aa.location(ir);
+      auto& ow = state.overwritten;
+      ow.erase(std::remove_if(ow.begin(), ow.end(),
+                              [&](const MemLoc& l) {
+                                return aa.alias(l, loc) != AliasResult::NoAlias;
+                              }),
+               ow.end());
+      kill_def(ir.dest);
+      if (aa.isStackArray(loc.base) &&
+          std::find(state.stack_reads.begin(), state.stack_reads.end(), loc) ==
+              state.stack_reads.end()) {
+        state.stack_reads.push_back(loc);
+      }
+      return;
+    }
+    case OpCode::call: {
+      kill_def(ir.dest);
+      if (purity.isPureCall(ir)) return;
+      auto& ow = state.overwritten;
+      ow.erase(std::remove_if(ow.begin(), ow.end(),
+                              [&](const MemLoc& l) {
+                                return aa.visibleToCalls(l);
+                              }),
+               ow.end());
+      return;
+    }
+    default:
+      kill_def(ir.dest);
+      return;
+  }
+}
+
+void LoadStoreElim::forwardPass() {
+  auto rpo = cfg.reversePostOrder();
+  vector<AvailState> in(cfg.blocks.size()), out(cfg.blocks.size());
+  auto meet = [&](int b) {
+    AvailState st;
+    if (b == 0) {
+      st.top = false;
+      return st;
+    }
+    for (int p : cfg.blocks[b].preds) {
+      if (out[p].top) continue;
+      if (st.top) {
+        st = out[p];
+        continue;
+      }
+      vector<Avail> kept;
+      for (auto& a : st.entries) {
+        auto& pe = out[p].entries;
+        if (std::find(pe.begin(), pe.end(), a) != pe.end()) kept.push_back(a);
+      }
+      st.entries = kept;
+    }
+    return st;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b : rpo) {
+      in[b] = meet(b);
+      AvailState st = in[b];
+      if (!st.top) {
+        for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+          forward(*it, st.entries, false);
+        }
+      }
+      if (!(st == out[b])) {
+        out[b] = st;
+        changed = true;
+      }
+    }
+  }
+
+  for (int b : rpo) {
+    if (in[b].top) continue;
+    auto avail = in[b].entries;
+    rename.clear();
+    for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+      if (it->op_code == OpCode::NOOP) continue;
+      for (auto op : {&it->op1, &it->op2, &it->op3}) *op = resolve(*op);
+      redefine(it->dest);
+      forward(*it, avail, true);
+    }
+  }
+}
+
+void LoadStoreElim::backwardPass() {
+  auto rpo = cfg.reversePostOrder();
+  vector<DeadState> in(cfg.blocks.size()), out(cfg.blocks.size());
+  auto meet = [&](int b) {
+    DeadState st;
+    if (cfg.blocks[b].succs.empty()) {
+      // leaving the function discards every private stack array
+      st.top = false;
+      st.stack_dead = true;
+      return st;
+    }
+    for (int s : cfg.blocks[b].succs) {
+      if (in[s].top) continue;
+      if (st.top) {
+        st = in[s];
+        continue;
+      }
+      vector<MemLoc> kept;
+      for (auto& l : st.overwritten) {
+        auto& so = in[s].overwritten;
+        if (std::find(so.begin(), so.end(), l) != so.end()) kept.push_back(l);
+      }
+      st.overwritten = kept;
+      st.stack_dead = st.stack_dead && in[s].stack_dead;
+      for (auto& l : in[s].stack_reads) {
+        if (std::find(st.stack_reads.begin(), st.stack_reads.end(), l) ==
+            st.stack_reads.end()) {
+          st.stack_reads.push_back(l);
+        }
+      }
+      st.read_bases.insert(in[s].read_bases.begin(), in[s].read_bases.end());
+    }
+    return st;
+  };
+  auto walk = [&](int b, DeadState& st, bool rewrite) {
+    auto& bb = cfg.blocks[b];
+    for (auto it = bb.end; it != bb.begin;) {
+      it--;
+      if (it->op_code == OpCode::NOOP) continue;
+      backward(*it, st, rewrite);
+    }
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto r = rpo.rbegin(); r != rpo.rend(); r++) {
+      int b = *r;
+      out[b] = meet(b);
+      DeadState st = out[b];
+      if (!st.top) walk(b, st, false);
+      if (!(st == in[b])) {
+        in[b] = st;
+        changed = true;
+      }
+    }
+  }
+  for (int b : rpo) {
+    if (out[b].top) continue;
+    DeadState st = out[b];
+    walk(b, st, true);
+  }
+}
+
+void LoadStoreElim::run() {
+  if (cfg.blocks.empty()) return;
+  forwardPass();
+  backwardPass();
+}
+}  // namespace
+
+void load_store_elim(IRList& irs, const PurityInfo& purity) {
+  for (auto& func : splitFunctions(irs)) {
+    LoadStoreElim(func, purity).run();
+  }
+  irs.remove_if([](const IR& ir) { return ir.op_code == OpCode::NOOP; });
+}
+}  // namespace ir
@@ -0,0 +1,142 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "cfg.h"
+#include "optimize.h"
+#include "purity.h"
+
+// Block-local common subexpression elimination for arithmetic and for calls
+// to pure / read-only functions. A repeated computation is dropped and its
+// uses are renamed to the first result, so both names must be defined only
+// once in the function.
+
+namespace ir {
+namespace {
+bool isCommutative(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::ADD:
+    case OpCode::MUL:
+    case OpCode::EQ:
+    case OpCode::NE:
+    case OpCode::AND:
+    case OpCode::OR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool isExpression(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::EQ:
+    case OpCode::NE:
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::MOD:
+    case OpCode::OR:
+    case OpCode::AND:
+    case OpCode::LT:
+    case OpCode::GT:
+    case OpCode::LE:
+    case OpCode::GE:
+    case OpCode::SAL:
+    case OpCode::SAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+struct Available {
+  string value;
+  vector<string> operands;
+  bool reads_memory;
+};
+}  // namespace
+
+void local_cse(IRList& irs, const PurityInfo& purity) {
+  for (auto& func : splitFunctions(irs)) {
+    unordered_map<string, int> def_count;
+    for (auto it = func.begin; it != func.end; it++) {
+      if (it->dest.is_var()) def_count[it->dest.name]++;
+    }
+    unordered_map<string, OpName> rename;
+    CFG cfg(func);
+    for (auto& bb : cfg.blocks) {
+      unordered_map<string, Available> table;
+      auto kill = [&](auto pred) {
+        for (auto e = table.begin(); e != table.end();) {
+          e = pred(e->second) ? table.erase(e) : std::next(e);
+        }
+      };
+      for (auto it = bb.begin; it != bb.end; it++) {
+        string key;
+        vector<string> operands;
+        bool reads_memory = false;
+        if (isExpression(it->op_code)) {
+          string a = it->op1.toString(), b = it->op2.toString();
+          if (isCommutative(it->op_code) && b < a) std::swap(a, b);
+          key = to_string((int)it->op_code) + " " + a + " " + b;
+          operands = {a, b};
+        } else if (it->op_code == OpCode::call && purity.isReadOnlyCall(*it) &&
+                   it->dest.is_var()) {
+          key = "call " + calleeName(*it) + "(";
+          for (auto arg : callSequence(it, func.begin)) {
+            if (arg == it) continue;
+            key += arg->op1.toString() + ",";
+            operands.push_back(arg->op1.toString());
+          }
+          key += ")";
+          reads_memory = !purity.isPureCall(*it);
+        }
+
+        if (!key.empty() && def_count[it->dest.name] == 1) {
+          auto hit = table.find(key);
+          if (hit != table.end()) {
+            rename[it->dest.name] = OpName(hit->second.value);
+            if (it->op_code == OpCode::call) {
+              for (auto arg : callSequence(it, func.begin)) {
+                arg->op_code = OpCode::NOOP;
+              }
+            } else {
+              it->op_code = OpCode::NOOP;
+            }
+            continue;
+          }
+        }
+
+        // anything that may write memory invalidates read-only calls
+        bool writes = it->op_code == OpCode::STORE ||
+                      it->op_code == OpCode::VSTORE ||
+                      (it->op_code == OpCode::call && !purity.isReadOnlyCall(*it));
+        if (writes) kill([](const Available& a) { return a.reads_memory; });
+        if (it->dest.is_var()) {
+          auto& name = it->dest.name;
+          kill([&](const Available& a) {
+            if (a.value == name) return true;
+            for (auto& op : a.operands) {
+              if (op == name) return true;
+            }
+            return false;
+          });
+        }
+        if (!key.empty() && def_count[it->dest.name] == 1) {
+          table[key] = {it->dest.name, operands, reads_memory};
+        }
+      }
+    }
+    if (rename.empty()) continue;
+    for (auto it = func.begin; it != func.end; it++) {
+      for (auto op : {&it->op1, &it->op2, &it->op3}) {
+        for (int depth = 0; op->is_var() && depth < 64; depth++) {
+          auto r = rename.find(op->name);
+          if (r == rename.end()) break;
+          *op = r->second;
+        }
+      }
+    }
+  }
+  irs.remove_if([](const IR& ir) { return ir.op_code == OpCode::NOOP; });
+}
+}  // namespace ir
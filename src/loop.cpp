@@ -0,0 +1,210 @@
+#include "loop.h"
+
+#include <algorithm>
+#include <map>
+
+namespace ir {
+bool Loop::contains(int block) const {
+  return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+LoopInfo::LoopInfo(const CFG& cfg) {
+  auto idom = cfg.immediateDominators();
+  map<int, vector<int>> back_edges;  // header -> latches
+  for (auto& bb : cfg.blocks) {
+    for (int s : bb.succs) {
+      if (CFG::dominates(idom, s, bb.id)) back_edges[s].push_back(bb.id);
+    }
+  }
+  for (auto& [header, latches] : back_edges) {
+    Loop loop;
+    loop.header = header;
+    loop.latches = latches;
+    vector<bool> in_loop(cfg.blocks.size(), false);
+    in_loop[header] = true;
+    vector<int> work(latches.begin(), latches.end());
+    while (!work.empty()) {
+      int b = work.back();
+      work.pop_back();
+      if (in_loop[b]) continue;
+      in_loop[b] = true;
+      for (int p : cfg.blocks[b].preds) work.push_back(p);
+    }
+    for (int b = 0; b < (int)cfg.blocks.size(); b++) {
+      if (in_loop[b]) loop.blocks.push_back(b);
+    }
+    int outside_preds = 0;
+    for (int p : cfg.blocks[header].preds) {
+      if (!in_loop[p]) {
+        loop.preheader = p;
+        outside_preds++;
+      }
+    }
+    if (outside_preds != 1) loop.preheader = -1;
+    loops.push_back(loop);
+  }
+  for (auto& outer : loops) {
+    for (auto& inner : loops) {
+      if (&outer != &inner && outer.contains(inner.header)) {
+        outer.innermost = false;
+      }
+    }
+  }
+}
+
+long CountedLoop::tripCount() const {
+  if (!has_init || !bound_known) return -1;
+  long long n = bound_value, i = init, s = step;
+  switch (exit_cc) {
+    case OpCode::JGE:  // stay while iv < n
+      return n > i ? (n - i + s - 1) / s : 0;
+    case OpCode::JGT:  // stay while iv <= n
+      return n >= i ? (n - i) / s + 1 : 0;
+    case OpCode::JLE:  // stay while iv > n
+      return i > n ? (i - n - s - 1) / -s : 0;
+    case OpCode::JLT:  // stay while iv >= n
+      return i >= n ? (i - n) / -s + 1 : 0;
+    default:
+      return -1;
+  }
+}
+
+static OpCode mirror(OpCode cc) {
+  switch (cc) {
+    case OpCode::JGE: return OpCode::JLE;
+    case OpCode::JLE: return OpCode::JGE;
+    case OpCode::JGT: return OpCode::JLT;
+    case OpCode::JLT: return OpCode::JGT;
+    default: return cc;
+  }
+}
+
+// iv = iv + c / iv = c + iv / iv = iv - c
+static bool stepOf(const IR& ir, const OpName& iv, int& step) {
+  int c;
+  if (!(ir.dest == iv)) return false;
+  if (ir.op_code == OpCode::ADD && ir.op1 == iv && ir.op2.get_const(c)) {
+    step = c;
+  } else if (ir.op_code == OpCode::ADD && ir.op2 == iv && ir.op1.get_const(c)) {
+    step = c;
+  } else if (ir.op_code == OpCode::SUB && ir.op1 == iv && ir.op2.get_const(c)) {
+    step = -c;
+  } else {
+    return false;
+  }
+  return step != 0;
+}
+
+bool analyzeCountedLoop(const CFG& cfg, const Loop& loop, CountedLoop& cl) {
+  if (loop.latches.size() != 1) return false;
+  int header = loop.header, latch = loop.latches[0];
+  // the loop must be laid out as one contiguous run ending in the latch
+  for (int i = 0; i < (int)loop.blocks.size(); i++) {
+    if (loop.blocks[i] != header + i) return false;
+  }
+  if (loop.blocks.back() != latch) return false;
+
+  auto& hb = cfg.blocks[header];
+  if (hb.label.empty()) return false;
+  vector<const IR*> head;
+  for (auto it = hb.begin; it != hb.end; it++) {
+    if (it->op_code != OpCode::LABEL) head.push_back(&*it);
+  }
+  if (head.size() != 2 || head[0]->op_code != OpCode::cmp) return false;
+  const IR& br = *head[1];
+  if (!isBranch(br.op_code) || br.op_code == OpCode::jm) return false;
+  int exit = cfg.blockOf(br.label);
+  if (exit < 0 || loop.contains(exit)) return false;
+  cl.exit_label = br.label;
+
+  // no break / continue / return: every iteration runs header..latch once
+  for (int b : loop.blocks) {
+    if (b == header) continue;
+    for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+      if (it->op_code == OpCode::RET) return false;
+      if (!isBranch(it->op_code)) continue;
+      bool back_jump = b == latch && std::next(it) == cfg.blocks[b].end &&
+                       it->op_code == OpCode::jm && it->label == hb.label;
+      int target = cfg.blockOf(it->label);
+      if (back_jump) continue;
+      if (target < 0 || !loop.contains(target) || target == header) {
+        return false;
+      }
+    }
+  }
+  auto last = std::prev(cfg.blocks[latch].end);
+  if (last->op_code != OpCode::jm || last->label != hb.label) return false;
+
+  // one side of the compare is updated once in the latch, the other is fixed
+  auto defs_in_loop = [&](const OpName& op, const IR*& def) {
+    int count = 0;
+    for (int b : loop.blocks) {
+      for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+        if (op.is_var() && it->dest == op) {
+          def = &*it;
+          count++;
+        }
+      }
+    }
+    return count;
+  };
+  auto in_latch = [&](const IR* ir) {
+    for (auto it = cfg.blocks[latch].begin; it != cfg.blocks[latch].end; it++) {
+      if (&*it == ir) return true;
+    }
+    return false;
+  };
+  const IR& cmp = *head[0];
+  cl.exit_cc = br.op_code;
+  bool found = false;
+  for (int side = 0; side < 2 && !found; side++) {
+    OpName iv = side == 0 ? cmp.op1 : cmp.op2;
+    OpName bound = side == 0 ? cmp.op2 : cmp.op1;
+    const IR* def = nullptr;
+    const IR* bound_def = nullptr;
+    if (!iv.is_var() || defs_in_loop(iv, def) != 1 || !in_latch(def)) continue;
+    if (!stepOf(*def, iv, cl.step)) continue;
+    if (bound.is_var() && defs_in_loop(bound, bound_def) != 0) continue;
+    cl.iv = iv;
+    cl.bound = bound;
+    if (side == 1) cl.exit_cc = mirror(cl.exit_cc);
+    found = true;
+  }
+  if (!found) return false;
+  bool up = cl.exit_cc == OpCode::JGE || cl.exit_cc == OpCode::JGT;
+  bool down = cl.exit_cc == OpCode::JLE || cl.exit_cc == OpCode::JLT;
+  if (!(up && cl.step > 0) && !(down && cl.step < 0)) return false;
+
+  cl.bound_known = cl.bound.get_const(cl.bound_value);
+  cl.has_init = false;
+  if (loop.preheader >= 0) {
+    auto& pb = cfg.blocks[loop.preheader];
+    for (auto it = pb.end; it != pb.begin;) {
+      it--;
+      if (!(it->dest == cl.iv)) continue;
+      int c1, c2;
+      if (it->op_code == OpCode::MOV && it->op1.get_const(c1)) {
+        cl.has_init = true;
+        cl.init = c1;
+      } else if (it->op_code == OpCode::ADD && it->op1.get_const(c1) &&
+                 it->op2.get_const(c2)) {
+        cl.has_init = true;
+        cl.init = c1 + c2;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+int loopSize(const CFG& cfg, const Loop& loop) {
+  int size = 0;
+  for (int b : loop.blocks) {
+    for (auto it = cfg.blocks[b].begin; it != cfg.blocks[b].end; it++) {
+      if (it->op_code != OpCode::LABEL) size++;
+    }
+  }
+  return size;
+}
+
+}  // namespace ir
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "cfg.h"
+#include "ir.h"
+
+using namespace std;
+namespace ir {
+    // Natural loop: header plus every block that reaches a latch without
+    // passing through the header.
+    class Loop {
+        public:
+            int header;
+            vector<int> latches;
+            vector<int> blocks;  // sorted by block id
+            int preheader = -1;  // unique predecessor outside the loop
+            bool innermost = true;
+            bool contains(int block) const;
+    };
+
+    class LoopInfo {
+        public:
+            vector<Loop> loops;
+            LoopInfo(const CFG& cfg);
+    };
+
+    // while (iv <cond> bound) { ...; iv = iv + step; } where the header is
+    // just "cmp; Jcc exit" and iv is updated once, in the latch.
+    class CountedLoop {
+        public:
+            OpName iv, bound;
+            int step;
+            OpCode exit_cc;  // header jumps out when "iv exit_cc bound" holds
+            string exit_label;
+            bool has_init = false;
+            int init = 0;
+            bool bound_known = false;
+            int bound_value = 0;
+            long tripCount() const;  // -1 when unknown
+    };
+    bool analyzeCountedLoop(const CFG& cfg, const Loop& loop, CountedLoop& cl);
+
+    // Straight-line body size of a loop, used for unrolling budgets.
+    int loopSize(const CFG& cfg, const Loop& loop);
+
+    class UnrollOptions {
+        public:
+            int factor = 4;          // partial unroll factor, <= 1 disables it
+            int max_full_trip = 16;  // fully unroll loops with at most this trip count
+            int size_budget = 256;   // max instructions an unrolled loop may grow to
+            int hot_factor = 8;      // -fprofile-use: factor for loops averaging
+                                     // 16 * factor iterations per entry or more
+    };
+}  // namespace ir
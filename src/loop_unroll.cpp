@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <set>
+#include <unordered_set>
+#include "cfg.h"
+#include "context.h"
+#include "loop.h"
+#include "optimize.h"
+#include "profile.h"
+
+// Unrolls innermost counted loops recognized by analyzeCountedLoop. Loops
+// with a small constant trip count are replaced by straight-line copies of
+// the body. Other loops get an unrolled copy in front of them that runs
+// `factor` iterations per trip while at least that many remain; the original
+// loop is kept as the epilogue for the remaining iterations.
+//
+// With -fprofile-use, loops that never ran are left alone, loops that average
+// fewer than `factor` iterations per entry are not partially unrolled, and
+// loops that average many more get `hot_factor`.
+
+namespace ir {
+namespace {
+
+// Appends a copy of the loop body (everything after the header up to, but
+// not including, the latch's back jump) to out, renaming local labels.
+void cloneBody(const CFG& cfg, const Loop& loop, const string& suffix,
+               IRList& out) {
+  auto first = cfg.blocks[loop.header + 1].begin;
+  auto last = std::prev(cfg.blocks[loop.latches[0]].end);
+  unordered_set<string> labels;
+  for (auto it = first; it != last; it++) {
+    if (it->op_code == OpCode::LABEL) labels.insert(it->label);
+  }
+  for (auto it = first; it != last; it++) {
+    IR copy = *it;
+    if ((copy.op_code == OpCode::LABEL || isBranch(copy.op_code)) &&
+        labels.count(copy.label)) {
+      copy.label += suffix;
+    }
+    out.push_back(copy);
+  }
+}
+
+void fullUnroll(IRList& irs, const CFG& cfg, const Loop& loop,
+                const CountedLoop& cl, long trips, int id) {
+  IRList copies;
+  for (long k = 0; k < trips; k++) {
+    cloneBody(cfg, loop, "_u" + to_string(id) + "_" + to_string(k), copies);
+  }
+  // keep the header label so that outside jumps still land here
+  auto header_label = cfg.blocks[loop.header].begin;
+  auto pos = cfg.blocks[loop.latches[0]].end;
+  irs.erase(std::next(header_label), pos);
+  irs.splice(pos, copies);
+  if (pos->op_code != OpCode::LABEL || pos->label != cl.exit_label) {
+    irs.insert(pos, IR(OpCode::jm, cl.exit_label));
+  }
+}
+
+void partialUnroll(IRList& irs, const CFG& cfg, const Loop& loop,
+                   const CountedLoop& cl, int factor, int id,
+                   set<string>& done) {
+  auto& hb = cfg.blocks[loop.header];
+  string main_label = hb.label + "_u" + to_string(id);
+  done.insert(main_label);
+
+  // outside jumps into the loop now enter the unrolled copy first
+  auto back_jump = std::prev(cfg.blocks[loop.latches[0]].end);
+  for (auto& bb : cfg.blocks) {
+    for (auto it = bb.begin; it != bb.end; it++) {
+      if (isBranch(it->op_code) && it->label == hb.label && it != back_jump) {
+        it->label = main_label;
+      }
+    }
+  }
+
+  // while iv + (factor - 1) * step still satisfies the loop condition,
+  // run factor iterations back to back. That sum wraps near the ends of the
+  // int range, so the loop's own test comes first and then the distance
+  // left to the bound is compared with (factor - 1) * |step|; a distance
+  // that wraps is negative and leaves the rest to the original loop
+  bool up = cl.step > 0;
+  bool strict = cl.exit_cc == OpCode::JGE || cl.exit_cc == OpCode::JLE;
+  OpName left("%_u" + to_string(id));
+  IRList block;
+  block.push_back(IR(OpCode::LABEL, main_label));
+  block.push_back(IR(OpCode::cmp, OpName(), cl.iv, cl.bound));
+  block.push_back(IR(cl.exit_cc, hb.label));
+  block.push_back(up ? IR(OpCode::SUB, left, cl.bound, cl.iv)
+                     : IR(OpCode::SUB, left, cl.iv, cl.bound));
+  block.push_back(IR(OpCode::cmp, OpName(), left, OpName((factor - 1) * abs(cl.step))));
+  block.push_back(IR(strict ? OpCode::JLE : OpCode::JLT, hb.label));
+  for (int k = 0; k < factor; k++) {
+    cloneBody(cfg, loop, "_u" + to_string(id) + "_" + to_string(k), block);
+  }
+  block.push_back(IR(OpCode::jm, main_label));
+  irs.splice(hb.begin, block);
+}
+
+// Average header executions per entry into the loop, -1 if not profiled.
+// Entries are counted at the preheader, or at the function's entry.
+double profiledTrips(const CFG& cfg, const Loop& loop, const profile::FunctionCounts* counts) {
+  uint64_t header, entries = counts ? counts->entry : 0;
+  if (!counts || !counts->find(cfg.blocks[loop.header].label, header)) return -1;
+  if (loop.preheader >= 0) counts->find(cfg.blocks[loop.preheader].label, entries);
+  return entries ? double(header) / entries : header;
+}
+
+bool unrollLoop(IRList& irs, const CFG& cfg, const Loop& loop,
+                const CountedLoop& cl, const UnrollOptions& options,
+                const profile::FunctionCounts* counts,
+                NameCounters& names, set<string>& done) {
+  int body = loopSize(cfg, loop) - 3;  // minus cmp, Jcc and the back jump
+  long trips = cl.tripCount();
+  double profiled = profiledTrips(cfg, loop, counts);
+  if (profiled == 0) return false;
+  if (trips >= 0 && trips <= options.max_full_trip &&
+      trips * body <= options.size_budget) {
+    fullUnroll(irs, cfg, loop, cl, trips, names.unroll++);
+    return true;
+  }
+  int factor = options.factor;
+  if (profiled >= 16.0 * factor && (long)options.hot_factor * body <= options.size_budget) {
+    factor = max(factor, options.hot_factor);
+  }
+  if (factor <= 1 || (long)factor * body > options.size_budget) {
+    return false;
+  }
+  if ((long)(factor - 1) * labs(cl.step) > INT_MAX) return false;
+  if (trips >= 0 && trips < factor) return false;
+  if (profiled >= 0 && profiled < factor) return false;
+  partialUnroll(irs, cfg, loop, cl, factor, names.unroll++, done);
+  return true;
+}
+}  // namespace
+
+void loop_unroll(IRList& irs, const UnrollOptions& options) {
+  for (auto& func : splitFunctions(irs)) {
+    auto& names = context().names(func.name);
+    auto profile = context().profile;
+    auto counts = profile ? profile->function(func.name) : nullptr;
+    set<string> done;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      CFG cfg(func);
+      LoopInfo loop_info(cfg);
+      for (auto& loop : loop_info.loops) {
+        auto& label = cfg.blocks[loop.header].label;
+        if (!loop.innermost || label.empty() || done.count(label)) continue;
+        done.insert(label);
+        CountedLoop cl;
+        if (!analyzeCountedLoop(cfg, loop, cl)) continue;
+        if (unrollLoop(irs, cfg, loop, cl, options, counts, names, done)) {
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+}
+}  // namespace ir
@@ -0,0 +1,238 @@
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include "alias.h"
+#include "cfg.h"
+#include "context.h"
+#include "loop.h"
+#include "optimize.h"
+
+// Strip-mines element-wise loops over 32-bit arrays for the RISC-V vector
+// extension:
+//
+//   while (i < n) { c[i] = a[i] op b[i]; s = s + a[i] * b[i]; i = i + 1; }
+//
+// becomes a loop that handles VSETVL(n - i) elements per trip, placed in
+// front of the original loop. The scalar loop is kept as the fallback and
+// finds nothing left to do once the vector loop has run.
+
+namespace ir {
+namespace {
+
+bool isOffsetOf(const IR& ir, const OpName& iv) {
+  int c;
+  if (ir.op_code == OpCode::MUL) {
+    return (ir.op1 == iv && ir.op2.get_const(c) && c == 4) ||
+           (ir.op2 == iv && ir.op1.get_const(c) && c == 4);
+  }
+  if (ir.op_code == OpCode::SAL) {
+    return ir.op1 == iv && ir.op2.get_const(c) && c == 2;
+  }
+  return false;
+}
+
+OpCode vectorOp(OpCode op_code) {
+  switch (op_code) {
+    case OpCode::ADD: return OpCode::VADD;
+    case OpCode::SUB: return OpCode::VSUB;
+    case OpCode::MUL: return OpCode::VMUL;
+    default: return OpCode::NOOP;
+  }
+}
+
+class Vectorizer {
+ public:
+  Vectorizer(IRList& irs, const Function& func, const CFG& cfg,
+             const Loop& loop, const CountedLoop& cl)
+      : irs(irs), func(func), cfg(cfg), loop(loop), cl(cl) {}
+  bool legal();
+  string transform();
+
+ private:
+  IRList& irs;
+  const Function& func;
+  const CFG& cfg;
+  const Loop& loop;
+  const CountedLoop& cl;
+  vector<IR*> body;
+  unordered_set<string> offsets, vectors, reductions, defined;
+
+  bool invariant(const OpName& op) const;
+};
+
+bool Vectorizer::invariant(const OpName& op) const {
+  int c;
+  if (op.get_const(c)) return true;
+  return op.is_var() && !defined.count(op.name);
+}
+
+bool Vectorizer::legal() {
+  if (cl.step != 1 || cl.exit_cc != OpCode::JGE || loop.blocks.size() != 2) {
+    return false;
+  }
+  auto& bb = cfg.blocks[loop.latches[0]];
+  for (auto it = bb.begin; it != std::prev(bb.end); it++) {
+    if (it->op_code == OpCode::LABEL) continue;
+    if (it->dest.is_var()) {
+      if (defined.count(it->dest.name)) return false;
+      defined.insert(it->dest.name);
+    }
+    body.push_back(&*it);
+  }
+
+  unordered_map<string, int> uses;
+  vector<const IR*> mem;
+  for (auto ir : body) {
+    auto is_vec = [&](const OpName& op) {
+      return op.is_var() && vectors.count(op.name);
+    };
+    if (ir->dest == cl.iv) continue;  // the induction step
+    if (isOffsetOf(*ir, cl.iv)) {
+      offsets.insert(ir->dest.name);
+    } else if (ir->op_code == OpCode::LOAD) {
+      if (!ir->op2.is_var() || !offsets.count(ir->op2.name)) return false;
+      vectors.insert(ir->dest.name);
+      mem.push_back(ir);
+    } else if (ir->op_code == OpCode::STORE) {
+      if (!ir->op2.is_var() || !offsets.count(ir->op2.name)) return false;
+      if (!is_vec(ir->op3)) return false;
+      mem.push_back(ir);
+    } else if (ir->op_code == OpCode::ADD && ir->dest == ir->op1 &&
+               is_vec(ir->op2)) {
+      // s = s + v, reduced once per strip
+      reductions.insert(ir->dest.name);
+    } else if (vectorOp(ir->op_code) != OpCode::NOOP) {
+      bool v1 = is_vec(ir->op1), v2 = is_vec(ir->op2);
+      bool ok = (v1 && (v2 || invariant(ir->op2))) ||
+                (v2 && invariant(ir->op1) && ir->op_code != OpCode::SUB);
+      if (!ok) return false;
+      vectors.insert(ir->dest.name);
+    } else {
+      return false;
+    }
+  }
+  if (mem.empty()) return false;
+
+  // reductions and vector values must not leak outside their own update
+  for (auto ir : body) {
+    ir->forEachOp(
+        [&](const OpName& op) {
+          if (op.is_var() && reductions.count(op.name)) uses[op.name]++;
+        },
+        false);
+  }
+  for (auto& r : reductions) {
+    if (uses[r] != 1) return false;
+  }
+  for (auto it = func.begin; it != func.end; it++) {
+    bool in_body = false;
+    for (auto ir : body) in_body = in_body || ir == &*it;
+    if (in_body) continue;
+    bool leaks = it->some(
+        [&](const OpName& op) {
+          return op.is_var() && (vectors.count(op.name) ||
+                                 offsets.count(op.name));
+        },
+        false);
+    if (leaks) return false;
+  }
+
+  // every store must be independent from every other access across
+  // iterations: either the same element, or a provably distinct object
+  AliasAnalysis aa(func);
+  for (auto a : mem) {
+    if (a->op_code != OpCode::STORE) continue;
+    for (auto b : mem) {
+      if (a == b) continue;
+      if (a->op1 == b->op1) {
+        if (!(a->op2 == b->op2)) return false;
+        continue;
+      }
+      auto la = aa.location(*a), lb = aa.location(*b);
+      bool objects = (la.base.is_global_var() || aa.isStackArray(la.base)) &&
+                     (lb.base.is_global_var() || aa.isStackArray(lb.base));
+      if (!objects || aa.alias(la, lb) != AliasResult::NoAlias) return false;
+    }
+  }
+  return true;
+}
+
+string Vectorizer::transform() {
+  int id = context().names(func.name).vectorize++;
+  string prefix = "%_v" + to_string(id);
+  auto& hb = cfg.blocks[loop.header];
+  string vec_label = hb.label + "_v" + to_string(id);
+
+  auto back_jump = std::prev(cfg.blocks[loop.latches[0]].end);
+  for (auto& bb : cfg.blocks) {
+    for (auto it = bb.begin; it != bb.end; it++) {
+      if (isBranch(it->op_code) && it->label == hb.label && it != back_jump) {
+        it->label = vec_label;
+      }
+    }
+  }
+
+  auto vec = [&](const OpName& op) {
+    if (op.is_var() && vectors.count(op.name)) {
+      return OpName(prefix + "_" + op.name.substr(1));
+    }
+    return op;
+  };
+  OpName rem(prefix + "_rem"), vl(prefix + "_vl");
+  IRList out;
+  out.push_back(IR(OpCode::LABEL, vec_label));
+  // the loop's own test first: bound - iv wraps when they are far apart, and
+  // a wrapped remainder is negative, so it is left to the scalar loop
+  out.push_back(IR(OpCode::cmp, OpName(), cl.iv, cl.bound));
+  out.push_back(IR(OpCode::JGE, hb.label));
+  out.push_back(IR(OpCode::SUB, rem, cl.bound, cl.iv));
+  out.push_back(IR(OpCode::cmp, OpName(), rem, OpName(0)));
+  out.push_back(IR(OpCode::JLE, hb.label));
+  out.push_back(IR(OpCode::VSETVL, vl, rem));
+  for (auto ir : body) {
+    if (ir->dest == cl.iv) {
+      out.push_back(IR(OpCode::ADD, cl.iv, cl.iv, vl));
+    } else if (offsets.count(ir->dest.name)) {
+      out.push_back(*ir);
+    } else if (ir->op_code == OpCode::LOAD) {
+      out.push_back(IR(OpCode::VLOAD, vec(ir->dest), ir->op1, ir->op2));
+    } else if (ir->op_code == OpCode::STORE) {
+      out.push_back(IR(OpCode::VSTORE, OpName(), ir->op1, ir->op2, vec(ir->op3)));
+    } else if (reductions.count(ir->dest.name)) {
+      out.push_back(IR(OpCode::VREDSUM, ir->dest, ir->op1, vec(ir->op2)));
+    } else {
+      OpName a = ir->op1, b = ir->op2;
+      if (!vectors.count(a.name)) std::swap(a, b);  // keep the vector first
+      out.push_back(IR(vectorOp(ir->op_code), vec(ir->dest), vec(a), vec(b)));
+    }
+  }
+  out.push_back(IR(OpCode::jm, vec_label));
+  irs.splice(hb.begin, out);
+  return vec_label;
+}
+}  // namespace
+
+void loop_vectorize(IRList& irs) {
+  for (auto& func : splitFunctions(irs)) {
+    set<string> done;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      CFG cfg(func);
+      LoopInfo loop_info(cfg);
+      for (auto& loop : loop_info.loops) {
+        auto& label = cfg.blocks[loop.header].label;
+        if (!loop.innermost || label.empty() || done.count(label)) continue;
+        done.insert(label);
+        CountedLoop cl;
+        if (!analyzeCountedLoop(cfg, loop, cl)) continue;
+        Vectorizer vectorizer(irs, func, cfg, loop, cl);
+        if (!vectorizer.legal()) continue;
+        done.insert(vectorizer.transform());
+        changed = true;
+        break;
+      }
+    }
+  }
+}
+}  // namespace ir
@@ -1,55 +1,42 @@
-#include <cassert>
-#include <cstdio>
 #include <iostream>
-#include <memory>
-#include <string>
 #include "koopa.h"
+#include "cache.h"
+#include "config.h"
+#include "driver.h"
+#include "server.h"
 // #include "env.h"
-#include "node.h"
-#include "ir.h"
+#include "stats.h"
 
 using namespace std;
 
-// 声明 lexer 的输入, 以及 parser 函数
-// 为什么不引用 sysy.tab.hpp 呢? 因为首先里面没有 yyin 的定义
-// 其次, 因为这个文件不是我们自己写的, 而是被 Bison 生成出来的
-// 你的代码编辑器/IDE 很可能找不到这个文件, 然后会给你报错 (虽然编译不会出错)
-// 看起来会很烦人, 于是干脆采用这种看起来 dirty 但实际很有效的手段
-extern FILE *yyin;
-extern int yyparse(unique_ptr<BaseAST> &ast);
-extern void yyerror(unique_ptr<BaseAST> &ast, string s);
-
 int main(int argc, const char *argv[]) {
   // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
   // compiler 模式 输入文件 -o 输出文件
-  assert(argc == 5);
-  // auto mode = argv[1];
-  auto input = argv[2];
-  auto output = argv[4];
-
-  // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
-  yyin = fopen(input, "r");
-  assert(yyin);
-
-  // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
-  unique_ptr<BaseAST> ast;
-  auto ret = yyparse(ast);
-  if (!ret) {
-    yyerror(ast, ast->toString());
+  config::parse_arg(argc, argv);
+  if (!config::server.empty()) return server::serve(config::server);
+  driver::Unit unit{config::mode, config::input, config::output, ""};
+  if (config::stop_server) return server::stop(config::connect) ? 0 : 1;
+  if (config::mode == "-run" || config::mode == "-jit") {
+    int status = driver::runUnit(unit, config::jobs);
+    if (stats::enabled()) stats::report(cerr);
+    return status;
+  }
+  if (!config::connect.empty() && config::batch.empty()) {
+    bool ok;
+    if (server::forward(config::connect, unit, ok)) return ok ? 0 : 1;
+    cerr << "warning: no server at " << config::connect << ", compiling here"
+         << endl;
   }
-  assert(!ret);
-
-  // ofstream ofs;
-  // ofs.open(output, ios::out|ios::trunc);
-  // ofs.close();
-
-  // 输出解析得到的 AST, 其实就是个字符串
-  ast->Dump();
-  cout << endl;
 
-  ast->toIr(output);
-  // ir::IR_DUMP* ir_dump = new ir::IR_DUMP(output);
-  // ir_dump->writeALL(IRList);
+  int failed;
+  if (!config::batch.empty()) {
+    failed = driver::compileBatch(config::batch);
+  } else {
+    failed = !driver::compileUnit(unit, config::jobs);
+  }
+  if (stats::enabled()) stats::report(cerr);
+  if (config::cache_stats && cache::enabled()) cache::report(cerr);
+  if (failed) return 1;
 
   // // 解析字符串 str, 得到 Koopa IR 程序
   // koopa_program_t program;
@@ -0,0 +1,85 @@
+#include "cfg.h"
+#include "config.h"
+#include "context.h"
+#include "optimize.h"
+#include "purity.h"
+
+// Adds a result cache to pure, self-recursive functions of one int
+// argument. Arguments in [0, config::memo_size) are looked up in a global
+// table on entry and recorded before every return; other arguments take
+// the original path untouched.
+
+namespace ir {
+namespace {
+
+// cmp arg, 0; JLT miss; cmp arg, size; JGE miss; offset = arg * 4
+void rangeCheck(IRList& out, const OpName& arg, const string& miss,
+                const OpName& offset) {
+  out.push_back(IR(OpCode::cmp, OpName(), arg, OpName(0)));
+  out.push_back(IR(OpCode::JLT, miss));
+  out.push_back(IR(OpCode::cmp, OpName(), arg, OpName(config::memo_size)));
+  out.push_back(IR(OpCode::JGE, miss));
+  out.push_back(IR(OpCode::MUL, offset, arg, OpName(4)));
+}
+
+void declareTable(IRList& irs, IRList::iterator pos, const string& name) {
+  irs.insert(pos, IR(OpCode::DATA_BEGIN, name));
+  irs.insert(pos, IR(OpCode::DATA_SPACE, OpName(), OpName(config::memo_size * 4)));
+  irs.insert(pos, IR(OpCode::DATA_END));
+}
+
+void memoizeFunction(IRList& irs, const Function& func, const OpName& arg) {
+  int id = context().names(func.name).memo++;
+  string prefix = "%_m" + to_string(id);
+  string values = "@_memo_" + func.name, known = "@_memo_" + func.name + "_set";
+  declareTable(irs, func.begin, values);
+  declareTable(irs, func.begin, known);
+
+  // entry: return the cached result if there is one
+  auto body = std::next(func.begin);
+  string compute = prefix + "_compute";
+  IRList entry;
+  OpName offset(prefix + "_o"), flag(prefix + "_f"), cached(prefix + "_v");
+  entry.push_back(IR(OpCode::LABEL, prefix + "_entry"));
+  rangeCheck(entry, arg, compute, offset);
+  entry.push_back(IR(OpCode::LOAD, flag, OpName(known), offset));
+  entry.push_back(IR(OpCode::cmp, OpName(), flag, OpName(0)));
+  entry.push_back(IR(OpCode::JEQ, compute));
+  entry.push_back(IR(OpCode::LOAD, cached, OpName(values), offset));
+  entry.push_back(IR(OpCode::RET, OpName(), cached));
+  entry.push_back(IR(OpCode::LABEL, compute));
+  irs.splice(body, entry);
+
+  // every return records its value first
+  int k = 0;
+  for (auto it = body; it != func.end; it++) {
+    if (it->op_code != OpCode::RET || it->op1.is_null()) continue;
+    string done = prefix + "_r" + to_string(k);
+    OpName ret_offset(prefix + "_o" + to_string(k));
+    k++;
+    IRList record;
+    rangeCheck(record, arg, done, ret_offset);
+    record.push_back(IR(OpCode::STORE, OpName(), OpName(values), ret_offset, it->op1));
+    record.push_back(IR(OpCode::STORE, OpName(), OpName(known), ret_offset, OpName(1)));
+    record.push_back(IR(OpCode::LABEL, done));
+    irs.splice(it, record);
+  }
+}
+}  // namespace
+
+void memoize(IRList& irs, const PurityInfo& purity) {
+  for (auto& func : splitFunctions(irs)) {
+    if (purity.effect(func.name) != FuncEffect::Pure) continue;
+    if (!purity.isRecursive(func.name)) continue;
+    auto params = functionParams(*func.begin);
+    if (params.size() != 1) continue;
+    if (func.begin->label.find("): i32") == string::npos) continue;
+    OpName arg(params[0]);
+    bool assigned = false;
+    for (auto it = func.begin; it != func.end; it++) {
+      if (it->dest == arg) assigned = true;
+    }
+    if (!assigned) memoizeFunction(irs, func, arg);
+  }
+}
+}  // namespace ir
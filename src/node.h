@@ -6,34 +6,17 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include "ast_writer.h"
+#include "context.h"
 #include "ir.h"
 // #include "env.h"
 
 using Int = std::int32_t;
 using namespace std;
 
-static int INDENTATION = 0;
-inline string INDENT() {
-  string ret = "";
-  for (int i=0; i<INDENTATION; i++) {
-    ret += "  ";
-  }
-  return ret;
-}
-static int IR_INDENTATION = 0;
-inline string IR_INDENT() {
-  string ret = "";
-  for (int i=0; i<IR_INDENTATION; i++) {
-    ret += "  ";
-  }
-  return ret;
-}
-
-static vector<string> AST_REG;
-static int AST_REG_COUNT = 0;
-static int AST_BLOCK_COUNT = 0;
 inline string block2str() {
-  return "%_b_"+to_string(AST_BLOCK_COUNT)+":";
+  return "%_b_"+to_string(context().block_count);
 }
 
 struct IrRet {
@@ -69,7 +52,7 @@ class BaseAST {
   public:
     int value = 0;
     virtual ~BaseAST() = default;
-    virtual void Dump() const = 0;
+    virtual void Dump(AstWriter& w) const = 0;
     virtual IrRet toIr(string filename) const = 0;
     virtual string toString() { return "BaseAST"; };
 
@@ -82,8 +65,8 @@ class BaseAST {
 class SAST : public BaseAST {
   public:
     unique_ptr<BaseAST> comp_unit;
-    void Dump() const override {
-      comp_unit->Dump();
+    void Dump(AstWriter& w) const override {
+      comp_unit->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return comp_unit->toIr(filename);
@@ -98,13 +81,11 @@ class CompUnitAST : public BaseAST {
   public:
     unique_ptr<BaseAST> decl_or_func_def;
     unique_ptr<BaseAST> decl_or_func_defs;
-    void Dump() const override {
-      cout << INDENT() << "CompUnitAST {\n";
-      INDENTATION++;
-      decl_or_func_def->Dump();
-      decl_or_func_defs->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("CompUnitAST");
+      decl_or_func_def->Dump(w);
+      decl_or_func_defs->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       decl_or_func_def->toIr(filename);
@@ -122,23 +103,26 @@ class FuncDefAST : public BaseAST {
     string ident;
     unique_ptr<BaseAST> func_f_params;
     unique_ptr<BaseAST> block;
-    void Dump() const override {
-      cout << INDENT() << "FuncDefAST {\n";
-      INDENTATION++;
-      func_type->Dump();
-      cout << INDENT() << "IDENT: " << ident << ",\n";
-      func_f_params->Dump();
-      block->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("FuncDefAST");
+      func_type->Dump(w);
+      w.leaf("IDENT", ident);
+      func_f_params->Dump(w);
+      block->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
+      // 临时变量和基本块在每个函数里从 0 编号, 函数的 IR 只取决于它自己,
+      // 和前面有哪些函数无关 (--incremental 按函数缓存要用到)
+      context().reg_count = 0;
+      context().block_count = 0;
+
       /* First line */
       ir::IR* func_def_ir1 = new  ir::IR(
         ir::OpCode::FUNCTION_BEGIN, 
         "fun @"+ident+"("+func_f_params->toString()+"): "+func_type->toString() + " {"
       );
-      func_def_ir1->print(filename);
+      context().ir.push_back(*func_def_ir1);
 
       block->toIr(filename);
 
@@ -147,7 +131,7 @@ class FuncDefAST : public BaseAST {
         ir::OpCode::FUNCTION_END, 
         "}"
       );
-      func_def_ir2->print(filename);
+      context().ir.push_back(*func_def_ir2);
       return IrRet(IrRet::tag::None, -1);
     }
     string toString() override {
@@ -158,8 +142,8 @@ class FuncDefAST : public BaseAST {
 class FuncTypeAST : public BaseAST {
   public:
     string type;
-    void Dump() const override {
-      cout << INDENT() << "FuncTypeAST: " << type << ",\n";
+    void Dump(AstWriter& w) const override {
+      w.leaf("FuncTypeAST", type);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -177,16 +161,14 @@ class StmtAST : public BaseAST {
     unique_ptr<BaseAST> l_value_or_single;
     unique_ptr<BaseAST> r_value_1;
     unique_ptr<BaseAST> r_value_2;
-    void Dump() const override {
-      cout << INDENT() << "StmtAST {\n";
-      INDENTATION++;
-      cout << INDENT() << "keyword: " << keyword << ",\n";
-      l_value_or_single->Dump();
-      r_value_1->Dump();
-      if (optional_keyword.length()) cout << INDENT() << "optional_keyword: " << optional_keyword << ",\n";
-      r_value_2->Dump();
-      INDENTATION--;
-      cout << INDENT() <<  "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("StmtAST");
+      w.leaf("keyword", keyword);
+      l_value_or_single->Dump(w);
+      r_value_1->Dump(w);
+      if (optional_keyword.length()) w.leaf("optional_keyword", optional_keyword);
+      r_value_2->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       if (keyword == "return") {
@@ -196,7 +178,7 @@ class StmtAST : public BaseAST {
           ir::OpName(), 
           ir::OpName(op1)
         );
-        stmt_ir->print(filename);
+        context().ir.push_back(*stmt_ir);
         return IrRet(IrRet::tag::None, -1);
       } else {
         return l_value_or_single->toIr(filename);// TODO
@@ -210,12 +192,10 @@ class ExpAST : public BaseAST {
     int value = 0;
 
     unique_ptr<BaseAST> exp;
-    void Dump() const override {
-      cout << INDENT() << "ExpAST {\n";
-      INDENTATION++;
-      exp->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("ExpAST");
+      exp->Dump(w);
+      w.end();
     }  
     IrRet toIr(string filename) const override {
       return exp->toIr(filename);
@@ -227,12 +207,10 @@ class PrimaryExpAST : public BaseAST {
   public:
     const volatile int reg_idx = -1;
     unique_ptr<BaseAST> value;
-    void Dump() const override {
-      // cout << INDENT() << "PrimaryExpAST {\n";
-      // INDENTATION++;
-      value->Dump();
-      // INDENTATION--;
-      // cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      // w.begin("PrimaryExpAST");
+      value->Dump(w);
+      // w.end();
     }  
     IrRet toIr(string filename) const override {
       return value->toIr(filename);
@@ -247,38 +225,36 @@ class UnaryExpAST : public BaseAST {
     string op = "";
     unique_ptr<BaseAST> exp_or_op_or_params_1;
     unique_ptr<BaseAST> exp_or_op_2;
-    void Dump() const override {
-      cout << INDENT() << "UnaryExpAST {\n";
-      INDENTATION++;
-      cout << INDENT() << "IDENT: " << ident << "\n";
-      exp_or_op_or_params_1->Dump();
-      exp_or_op_2->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("UnaryExpAST");
+      w.leaf("IDENT", ident);
+      exp_or_op_or_params_1->Dump(w);
+      exp_or_op_2->Dump(w);
+      w.end();
     }  
     IrRet toIr(string filename) const override {
       if (op == "!") {
         string op1 = reg2str(exp_or_op_2->toIr(filename));
         ir::IR* unaryexp_ir = new  ir::IR(
           ir::OpCode::EQ, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(to_string(0))
         );
-        unaryexp_ir->print(filename);
+        context().ir.push_back(*unaryexp_ir);
       } else if (op == "-") {
         string op2 = reg2str(exp_or_op_2->toIr(filename));
         ir::IR* unaryexp_ir = new  ir::IR(
           ir::OpCode::SUB, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(to_string(0)),
           ir::OpName(op2)
         );
-        unaryexp_ir->print(filename);
+        context().ir.push_back(*unaryexp_ir);
       } else {
         return exp_or_op_2->toIr(filename);
       }
-      return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+      return IrRet(IrRet::tag::Var, context().reg_count++);;
     }
     string toString() override { return "UnaryExpAST"; }
 };
@@ -288,35 +264,33 @@ class AddExpAST : public BaseAST {
     string op = "";
     unique_ptr<BaseAST> exp_1;
     unique_ptr<BaseAST> exp_3;
-    void Dump() const override {
-      cout << INDENT() << "AddExpAST {\n";
-      INDENTATION++;
-      exp_1->Dump();
-      exp_3->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("AddExpAST");
+      exp_1->Dump(w);
+      exp_3->Dump(w);
+      w.end();
     }   
     IrRet toIr(string filename) const override {
       if (op == "+") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* addexp_ir = new  ir::IR(
           ir::OpCode::ADD, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        addexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*addexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == "-") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* addexp_ir = new  ir::IR(
           ir::OpCode::SUB, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        addexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*addexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else {
         return exp_3->toIr(filename);
       }
@@ -330,46 +304,44 @@ class MulExpAST : public BaseAST {
     unique_ptr<BaseAST> exp_1;
     // unique_ptr<BaseAST> op_2;
     unique_ptr<BaseAST> exp_3;
-    void Dump() const override {
-      cout << INDENT() << "MulExpAST {\n";
-      INDENTATION++;
-      exp_1->Dump();
-      // op_2->Dump();
-      exp_3->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("MulExpAST");
+      exp_1->Dump(w);
+      // op_2->Dump(w);
+      exp_3->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       if (op == "*") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* mulexp_ir = new  ir::IR(
           ir::OpCode::MUL, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        mulexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*mulexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == "/") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* mulexp_ir = new  ir::IR(
           ir::OpCode::DIV, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        mulexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*mulexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == "%%") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* mulexp_ir = new  ir::IR(
           ir::OpCode::MOD, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        mulexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*mulexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else {
         return exp_3->toIr(filename);
       }
@@ -383,14 +355,12 @@ class LOrExpAST : public BaseAST {
     unique_ptr<BaseAST> exp_1;
     // unique_ptr<BaseAST> op_2;
     unique_ptr<BaseAST> exp_3;
-    void Dump() const override {
-      cout << INDENT() << "LOrExpAST {\n";
-      INDENTATION++;
-      exp_1->Dump();
-      // op_2->Dump();
-      exp_3->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("LOrExpAST");
+      exp_1->Dump(w);
+      // op_2->Dump(w);
+      exp_3->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       if (op == "||") {
@@ -399,30 +369,30 @@ class LOrExpAST : public BaseAST {
 
         ir::IR* lorexp_ir1 = new  ir::IR(
           ir::OpCode::NE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(to_string(0))
         );
-        lorexp_ir1->print(filename);
-        AST_REG_COUNT++;
+        context().ir.push_back(*lorexp_ir1);
+        context().reg_count++;
 
         ir::IR* lorexp_ir2 = new  ir::IR(
           ir::OpCode::NE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op2),
           ir::OpName(to_string(0))
         );
-        lorexp_ir2->print(filename);
-        AST_REG_COUNT++;
+        context().ir.push_back(*lorexp_ir2);
+        context().reg_count++;
 
         ir::IR* lorexp_ir3 = new  ir::IR(
           ir::OpCode::OR, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
-          ir::OpName(reg2str(AST_REG_COUNT-1)),
-          ir::OpName(reg2str(AST_REG_COUNT-2))
+          ir::OpName(reg2str(context().reg_count)), 
+          ir::OpName(reg2str(context().reg_count-1)),
+          ir::OpName(reg2str(context().reg_count-2))
         );
-        lorexp_ir3->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*lorexp_ir3);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else {
         return exp_3->toIr(filename);
       } 
@@ -436,56 +406,54 @@ class RelExpAST : public BaseAST {
     unique_ptr<BaseAST> exp_1;
     // unique_ptr<BaseAST> op_2;
     unique_ptr<BaseAST> exp_3;
-    void Dump() const override {
-      cout << INDENT() << "RelExpAST {\n";
-      INDENTATION++;
-      exp_1->Dump();
-      // op_2->Dump();
-      exp_3->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("RelExpAST");
+      exp_1->Dump(w);
+      // op_2->Dump(w);
+      exp_3->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       if (op == "<") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* relexp_ir = new  ir::IR(
           ir::OpCode::LT, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        relexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*relexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == ">") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* relexp_ir = new  ir::IR(
           ir::OpCode::GT, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        relexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*relexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == "<=") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* relexp_ir = new  ir::IR(
           ir::OpCode::LE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        relexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*relexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == ">=") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* relexp_ir = new  ir::IR(
           ir::OpCode::GE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        relexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*relexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else {
         return exp_3->toIr(filename);
       }
@@ -499,36 +467,34 @@ class EqExpAST : public BaseAST {
     unique_ptr<BaseAST> exp_1;
     // unique_ptr<BaseAST> op_2;
     unique_ptr<BaseAST> exp_3;
-    void Dump() const override {
-      cout << INDENT() << "EqExpAST {\n";
-      INDENTATION++;
-      exp_1->Dump();
-      // op_2->Dump();
-      exp_3->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("EqExpAST");
+      exp_1->Dump(w);
+      // op_2->Dump(w);
+      exp_3->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       if (op == "==") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* eqexp_ir = new  ir::IR(
           ir::OpCode::EQ, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        eqexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*eqexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else if (op == "!=") {
         string op1 = reg2str(exp_1->toIr(filename)), op2 = reg2str(exp_3->toIr(filename));
         ir::IR* eqexp_ir = new  ir::IR(
           ir::OpCode::NE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(op2)
         );
-        eqexp_ir->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*eqexp_ir);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else {
         return exp_3->toIr(filename);
       }
@@ -542,14 +508,12 @@ class LAndExpAST : public BaseAST {
     unique_ptr<BaseAST> exp_1;
     // unique_ptr<BaseAST> op_2;
     unique_ptr<BaseAST> exp_3;
-    void Dump() const override {
-      cout << INDENT() << "LAndExpAST {\n";
-      INDENTATION++;
-      exp_1->Dump();
-      // op_2->Dump();
-      exp_3->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("LAndExpAST");
+      exp_1->Dump(w);
+      // op_2->Dump(w);
+      exp_3->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       if (op == "&&") {
@@ -558,30 +522,30 @@ class LAndExpAST : public BaseAST {
 
         ir::IR* landexp_ir1 = new  ir::IR(
           ir::OpCode::NE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op1),
           ir::OpName(to_string(0))
         );
-        landexp_ir1->print(filename);
-        AST_REG_COUNT++;
+        context().ir.push_back(*landexp_ir1);
+        context().reg_count++;
 
         ir::IR* landexp_ir2 = new  ir::IR(
           ir::OpCode::NE, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
+          ir::OpName(reg2str(context().reg_count)), 
           ir::OpName(op2),
           ir::OpName(to_string(0))
         );
-        landexp_ir2->print(filename);
-        AST_REG_COUNT++;
+        context().ir.push_back(*landexp_ir2);
+        context().reg_count++;
 
         ir::IR* landexp_ir3 = new  ir::IR(
           ir::OpCode::AND, 
-          ir::OpName(reg2str(AST_REG_COUNT)), 
-          ir::OpName(reg2str(AST_REG_COUNT-1)),
-          ir::OpName(reg2str(AST_REG_COUNT-2))
+          ir::OpName(reg2str(context().reg_count)), 
+          ir::OpName(reg2str(context().reg_count-1)),
+          ir::OpName(reg2str(context().reg_count-2))
         );
-        landexp_ir3->print(filename);
-        return IrRet(IrRet::tag::Var, AST_REG_COUNT++);;
+        context().ir.push_back(*landexp_ir3);
+        return IrRet(IrRet::tag::Var, context().reg_count++);;
       } else {
         return exp_3->toIr(filename);
       }
@@ -593,8 +557,8 @@ class NumberAST : public BaseAST {
   public:
     int value = 0;
     Int int_const;
-    void Dump() const override {
-      cout << INDENT() << "NumberAST: " << to_string(int_const) << "\n";
+    void Dump(AstWriter& w) const override {
+      w.leaf("NumberAST", to_string(int_const));
     }  
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::Imm, int_const);
@@ -605,8 +569,8 @@ class NumberAST : public BaseAST {
 // class UnaryOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "UnaryOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("UnaryOpAST", op);
 //     }  
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -617,8 +581,8 @@ class NumberAST : public BaseAST {
 // class AddOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "AddOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("AddOpAST", op);
 //     }  
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -629,8 +593,8 @@ class NumberAST : public BaseAST {
 // class MulOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "MulOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("MulOpAST", op);
 //     } 
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -641,8 +605,8 @@ class NumberAST : public BaseAST {
 // class RelOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "RelOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("RelOpAST", op);
 //     }  
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -653,8 +617,8 @@ class NumberAST : public BaseAST {
 // class EqOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "EqOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("EqOpAST", op);
 //     } 
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -665,8 +629,8 @@ class NumberAST : public BaseAST {
 // class LAndOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "LAndOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("LAndOpAST", op);
 //     } 
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -677,8 +641,8 @@ class NumberAST : public BaseAST {
 // class LOrOpAST : public BaseAST {
 //   public:
 //     string op;
-//     void Dump() const override {
-//       cout << INDENT() << "LOrOpAST: " << op << "\n";
+//     void Dump(AstWriter& w) const override {
+//       w.leaf("LOrOpAST", op);
 //     }  
 //     IrRet toIr(string filename) const override {
 //       return IrRet(IrRet::tag::None, -1);
@@ -688,7 +652,7 @@ class NumberAST : public BaseAST {
 
 class NullAST : public BaseAST {
   public:
-    void Dump() const override {}
+    void Dump(AstWriter& w) const override {}
     IrRet toIr(string filename) const override { return IrRet(IrRet::tag::None, -1); }
     string toString() override { return ""; }
 };
@@ -698,12 +662,10 @@ class NullAST : public BaseAST {
 class DeclAST : public BaseAST {
   public:
     unique_ptr<BaseAST> const_decl_or_var_decl;
-    void Dump() const override {
-      cout << INDENT() << "DeclAST {\n";
-      INDENTATION++;
-      const_decl_or_var_decl->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("DeclAST");
+      const_decl_or_var_decl->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return const_decl_or_var_decl->toIr(filename);
@@ -719,14 +681,12 @@ class ConstDeclAST : public BaseAST {
     unique_ptr<BaseAST> b_type;
     unique_ptr<BaseAST> const_def;
     unique_ptr<BaseAST> comma_const_defs;
-    void Dump() const override {
-      cout << INDENT() << "ConstDeclAST " << keyword << " {\n";
-      INDENTATION++;
-      b_type->Dump();
-      const_def->Dump();
-      comma_const_defs->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("ConstDeclAST", keyword);
+      b_type->Dump(w);
+      const_def->Dump(w);
+      comma_const_defs->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       // TODO
@@ -749,9 +709,9 @@ class CommaConstDefsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> const_def;
     unique_ptr<BaseAST> comma_const_defs;
-    void Dump() const override {
-      const_def->Dump();
-      comma_const_defs->Dump();
+    void Dump(AstWriter& w) const override {
+      const_def->Dump(w);
+      comma_const_defs->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -761,8 +721,8 @@ class CommaConstDefsAST : public BaseAST {
 class BTypeAST : public BaseAST {
   public:
     string type;
-    void Dump() const override {
-      cout << INDENT() << "BTypeAST: " << type << "\n";
+    void Dump(AstWriter& w) const override {
+      w.leaf("BTypeAST", type);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -776,13 +736,11 @@ class ConstDefAST : public BaseAST {
     string ident;
     unique_ptr<BaseAST> bracket_const_exps;
     unique_ptr<BaseAST> const_init_val;
-    void Dump() const override {
-      cout << INDENT() << "ConstDefAST { IDENT: " << ident << ",\n";
-      INDENTATION++;
-      bracket_const_exps->Dump();
-      const_init_val->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("ConstDefAST", ident);
+      bracket_const_exps->Dump(w);
+      const_init_val->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
 
@@ -794,13 +752,11 @@ class ConstInitValAST : public BaseAST {
   public:
     unique_ptr<BaseAST> const_exp;
     unique_ptr<BaseAST> comma_const_exps;
-    void Dump() const override {
-      cout << INDENT() << "ConstInitValAST {\n";
-      INDENTATION++;
-      const_exp->Dump();
-      comma_const_exps->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("ConstInitValAST");
+      const_exp->Dump(w);
+      comma_const_exps->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -810,20 +766,18 @@ class ConstInitValAST : public BaseAST {
 class BlockAST : public BaseAST {
   public:
     unique_ptr<BaseAST> stmt_or_block_items;
-    void Dump() const override {
-      // cout << INDENT() << "BlockAST {\n";
-      // INDENTATION++;
-      stmt_or_block_items->Dump();
-      // INDENTATION--;
-      // cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      // w.begin("BlockAST");
+      stmt_or_block_items->Dump(w);
+      // w.end();
     }
     IrRet toIr(string filename) const override {
       ir::IR* block_ir = new  ir::IR(
-        ir::OpCode::INFO, 
+        ir::OpCode::LABEL, 
         block2str()
       );
-      AST_BLOCK_COUNT++;
-      block_ir->print(filename);
+      context().block_count++;
+      context().ir.push_back(*block_ir);
       return stmt_or_block_items->toIr(filename);
     }
 };
@@ -832,9 +786,9 @@ class BlockItemsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> block_item;
     unique_ptr<BaseAST> block_items;
-    void Dump() const override {
-      block_item->Dump();
-      block_items->Dump();
+    void Dump(AstWriter& w) const override {
+      block_item->Dump(w);
+      block_items->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -844,12 +798,10 @@ class BlockItemsAST : public BaseAST {
 class BlockItemAST : public BaseAST {
   public:
     unique_ptr<BaseAST> decl_or_stmt;
-    void Dump() const override {
-      cout << INDENT() << "BlockItemAST {\n";
-      INDENTATION++;
-      decl_or_stmt->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("BlockItemAST");
+      decl_or_stmt->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -860,9 +812,9 @@ class LValAST : public BaseAST {
   public:
     string ident;
     // unique_ptr<BaseAST> bracket_exps;
-    void Dump() const override {
-      cout << INDENT() << "LValAST: IDENT: " << ident << "\n";
-      // bracket_exps->Dump();
+    void Dump(AstWriter& w) const override {
+      w.leaf("LValAST", ident);
+      // bracket_exps->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -874,12 +826,10 @@ class ConstExpAST : public BaseAST {
     int value;
 
     unique_ptr<BaseAST> exp;
-    void Dump() const override {
-      // cout << INDENT() << "ConstExpAST {\n";
-      // INDENTATION++;
-      exp->Dump();
-      // INDENTATION--;
-      // cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      // w.begin("ConstExpAST");
+      exp->Dump(w);
+      // w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -891,14 +841,12 @@ class VarDeclAST : public BaseAST {
     unique_ptr<BaseAST> b_type;
     unique_ptr<BaseAST> var_def;
     unique_ptr<BaseAST> comma_var_defs;
-    void Dump() const override {
-      cout << INDENT() << "VarDeclAST {\n";
-      INDENTATION++;
-      b_type->Dump();
-      var_def->Dump();
-      comma_var_defs->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("VarDeclAST");
+      b_type->Dump(w);
+      var_def->Dump(w);
+      comma_var_defs->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -909,9 +857,9 @@ class CommaVarDefsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> var_def;
     unique_ptr<BaseAST> comma_var_defs;
-    void Dump() const override {
-      var_def->Dump();
-      comma_var_defs->Dump();
+    void Dump(AstWriter& w) const override {
+      var_def->Dump(w);
+      comma_var_defs->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -923,13 +871,11 @@ class VarDefAST : public BaseAST {
     string ident;
     unique_ptr<BaseAST> bracket_const_exps;
     unique_ptr<BaseAST> init_val;
-    void Dump() const override {
-      cout << INDENT() << "VarDefAST { IDENT: " << ident << ",\n";
-      INDENTATION++;
-      bracket_const_exps->Dump();
-      init_val->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("VarDefAST", ident);
+      bracket_const_exps->Dump(w);
+      init_val->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -940,13 +886,11 @@ class InitValAST : public BaseAST {
   public:
     unique_ptr<BaseAST> exp;
     unique_ptr<BaseAST> comma_exps;
-    void Dump() const override {
-      cout << INDENT() << "InitValAST {\n";
-      INDENTATION++;
-      exp->Dump();
-      comma_exps->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("InitValAST");
+      exp->Dump(w);
+      comma_exps->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -959,13 +903,11 @@ class FuncFParamsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> func_f_param;
     unique_ptr<BaseAST> comma_func_f_params;
-    void Dump() const override {
-      cout << INDENT() << "FuncFParamsAST {\n";
-      INDENTATION++;
-      func_f_param->Dump();
-      comma_func_f_params->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("FuncFParamsAST");
+      func_f_param->Dump(w);
+      comma_func_f_params->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -976,9 +918,9 @@ class CommaFuncFParamsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> func_f_param;
     unique_ptr<BaseAST> comma_func_f_params;
-    void Dump() const override {
-      func_f_param->Dump();
-      comma_func_f_params->Dump();
+    void Dump(AstWriter& w) const override {
+      func_f_param->Dump(w);
+      comma_func_f_params->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -989,13 +931,11 @@ class FuncFParamAST : public BaseAST {
   public:
     unique_ptr<BaseAST> b_type;
     string ident;
-    void Dump() const override {
-      cout << INDENT() << "FuncFParamAST {\n";
-      INDENTATION++;
-      b_type->Dump();
-      cout << INDENT() << "IDENT: " << ident << "\n";
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("FuncFParamAST");
+      b_type->Dump(w);
+      w.leaf("IDENT", ident);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -1006,13 +946,11 @@ class FuncRParamsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> exp;
     unique_ptr<BaseAST> comma_exps;
-    void Dump() const override {
-      cout << INDENT() << "FuncRParamsAST {\n";
-      INDENTATION++;
-      exp->Dump();
-      comma_exps->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("FuncRParamsAST");
+      exp->Dump(w);
+      comma_exps->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -1023,9 +961,9 @@ class CommaExpsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> exp;
     unique_ptr<BaseAST> comma_exps;
-    void Dump() const override {
-      exp->Dump();
-      comma_exps->Dump();
+    void Dump(AstWriter& w) const override {
+      exp->Dump(w);
+      comma_exps->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -1036,13 +974,11 @@ class DeclOrFuncDefsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> decl_or_func_def;
     unique_ptr<BaseAST> decl_or_func_defs;
-    void Dump() const override {
-      cout << INDENT() << "DeclOrFuncDefsAST {\n";
-      INDENTATION++;
-      decl_or_func_def->Dump();
-      decl_or_func_defs->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("DeclOrFuncDefsAST");
+      decl_or_func_def->Dump(w);
+      decl_or_func_defs->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       decl_or_func_def->toIr(filename);
@@ -1054,12 +990,10 @@ class DeclOrFuncDefsAST : public BaseAST {
 class DeclOrFuncDefAST : public BaseAST {
   public:
     unique_ptr<BaseAST> decl_or_func_def;
-    void Dump() const override {
-      cout << INDENT() << "DeclOrFuncDefAST {\n";
-      INDENTATION++;
-      decl_or_func_def->Dump();
-      INDENTATION--;
-      cout << INDENT() << "}\n";
+    void Dump(AstWriter& w) const override {
+      w.begin("DeclOrFuncDefAST");
+      decl_or_func_def->Dump(w);
+      w.end();
     }
     IrRet toIr(string filename) const override {
       return decl_or_func_def->toIr(filename);
@@ -1070,9 +1004,9 @@ class CommaConstExpsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> const_exp;
     unique_ptr<BaseAST> comma_const_exps;
-    void Dump() const override {
-      const_exp->Dump();
-      comma_const_exps->Dump();
+    void Dump(AstWriter& w) const override {
+      const_exp->Dump(w);
+      comma_const_exps->Dump(w);
     }
     IrRet toIr(string filename) const override {
       const_exp->toIr(filename);
@@ -1085,9 +1019,9 @@ class BracketConstExpsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> const_exp;
     unique_ptr<BaseAST> bracket_const_exps;
-    void Dump() const override {
-      const_exp->Dump();
-      bracket_const_exps->Dump();
+    void Dump(AstWriter& w) const override {
+      const_exp->Dump(w);
+      bracket_const_exps->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -1098,9 +1032,9 @@ class BracketExpsAST : public BaseAST {
   public:
     unique_ptr<BaseAST> exp;
     unique_ptr<BaseAST> bracket_exps;
-    void Dump() const override {
-      exp->Dump();
-      bracket_exps->Dump();
+    void Dump(AstWriter& w) const override {
+      exp->Dump(w);
+      bracket_exps->Dump(w);
     }
     IrRet toIr(string filename) const override {
       return IrRet(IrRet::tag::None, -1);
@@ -0,0 +1,31 @@
+#include "optimize.h"
+
+#include <cstdlib>
+#include <iostream>
+#include "config.h"
+#include "pass_manager.h"
+
+namespace ir {
+void optimize(IRList& irs) {
+  PassManager pm;
+  if (config::passes.empty()) {
+    pm.addPreset(config::opt_level);
+  } else {
+    size_t pos = 0;
+    auto& list = config::passes;
+    while (pos <= list.size()) {
+      size_t comma = list.find(',', pos);
+      if (comma == string::npos) comma = list.size();
+      string name = list.substr(pos, comma - pos);
+      pos = comma + 1;
+      if (name.empty() || pm.add(name)) continue;
+      cerr << "unknown pass '" << name << "', available:";
+      for (auto& known : PassManager::passNames()) cerr << " " << known;
+      cerr << endl;
+      exit(1);
+    }
+  }
+  pm.run(irs);
+  if (config::pass_report) pm.report(cerr);
+}
+}  // namespace ir
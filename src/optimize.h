@@ -0,0 +1,18 @@
+#pragma once
+#include "ir.h"
+#include "loop.h"
+#include "purity.h"
+
+namespace ir {
+    // runs the pipeline picked by -O / --passes= (see pass_manager.h)
+    void optimize(IRList& irs);
+    // passes
+    void block_layout(IRList& irs);
+    void dead_code_elim(IRList& irs, const PurityInfo& purity);
+    void licm(IRList& irs, const PurityInfo& purity);
+    void load_store_elim(IRList& irs, const PurityInfo& purity);
+    void local_cse(IRList& irs, const PurityInfo& purity);
+    void loop_unroll(IRList& irs, const UnrollOptions& options = UnrollOptions());
+    void loop_vectorize(IRList& irs);
+    void memoize(IRList& irs, const PurityInfo& purity);
+}  // namespace ir
@@ -0,0 +1,244 @@
+#include "pass_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <unistd.h>
+#include "cfg.h"
+#include "config.h"
+#include "context.h"
+#include "optimize.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+namespace ir {
+namespace {
+// Passes that only move, merge or delete code leave the effect of every
+// function as it was or make it smaller, so the cached purity stays a safe
+// over-approximation. memoize adds global stores and must drop it.
+const vector<Pass>& registry() {
+  static const vector<Pass> passes = {
+      {"licm", [](IRList& irs, AnalysisManager& am) { licm(irs, am.purity()); },
+       ALL_ANALYSES, PassScope::Function},
+      {"local_cse",
+       [](IRList& irs, AnalysisManager& am) { local_cse(irs, am.purity()); },
+       ALL_ANALYSES, PassScope::Function},
+      {"loop_vectorize",
+       [](IRList& irs, AnalysisManager&) { loop_vectorize(irs); }, ALL_ANALYSES,
+       PassScope::Function},
+      {"loop_unroll", [](IRList& irs, AnalysisManager&) { loop_unroll(irs); },
+       ALL_ANALYSES, PassScope::Function},
+      {"load_store_elim",
+       [](IRList& irs, AnalysisManager& am) {
+         load_store_elim(irs, am.purity());
+       },
+       ALL_ANALYSES, PassScope::Function},
+      {"dead_code_elim",
+       [](IRList& irs, AnalysisManager& am) {
+         dead_code_elim(irs, am.purity());
+       },
+       ALL_ANALYSES, PassScope::Function},
+      {"memoize",
+       [](IRList& irs, AnalysisManager& am) { memoize(irs, am.purity()); },
+       ALL_ANALYSES & ~PURITY, PassScope::Module},
+      {"block_layout", [](IRList& irs, AnalysisManager&) { block_layout(irs); },
+       ALL_ANALYSES, PassScope::Function},
+  };
+  return passes;
+}
+
+size_t countInsts(const IRList& irs) {
+  size_t n = 0;
+  for (auto& ir : irs) {
+    if (ir.op_code != OpCode::NOOP) n++;
+  }
+  return n;
+}
+}  // namespace
+
+long currentRssKb() {
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  long size = 0, resident = 0;
+  if (fscanf(f, "%ld %ld", &size, &resident) != 2) resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+const PurityInfo& AnalysisManager::purity() {
+  if (!purity_info) {
+    purity_info = make_unique<PurityInfo>(irs, context().external_effects);
+  }
+  return *purity_info;
+}
+
+void AnalysisManager::invalidate(unsigned preserved) {
+  if (!(preserved & PURITY)) purity_info.reset();
+}
+
+bool PassManager::add(const string& name) {
+  for (auto& pass : registry()) {
+    if (pass.name == name) {
+      passes.push_back(&pass);
+      return true;
+    }
+  }
+  return false;
+}
+
+void PassManager::addPreset(int level) {
+  if (level <= 0) return;
+  if (level >= 2) {
+    add("licm");
+    if (config::rvv) add("loop_vectorize");
+  }
+  add("local_cse");
+  if (level >= 2) add("loop_unroll");
+  add("load_store_elim");
+  add("dead_code_elim");
+  // memo tables make the function impure, so this goes after the passes
+  // that rely on its purity
+  if (config::memoize) add("memoize");
+  // only moves blocks, so it sees the code the others leave behind
+  if (level >= 2) add("block_layout");
+}
+
+void PassManager::run(IRList& irs) {
+  AnalysisManager am(irs);
+  size_t i = 0;
+  while (i < passes.size()) {
+    if (passes[i]->scope == PassScope::Module) {
+      runModulePass(irs, am, *passes[i]);
+      i++;
+      continue;
+    }
+    // a function pass that drops an analysis ends the run, so the next one
+    // sees it recomputed over the whole module
+    size_t j = i;
+    while (j < passes.size() && passes[j]->scope == PassScope::Function) {
+      if (passes[j++]->preserves != ALL_ANALYSES) break;
+    }
+    runFunctionPasses(irs, am, i, j);
+    i = j;
+  }
+}
+
+void PassManager::runModulePass(IRList& irs, AnalysisManager& am,
+                                const Pass& pass) {
+  PassStats st;
+  st.name = pass.name;
+  if (config::pass_report) {
+    st.insts_before = countInsts(irs);
+    st.rss_before_kb = currentRssKb();
+  }
+  auto start = chrono::steady_clock::now();
+  {
+    stats::ScopedPhase phase("opt:" + pass.name);
+    pass.run(irs, am);
+  }
+  auto stop = chrono::steady_clock::now();
+  am.invalidate(pass.preserves);
+  st.ms = chrono::duration<double, milli>(stop - start).count();
+  if (config::pass_report) {
+    st.insts_after = countInsts(irs);
+    st.rss_after_kb = currentRssKb();
+  }
+  pass_stats.push_back(st);
+}
+
+void PassManager::runFunctionPasses(IRList& irs, AnalysisManager& am,
+                                    size_t first, size_t last) {
+  // module analyses must see every function, so build them before splitting
+  am.purity();
+
+  // move each function into a list of its own, leaving a NOOP in its place
+  struct Piece {
+    IRList irs;
+    IRList::iterator slot;
+    vector<PassStats> stats;
+  };
+  auto funcs = splitFunctions(irs);
+  vector<Piece> pieces(funcs.size());
+  for (size_t k = 0; k < funcs.size(); k++) {
+    pieces[k].slot = irs.insert(funcs[k].begin, IR(OpCode::NOOP));
+    pieces[k].irs.splice(pieces[k].irs.end(), irs, funcs[k].begin, funcs[k].end);
+  }
+
+  auto& ctx = context();
+  auto work = [&](Piece& piece) {
+    CompilationContext::Scope scope(ctx);
+    for (size_t k = first; k < last; k++) {
+      auto& pass = *passes[k];
+      PassStats st;
+      st.insts_before = countInsts(piece.irs);
+      auto start = chrono::steady_clock::now();
+      {
+        stats::ScopedPhase phase("opt:" + pass.name);
+        pass.run(piece.irs, am);
+      }
+      auto stop = chrono::steady_clock::now();
+      st.ms = chrono::duration<double, milli>(stop - start).count();
+      st.insts_after = countInsts(piece.irs);
+      piece.stats.push_back(st);
+    }
+  };
+  if (ctx.jobs == 1 || pieces.size() <= 1) {
+    for (auto& piece : pieces) work(piece);
+  } else {
+    // biggest functions first, so a large one does not start last and leave
+    // the other threads idle while it finishes
+    vector<Piece*> order;
+    for (auto& piece : pieces) order.push_back(&piece);
+    stable_sort(order.begin(), order.end(), [](Piece* a, Piece* b) {
+      return a->irs.size() > b->irs.size();
+    });
+    int threads = ctx.jobs > 0 ? ctx.jobs : ThreadPool::hardwareThreads();
+    ThreadPool pool(min<int>(threads, pieces.size()));
+    for (auto piece : order) pool.submit([&work, piece] { work(*piece); });
+    pool.wait();
+  }
+
+  // put the functions back where they came from
+  for (auto& piece : pieces) {
+    irs.splice(piece.slot, piece.irs);
+    irs.erase(piece.slot);
+  }
+  size_t outside = countInsts(irs);
+  for (auto& piece : pieces) outside -= piece.stats.back().insts_after;
+  long rss = config::pass_report ? currentRssKb() : 0;
+  for (size_t k = first; k < last; k++) {
+    PassStats st{passes[k]->name, 0, outside, outside, rss, rss};
+    for (auto& piece : pieces) {
+      auto& ps = piece.stats[k - first];
+      st.ms += ps.ms;  // summed over threads, i.e. CPU time
+      st.insts_before += ps.insts_before;
+      st.insts_after += ps.insts_after;
+    }
+    pass_stats.push_back(st);
+    am.invalidate(passes[k]->preserves);
+  }
+}
+
+void PassManager::report(ostream& os) const {
+  os << left << setw(18) << "pass" << right << setw(10) << "ms"
+     << setw(10) << "insts" << setw(10) << "delta" << setw(12) << "rss(KB)"
+     << endl;
+  double total = 0;
+  for (auto& st : pass_stats) {
+    total += st.ms;
+    os << left << setw(18) << st.name << right << setw(10) << fixed
+       << setprecision(3) << st.ms << setw(10) << st.insts_after << setw(10)
+       << (long)st.insts_after - (long)st.insts_before << setw(12)
+       << st.rss_after_kb << endl;
+  }
+  os << left << setw(18) << "total" << right << setw(10) << fixed
+     << setprecision(3) << total << endl;
+}
+
+vector<string> PassManager::passNames() {
+  vector<string> names;
+  for (auto& pass : registry()) names.push_back(pass.name);
+  return names;
+}
+}  // namespace ir
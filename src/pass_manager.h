@@ -0,0 +1,77 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ir.h"
+#include "purity.h"
+
+using namespace std;
+namespace ir {
+    // module-level analyses a pass can keep valid, as bits of Pass::preserves
+    enum Analysis : unsigned {
+        PURITY = 1u << 0,
+        ALL_ANALYSES = ~0u,
+    };
+
+    // Computes analyses on first use and hands out the cached result until a
+    // pass that does not preserve them has run.
+    class AnalysisManager {
+        public:
+            AnalysisManager(IRList& irs) : irs(irs) {}
+            const PurityInfo& purity();
+            void invalidate(unsigned preserved);
+
+        private:
+            IRList& irs;
+            unique_ptr<PurityInfo> purity_info;
+    };
+
+    enum class PassScope {
+        Function,  // looks at one function at a time; may run in parallel
+        Module,    // sees the whole module; a sync point between parallel runs
+    };
+
+    struct Pass {
+        string name;
+        function<void(IRList&, AnalysisManager&)> run;
+        unsigned preserves;  // Analysis bits still valid after the pass
+        PassScope scope;
+    };
+
+    struct PassStats {
+        string name;
+        double ms;
+        size_t insts_before, insts_after;
+        long rss_before_kb, rss_after_kb;
+    };
+
+    // Consecutive function passes run back to back on each function, with
+    // the functions spread over context().jobs threads. Module analyses are
+    // computed before the functions are split off, and the functions are put
+    // back in source order, so the result does not depend on the thread count.
+    class PassManager {
+        public:
+            // returns false if there is no pass with this name
+            bool add(const string& name);
+            // the pipeline for -O<level>
+            void addPreset(int level);
+            void run(IRList& irs);
+            const vector<PassStats>& stats() const { return pass_stats; }
+            void report(ostream& os) const;
+            static vector<string> passNames();
+
+        private:
+            vector<const Pass*> passes;
+            vector<PassStats> pass_stats;
+
+            void runModulePass(IRList& irs, AnalysisManager& am, const Pass& pass);
+            // passes[first, last) are all function passes
+            void runFunctionPasses(IRList& irs, AnalysisManager& am,
+                                   size_t first, size_t last);
+    };
+
+    // resident set size of this process, 0 where /proc is not available
+    long currentRssKb();
+}  // namespace ir
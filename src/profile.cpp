@@ -0,0 +1,189 @@
+#include "profile.h"
+
+#include <fstream>
+#include <sstream>
+#include "cfg.h"
+
+namespace profile {
+using namespace ir;
+
+const char* const COUNTERS = "@__profile_counters";
+
+namespace {
+const char* const MAGIC = "sysy-profile 1";
+
+void increment(IRList& irs, IRList::iterator pos, int counter) {
+  OpName t("%_prof"), base(COUNTERS), offset(counter * 4);
+  irs.insert(pos, IR(OpCode::LOAD, t, base, offset));
+  irs.insert(pos, IR(OpCode::ADD, t, t, OpName(1)));
+  irs.insert(pos, IR(OpCode::STORE, OpName(), base, offset, t));
+}
+}  // namespace
+
+uint64_t FunctionCounts::block(const std::string& label) const {
+  auto it = blocks.find(label);
+  return it == blocks.end() ? 0 : it->second;
+}
+
+bool FunctionCounts::find(const std::string& label, uint64_t& n) const {
+  for (size_t len = label.size(); len != std::string::npos && len > 0;
+       len = label.rfind('_', len - 1)) {
+    auto it = blocks.find(label.substr(0, len));
+    if (it != blocks.end()) {
+      n = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t FunctionCounts::edge(const std::string& from, const std::string& to) const {
+  auto it = edges.find({from, to});
+  return it == edges.end() ? 0 : it->second;
+}
+
+const FunctionCounts* Profile::function(const std::string& name) const {
+  auto it = functions.find(name);
+  return it == functions.end() ? nullptr : &it->second;
+}
+
+void Profile::merge(const Profile& other) {
+  for (auto& [name, theirs] : other.functions) {
+    auto& ours = functions[name];
+    ours.entry += theirs.entry;
+    for (auto& [label, n] : theirs.blocks) ours.blocks[label] += n;
+    for (auto& [edge, n] : theirs.edges) ours.edges[edge] += n;
+  }
+}
+
+bool Profile::load(const std::string& path, std::string& error) {
+  std::ifstream ifs(path);
+  if (!ifs) {
+    error = "cannot open";
+    return false;
+  }
+  std::string line;
+  if (!std::getline(ifs, line) || line != MAGIC) {
+    error = "not a profile";
+    return false;
+  }
+  FunctionCounts* fn = nullptr;
+  for (int line_no = 2; std::getline(ifs, line); line_no++) {
+    std::istringstream iss(line);
+    std::string kind, a, b;
+    uint64_t n;
+    bool ok;
+    iss >> kind;
+    if (kind == "function") {
+      ok = bool(iss >> a >> n);
+      if (ok) {
+        fn = &functions[a];
+        fn->entry += n;
+      }
+    } else if (kind == "block") {
+      ok = fn && (iss >> a >> n);
+      if (ok) fn->blocks[a] += n;
+    } else if (kind == "edge") {
+      ok = fn && (iss >> a >> b >> n);
+      if (ok) fn->edges[{a, b}] += n;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      error = "line " + std::to_string(line_no) + ": cannot parse '" + line + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Profile::save(const std::string& path) const {
+  std::ofstream ofs(path, std::ios::trunc);
+  ofs << MAGIC << "\n";
+  for (auto& [name, fn] : functions) {
+    ofs << "function " << name << " " << fn.entry << "\n";
+    for (auto& [label, n] : fn.blocks) ofs << "block " << label << " " << n << "\n";
+    for (auto& [edge, n] : fn.edges) {
+      ofs << "edge " << edge.first << " " << edge.second << " " << n << "\n";
+    }
+  }
+  return bool(ofs.flush());
+}
+
+void labelBlocks(IRList& irs) {
+  for (auto& func : splitFunctions(irs)) {
+    CFG cfg(func);
+    int n = 0;
+    for (auto& bb : cfg.blocks) {
+      if (bb.label.empty()) irs.insert(bb.begin, IR(OpCode::LABEL, "%_p" + std::to_string(n++)));
+    }
+  }
+}
+
+std::vector<Site> instrument(IRList& irs) {
+  std::vector<Site> sites;
+  int counters = 0;
+  for (auto& func : splitFunctions(irs)) {
+    CFG cfg(func);
+    auto& blocks = cfg.blocks;
+    std::vector<int> block_counter(blocks.size());
+    for (auto& bb : blocks) {
+      block_counter[bb.id] = counters++;
+      sites.push_back({func.name, bb.label, "", block_counter[bb.id]});
+    }
+    // taken edges of conditional jumps are split onto blocks of their own,
+    // placed after the last block
+    IRList edge_blocks;
+    int edges = 0;
+    for (auto& bb : blocks) {
+      auto last = std::prev(bb.end);
+      auto next = bb.id + 1 < (int)blocks.size() ? blocks[bb.id + 1].label : "";
+      if (last->op_code == OpCode::jm) {
+        sites.push_back({func.name, bb.label, last->label, block_counter[bb.id]});
+      } else if (isBranch(last->op_code)) {
+        int taken = counters++;
+        std::string split = "%_pe" + std::to_string(edges++);
+        sites.push_back({func.name, bb.label, last->label, taken});
+        if (!next.empty()) {
+          sites.push_back({func.name, bb.label, next, block_counter[bb.id], taken});
+        }
+        edge_blocks.push_back(IR(OpCode::LABEL, split));
+        increment(edge_blocks, edge_blocks.end(), taken);
+        edge_blocks.push_back(IR(OpCode::jm, last->label));
+        last->label = split;
+      } else if (last->op_code != OpCode::RET && !next.empty()) {
+        sites.push_back({func.name, bb.label, next, block_counter[bb.id]});
+      }
+    }
+    for (auto& bb : blocks) increment(irs, std::next(bb.begin), block_counter[bb.id]);
+    if (!edge_blocks.empty()) {
+      auto end = std::prev(func.end);
+      // falling off the end returns; it must not fall into the edge blocks
+      if (!isTerminator(std::prev(end)->op_code)) irs.insert(end, IR(OpCode::RET));
+      irs.splice(end, edge_blocks);
+    }
+  }
+  irs.push_back(IR(OpCode::DATA_BEGIN, COUNTERS));
+  irs.push_back(IR(OpCode::DATA_SPACE, OpName(), OpName(counters * 4)));
+  irs.push_back(IR(OpCode::DATA_END));
+  return sites;
+}
+
+Profile collect(const std::vector<Site>& sites, const std::vector<int32_t>& counters) {
+  Profile profile;
+  auto value = [&](int k) { return k >= 0 && k < (int)counters.size() ? uint32_t(counters[k]) : 0u; };
+  for (auto& site : sites) {
+    auto [it, first] = profile.functions.emplace(site.function, FunctionCounts());
+    auto& fn = it->second;
+    uint64_t n = uint32_t(value(site.counter) - value(site.minus));
+    if (site.to.empty()) {
+      // a function's sites start with its entry block
+      if (first) fn.entry = n;
+      fn.blocks[site.from] += n;
+    } else {
+      fn.edges[{site.from, site.to}] += n;
+    }
+  }
+  return profile;
+}
+}  // namespace profile
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ir.h"
+
+// -fprofile-generate / -fprofile-use.
+//
+// The instrumented build counts, on the IR as lowered and before any pass,
+// how often every block runs and how often every conditional jump is taken;
+// -run or -jit executes it and the counts are added to a profile file. A
+// later -fprofile-use build of the same source lowers to the same IR, so
+// the counts can be looked up by function and block label, and a pass that
+// keeps labels can still find them after earlier passes have run.
+namespace profile {
+    // the global the counters live in, one 32-bit word each
+    extern const char* const COUNTERS;
+
+    struct FunctionCounts {
+        uint64_t entry = 0;                           // calls
+        std::map<std::string, uint64_t> blocks;       // label -> executions
+        std::map<std::pair<std::string, std::string>, uint64_t> edges;  // (from, to)
+
+        bool has(const std::string& label) const { return blocks.count(label); }
+        uint64_t block(const std::string& label) const;  // 0 if not profiled
+        // the count of a block, or of the block a pass copied it from (whose
+        // label it extends with "_..."); false if neither was profiled
+        bool find(const std::string& label, uint64_t& n) const;
+        uint64_t edge(const std::string& from, const std::string& to) const;
+    };
+
+    class Profile {
+        public:
+            std::map<std::string, FunctionCounts> functions;  // name without '@'
+
+            // nullptr if the function was never profiled
+            const FunctionCounts* function(const std::string& name) const;
+            void merge(const Profile& other);
+            bool load(const std::string& path, std::string& error);
+            bool save(const std::string& path) const;
+    };
+
+    // Gives every basic block a label (%_p<N>), so that counts can be keyed
+    // by label. Deterministic: both -fprofile-generate and -fprofile-use run
+    // it on the freshly lowered IR.
+    void labelBlocks(ir::IRList& irs);
+
+    // A count to read back: counters[counter] - counters[minus], minus -1
+    // for none. `to` is empty for a block count, else the edge's target.
+    struct Site {
+        std::string function, from, to;
+        int counter;
+        int minus = -1;
+    };
+
+    // Adds a counter to every block and to every conditional jump (whose
+    // taken edge gets a block of its own at the end of the function), and
+    // the COUNTERS global. Runs after labelBlocks.
+    std::vector<Site> instrument(ir::IRList& irs);
+
+    // The profile of one run, from the words of COUNTERS. Counters are 32
+    // bits and wrap; each run's counts are read as unsigned.
+    Profile collect(const std::vector<Site>& sites, const std::vector<int32_t>& counters);
+}  // namespace profile
@@ -0,0 +1,110 @@
+#include "purity.h"
+
+#include <algorithm>
+#include "alias.h"
+
+namespace ir {
+string calleeName(const IR& call) {
+  auto& label = call.label;
+  return !label.empty() && label[0] == '@' ? label.substr(1) : label;
+}
+
+vector<IRList::iterator> callSequence(IRList::iterator call,
+                                      IRList::iterator func_begin) {
+  vector<IRList::iterator> seq{call};
+  auto it = call;
+  while (it != func_begin && std::prev(it)->op_code == OpCode::SET_ARG) {
+    it--;
+    seq.push_back(it);
+  }
+  std::reverse(seq.begin(), seq.end());
+  return seq;
+}
+
+vector<string> functionParams(const IR& func_begin) {
+  vector<string> params;
+  auto& label = func_begin.label;
+  auto open = label.find('('), close = label.find(')');
+  if (open == string::npos || close == string::npos) return params;
+  string list = label.substr(open + 1, close - open - 1);
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t comma = list.find(',', pos);
+    if (comma == string::npos) comma = list.size();
+    string param = list.substr(pos, comma - pos);
+    pos = comma + 1;
+    auto colon = param.find(':');
+    if (colon != string::npos) param = param.substr(0, colon);
+    param.erase(0, param.find_first_not_of(' '));
+    param.erase(param.find_last_not_of(' ') + 1);
+    if (!param.empty()) params.push_back(param);
+  }
+  return params;
+}
+
+PurityInfo::PurityInfo(IRList& irs, const map<string, FuncEffect>& known)
+    : effects(known) {
+  auto funcs = splitFunctions(irs);
+  map<string, FuncEffect> local;
+  for (auto& func : funcs) {
+    AliasAnalysis aa(func);
+    FuncEffect eff = FuncEffect::Pure;
+    auto& calls = callees[func.name];
+    for (auto it = func.begin; it != func.end; it++) {
+      switch (it->op_code) {
+        case OpCode::STORE:
+        case OpCode::VSTORE:
+          if (!aa.isStackArray(it->op1)) eff = FuncEffect::SideEffect;
+          break;
+        case OpCode::LOAD:
+        case OpCode::VLOAD:
+          if (!aa.isStackArray(it->op1)) eff = std::max(eff, FuncEffect::ReadOnly);
+          break;
+        case OpCode::call:
+          calls.insert(calleeName(*it));
+          break;
+        default:
+          break;
+      }
+    }
+    local[func.name] = eff;
+    effects[func.name] = eff;
+  }
+
+  // propagate callee effects until nothing changes; recursion starts out
+  // optimistic, so a self-recursive function with no effects stays pure
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& [name, calls] : callees) {
+      FuncEffect eff = local[name];
+      for (auto& callee : calls) eff = std::max(eff, effect(callee));
+      if (eff != effects[name]) {
+        effects[name] = eff;
+        changed = true;
+      }
+    }
+  }
+}
+
+FuncEffect PurityInfo::effect(const string& func) const {
+  auto it = effects.find(!func.empty() && func[0] == '@' ? func.substr(1) : func);
+  return it == effects.end() ? FuncEffect::SideEffect : it->second;
+}
+
+bool PurityInfo::isPureCall(const IR& call) const {
+  return call.op_code == OpCode::call &&
+         effect(calleeName(call)) == FuncEffect::Pure;
+}
+
+bool PurityInfo::isReadOnlyCall(const IR& call) const {
+  return call.op_code == OpCode::call &&
+         effect(calleeName(call)) != FuncEffect::SideEffect;
+}
+
+bool PurityInfo::isRecursive(const string& func) const {
+  auto it = callees.find(func);
+  return it != callees.end() && it->second.count(func);
+}
+
+}  // namespace ir
@@ -0,0 +1,42 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "cfg.h"
+#include "ir.h"
+
+using namespace std;
+namespace ir {
+    enum class FuncEffect {
+        Pure,        // result depends only on the arguments
+        ReadOnly,    // may read globals or memory behind pointer arguments
+        SideEffect,  // may write memory visible to the caller, or do I/O
+    };
+
+    // Interprocedural effect analysis over the call graph. Functions that are
+    // only declared (the runtime library from IR_DUMP::writeLibFuncs) are
+    // assumed to have side effects.
+    class PurityInfo {
+        public:
+            map<string, set<string>> callees;  // call graph, names without '@'
+            // known: effects of functions defined elsewhere, e.g. the ones
+            // --incremental took from the cache instead of lowering
+            PurityInfo(IRList& irs, const map<string, FuncEffect>& known = {});
+            FuncEffect effect(const string& func) const;
+            // calls to these can be CSE'd, hoisted and deleted like arithmetic
+            bool isPureCall(const IR& call) const;
+            bool isReadOnlyCall(const IR& call) const;
+            bool isRecursive(const string& func) const;
+
+        private:
+            map<string, FuncEffect> effects;
+    };
+
+    string calleeName(const IR& call);
+    // the call together with the SET_ARGs that feed it, in order
+    vector<IRList::iterator> callSequence(IRList::iterator call,
+                                          IRList::iterator func_begin);
+    // parameter names parsed from the FUNCTION_BEGIN label
+    vector<string> functionParams(const IR& func_begin);
+}  // namespace ir
@@ -0,0 +1,79 @@
+#include "runtime.h"
+
+#include <pthread.h>
+#include <chrono>
+#include <cstdio>
+
+namespace runtime {
+namespace {
+const char* const NAMES[BUILTIN_COUNT] = {
+    "getint", "getch", "getarray", "putint",
+    "putch", "putarray", "starttime", "stoptime",
+};
+
+using Clock = std::chrono::steady_clock;
+Clock::time_point timer_start;
+Clock::duration timer_total{};
+int timers = 0;
+
+void* callFunction(void* f) {
+  (*static_cast<const std::function<void()>*>(f))();
+  return nullptr;
+}
+}  // namespace
+
+int find(const std::string& name) {
+  for (int k = 0; k < BUILTIN_COUNT; k++) {
+    if (name == NAMES[k]) return k;
+  }
+  return -1;
+}
+
+int32_t getint() {
+  int v = 0;
+  if (scanf("%d", &v) != 1) v = 0;
+  return v;
+}
+
+int32_t getch() { return getchar(); }
+
+void putint(int32_t v) { printf("%d", v); }
+
+void putch(int32_t c) { putchar(c); }
+
+void putarray(int32_t n, const int32_t* a) {
+  printf("%d:", n);
+  for (int32_t i = 0; i < n; i++) printf(" %d", a[i]);
+  putchar('\n');
+}
+
+void starttime() { timer_start = Clock::now(); }
+
+void stoptime() {
+  timer_total += Clock::now() - timer_start;
+  timers++;
+}
+
+void reportTimers() {
+  if (timers == 0) return;
+  long long us =
+      std::chrono::duration_cast<std::chrono::microseconds>(timer_total).count();
+  fprintf(stderr, "TOTAL: %lldH-%lldM-%lldS-%lldus\n", us / 3600000000,
+          us / 60000000 % 60, us / 1000000 % 60, us % 1000000);
+}
+
+void runWithStack(size_t stack_bytes, const std::function<void()>& f) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, stack_bytes);
+  pthread_t thread;
+  bool started = pthread_create(&thread, &attr, callFunction,
+                                const_cast<std::function<void()>*>(&f)) == 0;
+  pthread_attr_destroy(&attr);
+  if (started) {
+    pthread_join(thread, nullptr);
+  } else {
+    f();
+  }
+}
+}  // namespace runtime
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// The SysY runtime library (the functions IR_DUMP::writeLibFuncs declares)
+// for the programs -run and -jit execute in this process. Input is stdin,
+// output stdout; arrays are passed as host pointers, bounds already checked.
+namespace runtime {
+    enum Builtin {
+        GETINT, GETCH, GETARRAY, PUTINT, PUTCH, PUTARRAY, STARTTIME, STOPTIME,
+        BUILTIN_COUNT,
+    };
+    // the Builtin for a function name without '@', or -1
+    int find(const std::string& name);
+
+    int32_t getint();
+    int32_t getch();
+    void putint(int32_t v);
+    void putch(int32_t c);
+    void putarray(int32_t n, const int32_t* a);
+    void starttime();
+    void stoptime();
+    // "TOTAL: ..H-..M-..S-..us" on stderr, as the SysY library prints at
+    // exit; nothing if the program never called stoptime
+    void reportTimers();
+
+    // Runs f on a thread with a stack of stack_bytes and waits for it, for
+    // executors whose stack depth follows the program's call depth. Runs f
+    // on this thread if no such thread can be made.
+    void runWithStack(size_t stack_bytes, const std::function<void()>& f);
+}  // namespace runtime
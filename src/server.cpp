@@ -0,0 +1,200 @@
+#include "server.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "cache.h"
+#include "config.h"
+#include "ir.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace server {
+namespace {
+const uint32_t MAX_FRAME = 256u << 20;
+// a client that neither sends nor reads for this long is dropped, so it
+// cannot hold on to a pool thread
+const int IO_TIMEOUT_SECONDS = 10;
+
+bool writeAll(int fd, const void* data, size_t n) {
+  auto p = static_cast<const char*>(data);
+  while (n > 0) {
+    ssize_t k = write(fd, p, n);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0) return false;
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool readAll(int fd, void* data, size_t n) {
+  auto p = static_cast<char*>(data);
+  while (n > 0) {
+    ssize_t k = read(fd, p, n);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0) return false;
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool sendFrame(int fd, const string& s) {
+  uint32_t n = s.size();
+  return writeAll(fd, &n, sizeof(n)) && writeAll(fd, s.data(), n);
+}
+
+bool recvFrame(int fd, string& s) {
+  uint32_t n;
+  if (!readAll(fd, &n, sizeof(n)) || n > MAX_FRAME) return false;
+  s.resize(n);
+  return readAll(fd, &s[0], n);
+}
+
+bool makeAddress(const string& path, sockaddr_un& addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    cerr << path << ": socket path too long" << endl;
+    return false;
+  }
+  strcpy(addr.sun_path, path.c_str());
+  return true;
+}
+
+int connectTo(const string& path) {
+  sockaddr_un addr;
+  if (!makeAddress(path, addr)) return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Options that change the output, which client and server must agree on:
+// the ones in the cache key plus those deciding which files are written.
+string compileOptions() {
+  return cache::optionKey() + ";save-ir=" + to_string(config::save_ir) +
+         ";incremental=" + to_string(config::incremental) +
+         ";cache-dir=" + config::cache_dir;
+}
+
+bool recvRequest(int fd, driver::Unit& unit, string& options) {
+  return recvFrame(fd, unit.mode) && recvFrame(fd, unit.input) &&
+         recvFrame(fd, unit.output) && recvFrame(fd, unit.source) &&
+         recvFrame(fd, options);
+}
+
+// Reads, compiles and answers one request, on a pool thread. Returns true
+// for quit.
+bool handle(int fd) {
+  driver::Unit unit;
+  string options;
+  if (!recvRequest(fd, unit, options)) return false;
+  if (unit.mode == "quit") {
+    sendFrame(fd, "ok") && sendFrame(fd, "");
+    return true;
+  }
+  if (options != compileOptions()) {
+    sendFrame(fd, "error: the server was started with other options (" +
+                      compileOptions() + "), not " + options) &&
+        sendFrame(fd, "");
+    return false;
+  }
+  ostringstream diagnostics;
+  bool ok = driver::compileUnit(unit, 1, diagnostics);
+  sendFrame(fd, ok ? "ok" : "error: " + unit.input + " failed to compile") &&
+      sendFrame(fd, diagnostics.str());
+  return false;
+}
+}  // namespace
+
+int serve(const string& socket_path) {
+  signal(SIGPIPE, SIG_IGN);
+  sockaddr_un addr;
+  if (!makeAddress(socket_path, addr)) return 1;
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path.c_str());
+  if (listen_fd < 0 ||
+      bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(listen_fd, 64) < 0) {
+    cerr << socket_path << ": " << strerror(errno) << endl;
+    return 1;
+  }
+  // initialized on first use; done now so the first request does not wait
+  ir::IR_DUMP::libFuncDecls();
+  cerr << "server: listening on " << socket_path << endl;
+
+  // This thread only accepts. Reading requests and compiling happen on the
+  // pool, so a slow client holds up no one else, and every unit has its own
+  // context to run in parallel. quit shuts the listening socket down, which
+  // makes accept return.
+  ThreadPool pool(config::jobs);
+  atomic<bool> quitting{false};
+  for (;;) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (quitting) break;
+      if (errno == EINTR) continue;
+      cerr << "server: accept: " << strerror(errno) << endl;
+      break;
+    }
+    timeval timeout{IO_TIMEOUT_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    pool.submit([fd, listen_fd, &quitting] {
+      bool quit = handle(fd);
+      close(fd);
+      if (quit && !quitting.exchange(true)) shutdown(listen_fd, SHUT_RDWR);
+    });
+  }
+  pool.wait();
+  if (config::cache_stats && cache::enabled()) cache::report(cerr);
+  close(listen_fd);
+  unlink(socket_path.c_str());
+  return 0;
+}
+
+bool forward(const string& socket_path, const driver::Unit& unit, bool& ok) {
+  // a server that goes away mid-request raises SIGPIPE on write; an error
+  // from write is enough
+  signal(SIGPIPE, SIG_IGN);
+  int fd = connectTo(socket_path);
+  if (fd < 0) return false;
+  // the server has its own working directory, so paths go over absolute
+  auto absolute = [](const string& path) {
+    return path.empty() ? path : std::filesystem::absolute(path).string();
+  };
+  string input = unit.source.empty() ? absolute(unit.input) : unit.input;
+  string output = absolute(unit.output);
+  string reply, diagnostics;
+  bool sent = sendFrame(fd, unit.mode) && sendFrame(fd, input) &&
+              sendFrame(fd, output) && sendFrame(fd, unit.source) &&
+              sendFrame(fd, compileOptions()) && recvFrame(fd, reply) &&
+              recvFrame(fd, diagnostics);
+  close(fd);
+  if (!sent) return false;
+  cerr << diagnostics;
+  ok = reply == "ok";
+  if (!ok) cerr << reply << endl;
+  return true;
+}
+
+bool stop(const string& socket_path) {
+  bool ok;
+  return forward(socket_path, {"quit", "", "", ""}, ok) && ok;
+}
+}  // namespace server
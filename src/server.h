@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include "driver.h"
+
+// --server: a resident process that takes compile requests on a Unix socket,
+// saving the cost of starting a process per file. Compile options (-O,
+// --passes= and so on) are the ones the server was started with; the client
+// sends its own with each request, and the server refuses to compile when
+// they differ.
+//
+// Protocol: each message is a sequence of frames, a frame being a 4-byte
+// length (native byte order) followed by the content.
+//   request: mode, input, output, source (may be empty, then the server
+//            reads input itself), the options that change the output
+//   reply:   "ok" or "error: <reason>", then the compile's errors and
+//            warnings (may be empty)
+// A request with mode "quit" stops the server.
+namespace server {
+    // runs until a quit request, returns the process exit code
+    int serve(const std::string& socket_path);
+
+    // Sends the unit to the server to compile. Returns false if the server
+    // cannot be reached; otherwise ok says whether the compile succeeded, and
+    // the errors the server sends back go to stderr.
+    bool forward(const std::string& socket_path, const driver::Unit& unit,
+                 bool& ok);
+    bool stop(const std::string& socket_path);
+}  // namespace server
@@ -0,0 +1,55 @@
+#include "source_buffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::~SourceBuffer() {
+  if (mapped) munmap(base, mapped);
+}
+
+bool SourceBuffer::map(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  size_t file_size = st.st_size;
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t length = (file_size + 2 + page - 1) / page * page;
+  // reserve anonymous zeroed memory first, then map the file over its start:
+  // when the file is a whole number of pages, the trailing '\0's fall in the
+  // anonymous page instead of past the end of the file (which would SIGBUS)
+  void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  if (file_size > 0 &&
+      mmap(p, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+           0) == MAP_FAILED) {
+    munmap(p, length);
+    close(fd);
+    return false;
+  }
+  close(fd);
+  madvise(p, length, MADV_SEQUENTIAL);
+  if (mapped) munmap(base, mapped);
+  base = static_cast<char*>(p);
+  size = file_size;
+  mapped = length;
+  return true;
+}
+
+void SourceBuffer::assign(const std::string& text) {
+  if (mapped) munmap(base, mapped);
+  mapped = 0;
+  owned = text;
+  owned.append(2, '\0');
+  base = owned.data();
+  size = text.size();
+}
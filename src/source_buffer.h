@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// The source handed to the lexer. Files are mmap'd and scanned in place, with
+// no stdio or Flex read buffer in between; two '\0's always follow the text,
+// as yy_scan_buffer requires. The mapping is MAP_PRIVATE and writable: Flex
+// briefly writes a '\0' after each token while scanning.
+class SourceBuffer {
+  public:
+    SourceBuffer() = default;
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    // false on failure, with the reason in errno
+    bool map(const std::string& path);
+    // copies source already in memory (a server request) and adds the '\0's
+    void assign(const std::string& text);
+
+    std::string_view text() const { return {base, size}; }
+    // the buffer for yy_scan_buffer, its size including the two '\0's
+    char* scanBase() { return base; }
+    size_t scanSize() const { return size + 2; }
+
+  private:
+    char* base = nullptr;
+    size_t size = 0;
+    size_t mapped = 0;  // length of the mmap, 0 when owned is used
+    std::string owned;
+};
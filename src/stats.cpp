@@ -0,0 +1,119 @@
+#include "stats.h"
+
+#include <iomanip>
+#include <mutex>
+#include <sys/resource.h>
+#include <vector>
+#include "config.h"
+
+namespace stats {
+namespace {
+struct Phase {
+  std::string name;
+  int count = 0;  // times the phase was entered, e.g. tokens for lex
+  double ms = 0;
+  uint64_t allocs = 0, bytes = 0;
+};
+
+std::mutex phases_mutex;
+std::vector<Phase> phases;  // in order of first completion
+thread_local ScopedPhase* current = nullptr;
+
+void add(const std::string& name, double ms, uint64_t allocs, uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  for (auto& p : phases) {
+    if (p.name == name) {
+      p.count++;
+      p.ms += ms;
+      p.allocs += allocs;
+      p.bytes += bytes;
+      return;
+    }
+  }
+  phases.push_back({name, 1, ms, allocs, bytes});
+}
+
+void writeJson(std::ostream& os) {
+  double total = 0;
+  os << "{\"phases\":[";
+  for (size_t i = 0; i < phases.size(); i++) {
+    auto& p = phases[i];
+    total += p.ms;
+    os << (i ? "," : "") << "{\"name\":\"" << p.name << "\",\"count\":"
+       << p.count << ",\"ms\":" << std::fixed << std::setprecision(3) << p.ms
+       << ",\"allocs\":" << p.allocs << ",\"bytes\":" << p.bytes << "}";
+  }
+  os << "],\"total_ms\":" << total << ",\"peak_rss_kb\":" << peakRssKb()
+     << ",\"allocs\":" << allocations() << ",\"bytes\":" << allocatedBytes()
+     << "}" << std::endl;
+}
+
+void writeText(std::ostream& os) {
+  bool time = config::time_report, mem = config::mem_report;
+  double total = 0;
+  for (auto& p : phases) total += p.ms;
+  os << std::left << std::setw(24) << "phase" << std::right;
+  if (time) os << std::setw(12) << "ms" << std::setw(8) << "%";
+  if (mem) os << std::setw(12) << "allocs" << std::setw(14) << "bytes";
+  os << std::endl;
+  for (auto& p : phases) {
+    os << std::left << std::setw(24) << p.name << std::right << std::fixed;
+    if (time) {
+      os << std::setw(12) << std::setprecision(3) << p.ms << std::setw(8)
+         << std::setprecision(1) << (total > 0 ? 100 * p.ms / total : 0);
+    }
+    if (mem) os << std::setw(12) << p.allocs << std::setw(14) << p.bytes;
+    os << std::endl;
+  }
+  if (time) {
+    os << std::left << std::setw(24) << "total" << std::right << std::setw(12)
+       << std::setprecision(3) << total << std::endl;
+  }
+  if (mem) {
+    os << "peak rss: " << peakRssKb() << " KB, allocations: " << allocations()
+       << " (" << allocatedBytes() << " bytes)" << std::endl;
+  }
+}
+}  // namespace
+
+long peakRssKb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return usage.ru_maxrss;  // KB on Linux
+}
+
+bool enabled() { return config::time_report || config::mem_report; }
+
+ScopedPhase::ScopedPhase(const std::string& name) : active(enabled()) {
+  if (!active) return;
+  this->name = name;
+  parent = current;
+  current = this;
+  allocs = threadAllocations();
+  bytes = threadAllocatedBytes();
+  start = std::chrono::steady_clock::now();
+}
+
+ScopedPhase::~ScopedPhase() {
+  if (!active) return;
+  auto stop = std::chrono::steady_clock::now();
+  double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+  uint64_t a = threadAllocations() - allocs, b = threadAllocatedBytes() - bytes;
+  current = parent;
+  if (parent) {
+    parent->child_ms += ms;
+    parent->child_allocs += a;
+    parent->child_bytes += b;
+  }
+  add(name, ms - child_ms, a - child_allocs, b - child_bytes);
+}
+
+void report(std::ostream& os) {
+  std::lock_guard<std::mutex> lock(phases_mutex);
+  if (config::report_json) {
+    writeJson(os);
+  } else {
+    writeText(os);
+  }
+}
+}  // namespace stats
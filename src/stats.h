@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// --time-report / --mem-report. Phases nest: a phase's time and allocations
+// exclude those of the phases opened inside it, so lex time does not show
+// up twice under parse. A phase counts the allocations of the thread that
+// opened it; the totals count every thread's.
+namespace stats {
+    // operator new / new[] in alloc_counter.cpp count every allocation here
+    // while --mem-report is on
+    uint64_t allocations();
+    uint64_t allocatedBytes();
+    // the calling thread's share
+    uint64_t threadAllocations();
+    uint64_t threadAllocatedBytes();
+    long peakRssKb();
+
+    bool enabled();
+
+    class ScopedPhase {
+        public:
+            explicit ScopedPhase(const std::string& name);
+            ~ScopedPhase();
+            ScopedPhase(const ScopedPhase&) = delete;
+            ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+        private:
+            bool active;
+            std::string name;
+            ScopedPhase* parent;
+            std::chrono::steady_clock::time_point start;
+            uint64_t allocs, bytes;
+            double child_ms = 0;
+            uint64_t child_allocs = 0, child_bytes = 0;
+    };
+
+    // text table, or JSON with config::report_json
+    void report(std::ostream& os);
+}  // namespace stats
@@ -4,6 +4,20 @@
   #include <iostream>
   #include <string>
   #include "node.h"
+
+  // lexer 是可重入的, 状态都在 scanner 里, 这里只需要它的类型
+  #ifndef YY_TYPEDEF_YY_SCANNER_T
+  #define YY_TYPEDEF_YY_SCANNER_T
+  typedef void *yyscan_t;
+  #endif
+
+  // IDENT 的值: 指向源码缓冲区 (见 source_buffer.h) 里的一段字符, lexer 不拷贝.
+  // 缓冲区在整个 parse 期间都有效, 要存进 AST 时再用 str() 拷出来
+  struct TokenText {
+    const char *data;
+    size_t size;
+    std::string str() const { return std::string(data, size); }
+  };
 }
 
 %{
@@ -11,37 +25,70 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include "config.h"
 #include "node.h"
+#include "stats.h"
 
-// 声明 lexer 函数和错误处理函数
-int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, string s);
-string structure = "";
+// --trace-reductions 时记录每次归约用到的产生式, 出错时一起输出
+#define TRACE(rule) \
+  do { \
+    if (config::trace_reductions) context().structure += "\n" rule; \
+  } while (0)
 
 using namespace std;
 
 %}
 
+// 这部分放在 YYSTYPE 的定义之后
+%code {
+// 声明 lexer 函数和错误处理函数. --lexer=hand 时用 lexer.cpp 里手写的
+// lexer::lex, 这时 scanner 也是它的
+int yylex(YYSTYPE *yylval, yyscan_t scanner);
+namespace lexer {
+int lex(YYSTYPE *yylval, yyscan_t scanner);
+}
+void yyerror(std::unique_ptr<BaseAST> &ast, yyscan_t scanner, const char *s);
+
+static int next_token(YYSTYPE *yylval, yyscan_t scanner) {
+  return config::hand_lexer ? lexer::lex(yylval, scanner)
+                            : yylex(yylval, scanner);
+}
+
+// --time-report 时把取 token 的时间单独记到 lex 阶段
+static int timed_yylex(YYSTYPE *yylval, yyscan_t scanner) {
+  if (!stats::enabled()) return next_token(yylval, scanner);
+  stats::ScopedPhase phase("lex");
+  return next_token(yylval, scanner);
+}
+#define yylex timed_yylex
+}
+
+// parser 和 lexer 都不用全局变量, 这样多个线程可以同时编译不同的文件
+%define api.pure full
+%lex-param { yyscan_t scanner }
+
 // 定义 parser 函数和错误处理函数的附加参数
 // 我们需要返回一个字符串作为 AST, 所以我们把附加参数定义成字符串的智能指针
 // 解析完成后, 我们要手动修改这个参数, 把它设置成解析得到的字符串
-%parse-param { std::unique_ptr<BaseAST> &ast }
+%parse-param { std::unique_ptr<BaseAST> &ast } { yyscan_t scanner }
 
 // yylval 的定义, 我们把它定义成了一个联合体 (union)
 // 因为 token 的值有的是字符串指针, 有的是整数
-// 之前我们在 lexer 中用到的 str_val 和 int_val 就是在这里被定义的
-// 至于为什么要用字符串指针而不直接用 string 或者 unique_ptr<string>?
+// 之前我们在 lexer 中用到的 text_val 和 int_val 就是在这里被定义的
+// 至于为什么不直接用 string 或者 unique_ptr<string>?
 // 请自行 STFW 在 union 里写一个带析构函数的类会出现什么情况
 %union {
-  std::string *str_val;
+  TokenText text_val;
   int int_val;
   BaseAST *ast_val;
 }
 
 // lexer 返回的所有 token 种类的声明
-// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 str_val 和 int_val
+// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 text_val 和 int_val
 %token VOID INT RETURN CONST IF ELSE WHILE BREAK CONTINUE
-%token <str_val> IDENT 
+// 两个字符的运算符, 以前拆成两个单字符 token, "< =" 中间有空格也能通过
+%token LE GE EQ NE AND OR
+%token <text_val> IDENT 
 %token <int_val> INT_CONST
 
 // 非终结符的类型定义
@@ -69,7 +116,7 @@ CompUnit
     auto ast = new CompUnitAST(); 
     ast->decl_or_func_def = unique_ptr<BaseAST>($1); 
     ast->decl_or_func_defs = unique_ptr<BaseAST>($2); 
-    $$ = ast; structure +="\nCompUnit: DeclOrFuncDef DeclOrFuncDefs"; 
+    $$ = ast; TRACE("CompUnit: DeclOrFuncDef DeclOrFuncDefs"); 
   }
   ;
 
@@ -81,20 +128,20 @@ FuncDef
   : FuncType IDENT '(' Null ')' Block {
     auto ast = new FuncDefAST();
     ast->func_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2.str();
     ast->func_f_params = unique_ptr<BaseAST>($4);
     ast->block = unique_ptr<BaseAST>($6);
     $$ = ast;
-    structure +="\nFuncDef: FuncType IDENT '(' Null ')' Block";
+    TRACE("FuncDef: FuncType IDENT '(' Null ')' Block");
   }
   | FuncType IDENT '(' FuncFParams ')' Block {
     auto ast = new FuncDefAST();
     ast->func_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2.str();
     ast->func_f_params = unique_ptr<BaseAST>($4);
     ast->block = unique_ptr<BaseAST>($6);
     $$ = ast;
-    structure +="\nFuncDef: FuncType IDENT '(' FuncFParams ')' Block";
+    TRACE("FuncDef: FuncType IDENT '(' FuncFParams ')' Block");
   }
   ;
 
@@ -103,13 +150,13 @@ FuncType
     auto ast = new FuncTypeAST();
     ast->type = "int";
     $$ = ast;
-    structure +="\nFuncType: INT";
+    TRACE("FuncType: INT");
   }
   | VOID {
     auto ast = new FuncTypeAST();
     ast->type = "void";
     $$ = ast;
-    structure +="\nFuncType: VOID";
+    TRACE("FuncType: VOID");
   }
   ;
 
@@ -118,7 +165,7 @@ Block
     auto ast = new BlockAST();
     ast->stmt_or_block_items = unique_ptr<BaseAST>($2);
     $$ = ast;
-    structure +="\nBlock: '{' Stmt '}'";
+    TRACE("Block: '{' Stmt '}'");
   }
   ;
 
@@ -131,7 +178,7 @@ Stmt
     ast->r_value_1 = unique_ptr<BaseAST>($3);
     ast->r_value_2 = unique_ptr<BaseAST>($4);
     $$ = ast;
-    structure +="\nStmt: RETURN Exp Null Null ';'";
+    TRACE("Stmt: RETURN Exp Null Null ';'");
   }
   // | LVal '=' Exp Null ';' {
   //   auto ast = new StmtAST();
@@ -141,7 +188,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($3);
   //   ast->r_value_2 = unique_ptr<BaseAST>($4);
   //   $$ = ast;
-  //   structure +="\nStmt: LVal '=' Exp Null ';'";
+  //   TRACE("Stmt: LVal '=' Exp Null ';'");
   // }
   // | Null Null Null ';' {
   //   auto ast = new StmtAST();
@@ -151,7 +198,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($2);
   //   ast->r_value_2 = unique_ptr<BaseAST>($3);
   //   $$ = ast;
-  //   structure +="\nStmt: Null Null Null ';'";
+  //   TRACE("Stmt: Null Null Null ';'");
   // }
   // | Exp Null Null ';' {
   //   auto ast = new StmtAST();
@@ -161,7 +208,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($2);
   //   ast->r_value_2 = unique_ptr<BaseAST>($3);
   //   $$ = ast;
-  //   structure +="\nStmt: Exp Null Null ';'";
+  //   TRACE("Stmt: Exp Null Null ';'");
   // }
   // | Block Null Null {
   //   auto ast = new StmtAST();
@@ -171,7 +218,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($2);
   //   ast->r_value_2 = unique_ptr<BaseAST>($3);
   //   $$ = ast;
-  //   structure +="\nStmt: Block Null Null";
+  //   TRACE("Stmt: Block Null Null");
   // }
   // | IF '(' Exp ')' Stmt Null {
   //   auto ast = new StmtAST();
@@ -181,7 +228,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($5);
   //   ast->r_value_2 = unique_ptr<BaseAST>($6);
   //   $$ = ast;
-  //   structure +="\nStmt: IF '(' Exp ')' Stmt Null";
+  //   TRACE("Stmt: IF '(' Exp ')' Stmt Null");
   // }
   // | IF '(' Exp ')' Stmt ELSE Stmt {
   //   auto ast = new StmtAST();
@@ -191,7 +238,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($5);
   //   ast->r_value_2 = unique_ptr<BaseAST>($7);
   //   $$ = ast;
-  //   structure +="\nStmt: IF '(' Exp ')' Stmt ELSE Stmt";
+  //   TRACE("Stmt: IF '(' Exp ')' Stmt ELSE Stmt");
   // }
   // | WHILE '(' Exp ')' Stmt Null {
   //   auto ast = new StmtAST();
@@ -201,7 +248,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($5);
   //   ast->r_value_2 = unique_ptr<BaseAST>($6);
   //   $$ = ast;
-  //   structure +="\nStmt: WHILE '(' Exp ')' Stmt Null";
+  //   TRACE("Stmt: WHILE '(' Exp ')' Stmt Null");
   // }
   // | BREAK Null Null Null ';' {
   //   auto ast = new StmtAST();
@@ -211,7 +258,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($3);
   //   ast->r_value_2 = unique_ptr<BaseAST>($4);
   //   $$ = ast;
-  //   structure +="\nStmt: BREAK Null Null Null ';'";
+  //   TRACE("Stmt: BREAK Null Null Null ';'");
   // }
   // | CONTINUE Null Null Null ';' {
   //   auto ast = new StmtAST();
@@ -221,7 +268,7 @@ Stmt
   //   ast->r_value_1 = unique_ptr<BaseAST>($3);
   //   ast->r_value_2 = unique_ptr<BaseAST>($4);
   //   $$ = ast;
-  //   structure +="\nStmt: CONTINUE Null Null Null ';'";
+  //   TRACE("Stmt: CONTINUE Null Null Null ';'");
   // }
   ;
 
@@ -231,7 +278,7 @@ Exp
     ast->exp = unique_ptr<BaseAST>($1);
     $$ = ast;
     ast->value = ast->exp->value;
-    structure +="\nExp: LOrExp";
+    TRACE("Exp: LOrExp");
   }
   ;
 
@@ -240,19 +287,19 @@ PrimaryExp
     auto ast = new PrimaryExpAST();
     ast->value = unique_ptr<BaseAST>($2);
     $$ = ast;
-    structure +="\nPrimaryExp: '(' Exp ')'";
+    TRACE("PrimaryExp: '(' Exp ')'");
   }
   | LVal {
     auto ast = new PrimaryExpAST();
     ast->value = unique_ptr<BaseAST>($1);
     $$ = ast;
-    structure +="\nPrimaryExp: LVal";
+    TRACE("PrimaryExp: LVal");
   }
   | Number {
     auto ast = new PrimaryExpAST();
     ast->value = unique_ptr<BaseAST>($1);
     $$ = ast;
-    structure +="\nPrimaryExp: Number";
+    TRACE("PrimaryExp: Number");
   }
   ;
 
@@ -265,7 +312,7 @@ UnaryExp
     ast->exp_or_op_2 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_or_op_2->value;
-    structure +="\nUnaryExp: Null PrimaryExp";
+    TRACE("UnaryExp: Null PrimaryExp");
   }
   | Null '+' UnaryExp {
     auto ast = new UnaryExpAST();
@@ -275,7 +322,7 @@ UnaryExp
     ast->exp_or_op_2 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_or_op_2->value;
-    structure +="\nUnaryExp: UnaryOp UnaryExp";
+    TRACE("UnaryExp: UnaryOp UnaryExp");
   }
   | Null '-' UnaryExp {
     auto ast = new UnaryExpAST();
@@ -285,7 +332,7 @@ UnaryExp
     ast->exp_or_op_2 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = -ast->exp_or_op_2->value;
-    structure +="\nUnaryExp: UnaryOp UnaryExp";
+    TRACE("UnaryExp: UnaryOp UnaryExp");
   }
   | Null '!' UnaryExp {
     auto ast = new UnaryExpAST();
@@ -295,23 +342,23 @@ UnaryExp
     ast->exp_or_op_2 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = !ast->exp_or_op_2->value;
-    structure +="\nUnaryExp: UnaryOp UnaryExp";
+    TRACE("UnaryExp: UnaryOp UnaryExp");
   }
   // | IDENT '(' Null ')' Null {
   //   auto ast = new UnaryExpAST();
-  //   ast->ident = *unique_ptr<string>($1);
+  //   ast->ident = $1.str();
   //   ast->exp_or_op_or_params_1 = unique_ptr<BaseAST>($3);
   //   ast->exp_or_op_2 = unique_ptr<BaseAST>($5);
   //   $$ = ast;
-  //   structure +="\nUnaryExp: IDENT '(' Null ')' Null";
+  //   TRACE("UnaryExp: IDENT '(' Null ')' Null");
   // }
   // | IDENT '(' FuncRParams ')' Null {
   //   auto ast = new UnaryExpAST();
-  //   ast->ident = *unique_ptr<string>($1);
+  //   ast->ident = $1.str();
   //   ast->exp_or_op_or_params_1 = unique_ptr<BaseAST>($3);
   //   ast->exp_or_op_2 = unique_ptr<BaseAST>($5);
   //   $$ = ast;
-  //   structure +="\nUnaryExp: IDENT '(' FuncRParams ')' Null";
+  //   TRACE("UnaryExp: IDENT '(' FuncRParams ')' Null");
   // }
   ;
 
@@ -323,7 +370,7 @@ AddExp
     ast->exp_3 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_3->value;
-    structure +="\nAddExp: Null Null MulExp";
+    TRACE("AddExp: Null Null MulExp");
   }
   | AddExp '-' MulExp {
     auto ast = new AddExpAST();
@@ -333,7 +380,7 @@ AddExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value - ast->exp_3->value;
-    structure +="\nAddExp: AddExp AddOp MulExp";
+    TRACE("AddExp: AddExp AddOp MulExp");
   }
   | AddExp '+' MulExp {
     auto ast = new AddExpAST();
@@ -343,7 +390,7 @@ AddExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value + ast->exp_3->value;
-    structure +="\nAddExp: AddExp AddOp MulExp";
+    TRACE("AddExp: AddExp AddOp MulExp");
   }
   ;
 
@@ -355,7 +402,7 @@ MulExp
     ast->exp_3 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_3->value;
-    structure +="\nMulExp: Null Null UnaryExp";
+    TRACE("MulExp: Null Null UnaryExp");
   }
   | MulExp '*' UnaryExp {
     auto ast = new MulExpAST();
@@ -365,7 +412,7 @@ MulExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value * ast->exp_3->value;
-    structure +="\nMulExp: MulExp MulOp UnaryExp";
+    TRACE("MulExp: MulExp MulOp UnaryExp");
   }
   | MulExp '/' UnaryExp {
     auto ast = new MulExpAST();
@@ -375,7 +422,7 @@ MulExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value / ast->exp_3->value;
-    structure +="\nMulExp: MulExp MulOp UnaryExp";
+    TRACE("MulExp: MulExp MulOp UnaryExp");
   }
   | MulExp '%' UnaryExp {
     auto ast = new MulExpAST();
@@ -385,7 +432,7 @@ MulExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value % ast->exp_3->value;
-    structure +="\nMulExp: MulExp MulOp UnaryExp";
+    TRACE("MulExp: MulExp MulOp UnaryExp");
   }
   ;
 
@@ -397,7 +444,7 @@ RelExp
     ast->exp_3 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_3->value;
-    structure +="\nRelExp: Null Null AddExp";
+    TRACE("RelExp: Null Null AddExp");
   }
   | RelExp '<' AddExp {
     auto ast = new RelExpAST();
@@ -407,7 +454,7 @@ RelExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value < ast->exp_3->value;
-    structure +="\nRelExp: RelExp RelOp AddExp";
+    TRACE("RelExp: RelExp RelOp AddExp");
   }
   | RelExp '>' AddExp {
     auto ast = new RelExpAST();
@@ -417,27 +464,27 @@ RelExp
     ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value > ast->exp_3->value;
-    structure +="\nRelExp: RelExp RelOp AddExp";
+    TRACE("RelExp: RelExp RelOp AddExp");
   }
-  | RelExp '<' '=' AddExp {
+  | RelExp LE AddExp {
     auto ast = new RelExpAST();
     ast->op = "<=";
     ast->exp_1 = unique_ptr<BaseAST>($1);
     // ast->op_2 = unique_ptr<BaseAST>($2);
-    ast->exp_3 = unique_ptr<BaseAST>($4);
+    ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value <= ast->exp_3->value;
-    structure +="\nRelExp: RelExp RelOp AddExp";
+    TRACE("RelExp: RelExp RelOp AddExp");
   }
-  | RelExp '>' '=' AddExp {
+  | RelExp GE AddExp {
     auto ast = new RelExpAST();
     ast->op = ">=";
     ast->exp_1 = unique_ptr<BaseAST>($1);
     // ast->op_2 = unique_ptr<BaseAST>($2);
-    ast->exp_3 = unique_ptr<BaseAST>($4);
+    ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value >= ast->exp_3->value;
-    structure +="\nRelExp: RelExp RelOp AddExp";
+    TRACE("RelExp: RelExp RelOp AddExp");
   }
   ;
 
@@ -449,27 +496,27 @@ EqExp
     ast->exp_3 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_3->value;
-    structure +="\nEqExp: Null Null RelExp";
+    TRACE("EqExp: Null Null RelExp");
   }
-  | EqExp '=' '=' RelExp {
+  | EqExp EQ RelExp {
     auto ast = new EqExpAST();
     ast->op = "==";
     ast->exp_1 = unique_ptr<BaseAST>($1);
     // ast->op_2 = unique_ptr<BaseAST>($2);
-    ast->exp_3 = unique_ptr<BaseAST>($4);
+    ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value == ast->exp_3->value;
-    structure +="\nEqExp: EqExp EqOp RelExp";
+    TRACE("EqExp: EqExp EqOp RelExp");
   }
-  | EqExp '!' '=' RelExp {
+  | EqExp NE RelExp {
     auto ast = new EqExpAST();
     ast->op = "!=";
     ast->exp_1 = unique_ptr<BaseAST>($1);
     // ast->op_2 = unique_ptr<BaseAST>($2);
-    ast->exp_3 = unique_ptr<BaseAST>($4);
+    ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value != ast->exp_3->value;
-    structure +="\nEqExp: EqExp EqOp RelExp";
+    TRACE("EqExp: EqExp EqOp RelExp");
   }
   ;
 
@@ -481,17 +528,17 @@ LAndExp
     ast->exp_3 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_3->value;
-    structure +="\nLAndExp: Null Null EqExp";
+    TRACE("LAndExp: Null Null EqExp");
   }
-  | LAndExp '&' '&' EqExp {
+  | LAndExp AND EqExp {
     auto ast = new LAndExpAST();
     ast->op = "&&";
     ast->exp_1 = unique_ptr<BaseAST>($1);
     // ast->op_2 = unique_ptr<BaseAST>($2);
-    ast->exp_3 = unique_ptr<BaseAST>($4);
+    ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value && ast->exp_3->value;
-    structure +="\nLAndExp: LAndExp LAndOp EqExp";
+    TRACE("LAndExp: LAndExp LAndOp EqExp");
   }
   ;
 
@@ -503,17 +550,17 @@ LOrExp
     ast->exp_3 = unique_ptr<BaseAST>($2);
     $$ = ast;
     ast->value = ast->exp_3->value;
-    structure +="\nLOrExp: Null Null LAndExp";
+    TRACE("LOrExp: Null Null LAndExp");
   }
-  | LOrExp '|' '|' LAndExp {
+  | LOrExp OR LAndExp {
     auto ast = new LOrExpAST();
     ast->op = "||";
     ast->exp_1 = unique_ptr<BaseAST>($1);
     // ast->op_2 = unique_ptr<BaseAST>($2);
-    ast->exp_3 = unique_ptr<BaseAST>($4);
+    ast->exp_3 = unique_ptr<BaseAST>($3);
     $$ = ast;
     ast->value = ast->exp_1->value || ast->exp_3->value;
-    structure +="\nLOrExp: LOrExp LOrOp LAndExp";
+    TRACE("LOrExp: LOrExp LOrOp LAndExp");
   }
   ;
 
@@ -523,7 +570,7 @@ Number
     ast->int_const = ($1);
     $$ = ast;
     ast->value = ast->int_const;
-    structure +="\nNumber";
+    TRACE("Number");
   }
   ;
 
@@ -532,19 +579,19 @@ Number
 //     auto ast = new UnaryOpAST();
 //     ast->op = '+';
 //     $$ = ast;
-//     structure +="\nUnaryOp: +";
+//     TRACE("UnaryOp: +");
 //   }
 //   | '-' {
 //     auto ast = new UnaryOpAST();
 //     ast->op = '-';
 //     $$ = ast;
-//     structure +="\nUnaryOp: -";
+//     TRACE("UnaryOp: -");
 //   }
 //   | '!' {
 //     auto ast = new UnaryOpAST();
 //     ast->op = '!';
 //     $$ = ast;
-//     structure +="\nUnaryOp: !";
+//     TRACE("UnaryOp: !");
 //   }
 //   ;
 
@@ -553,13 +600,13 @@ Number
 //     auto ast = new AddOpAST();
 //     ast->op = '+';
 //     $$ = ast;
-//     structure +="\nAddOp: +";
+//     TRACE("AddOp: +");
 //   }
 //   | '-' {
 //     auto ast = new AddOpAST();
 //     ast->op = '-';
 //     $$ = ast;
-//     structure +="\nAddOp: -";
+//     TRACE("AddOp: -");
 //   }
 //   ;
 
@@ -568,19 +615,19 @@ Number
 //     auto ast = new MulOpAST();
 //     ast->op = '*';
 //     $$ = ast;
-//     structure +="\nMulOp: *";
+//     TRACE("MulOp: *");
 //   }
 //   | '/' {
 //     auto ast = new MulOpAST();
 //     ast->op = '/';
 //     $$ = ast;
-//     structure +="\nMulOp: /";
+//     TRACE("MulOp: /");
 //   }
 //   | '%' {
 //     auto ast = new MulOpAST();
 //     ast->op = '%';
 //     $$ = ast;
-//     structure +="\nMulOp: %%";
+//     TRACE("MulOp: %%");
 //   }
 //   ;
 
@@ -589,25 +636,25 @@ Number
 //     auto ast = new RelOpAST();
 //     ast->op = '<';
 //     $$ = ast;
-//     structure +="\nRelOp: <";
+//     TRACE("RelOp: <");
 //   }
 //   | '>' {
 //     auto ast = new RelOpAST();
 //     ast->op = '>';
 //     $$ = ast;
-//     structure +="\nRelOp: >";
+//     TRACE("RelOp: >");
 //   }
 //   | '<' '=' {
 //     auto ast = new RelOpAST();
 //     ast->op = "<=";
 //     $$ = ast;
-//     structure +="\nRelOp: <=";
+//     TRACE("RelOp: <=");
 //   }
 //   | '>' '=' {
 //     auto ast = new RelOpAST();
 //     ast->op = ">=";
 //     $$ = ast;
-//     structure +="\nRelOp: >=";
+//     TRACE("RelOp: >=");
 //   }
 //   ;
 
@@ -616,13 +663,13 @@ Number
 //     auto ast = new EqOpAST();
 //     ast->op = "==";
 //     $$ = ast;
-//     structure +="\nEqOp: ==";
+//     TRACE("EqOp: ==");
 //   }
 //   | '!' '=' {
 //     auto ast = new EqOpAST();
 //     ast->op = "!=";
 //     $$ = ast;
-//     structure +="\nEqOp: !=";
+//     TRACE("EqOp: !=");
 //   }
 //   ;
 
@@ -631,7 +678,7 @@ Number
 //     auto ast = new LAndOpAST();
 //     ast->op = "&&";
 //     $$ = ast;
-//     structure +="\nLAndOp: &&";
+//     TRACE("LAndOp: &&");
 //   }
 //   ;
 
@@ -640,7 +687,7 @@ Number
 //     auto ast = new LOrOpAST();
 //     ast->op = "||";
 //     $$ = ast;
-//     structure +="\nLOrOp: ||";
+//     TRACE("LOrOp: ||");
 //   }
 //   ;
 
@@ -656,13 +703,13 @@ Decl
     auto ast = new DeclAST();
     ast->const_decl_or_var_decl = unique_ptr<BaseAST>($1);
     $$ = ast;
-    structure +="\nDecl: ConstDecl";
+    TRACE("Decl: ConstDecl");
   }
   // | VarDecl {
   //   auto ast = new DeclAST();
   //   ast->const_decl_or_var_decl = unique_ptr<BaseAST>($1);
   //   $$ = ast;
-  //   structure +="\nDecl: VarDecl";
+  //   TRACE("Decl: VarDecl");
   // }
   ;
 
@@ -673,7 +720,7 @@ VarDecl
     ast->var_def = unique_ptr<BaseAST>($2);
     ast->comma_var_defs = unique_ptr<BaseAST>($3);
     $$ = ast;
-    structure +="\nVarDecl: BType VarDef CommaVarDefs ';'";
+    TRACE("VarDecl: BType VarDef CommaVarDefs ';'");
   }
   ;
 
@@ -683,28 +730,28 @@ CommaVarDefs
     ast->var_def = unique_ptr<BaseAST>($2);
     ast->comma_var_defs = unique_ptr<BaseAST>($3);
     $$ = ast;  
-    structure +="\nCommaVarDefs: ',' VarDef CommaVarDefs";
+    TRACE("CommaVarDefs: ',' VarDef CommaVarDefs");
   }
   | Null Null {
     auto ast = new CommaVarDefsAST();
     ast->var_def = unique_ptr<BaseAST>($1);
     ast->comma_var_defs = unique_ptr<BaseAST>($2);
     $$ = ast;  
-    structure +="\nCommaVarDefs: Null Null";
+    TRACE("CommaVarDefs: Null Null");
   }
   ;
 
 VarDef
   : IDENT BracketConstExps Null {
     auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1.str();
     ast->bracket_const_exps = unique_ptr<BaseAST>($2);
     ast->init_val = unique_ptr<BaseAST>($3);
     $$ = ast;  
   }
   | IDENT BracketConstExps '=' InitVal {
     auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1.str();
     ast->bracket_const_exps = unique_ptr<BaseAST>($2);
     ast->init_val = unique_ptr<BaseAST>($4);
     $$ = ast;  
@@ -740,7 +787,7 @@ ConstDecl
     ast->const_def = unique_ptr<BaseAST>($3);
     ast->comma_const_defs = unique_ptr<BaseAST>($4);
     $$ = ast;
-    structure +="\nConstDecl: CONST BType ConstDef CommaConstDefs ';'";
+    TRACE("ConstDecl: CONST BType ConstDef CommaConstDefs ';'");
   }
   ;
 
@@ -750,7 +797,7 @@ CommaConstDefs
     ast->const_def = unique_ptr<BaseAST>($2);
     ast->comma_const_defs = unique_ptr<BaseAST>($3);
     $$ = ast;
-    structure +="\nCommaConstDefs: ',' ConstDef CommaConstDefs";
+    TRACE("CommaConstDefs: ',' ConstDef CommaConstDefs");
   }
   | Null Null {
     auto ast = new CommaConstDefsAST();
@@ -771,7 +818,7 @@ BType
 ConstDef
   : IDENT BracketConstExps '=' ConstInitVal {
     auto ast = new ConstDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1.str();
     ast->bracket_const_exps = unique_ptr<BaseAST>($2);
     ast->const_init_val = unique_ptr<BaseAST>($4);
     $$ = ast;
@@ -838,10 +885,10 @@ BlockItem
 LVal
   : IDENT {
     auto ast = new LValAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1.str();
     // ast->bracket_exps = unique_ptr<BaseAST>($2);
     $$ = ast;
-    structure +="\nLVal: IDENT Null";
+    TRACE("LVal: IDENT Null");
   }
   ;
   
@@ -851,7 +898,7 @@ ConstExp
     ast->exp = unique_ptr<BaseAST>($1);
     $$ = ast;
     ast->value = ast->exp->value;
-    structure +="\nConstExp: Exp";
+    TRACE("ConstExp: Exp");
   }
   ;
 // 8
@@ -883,7 +930,7 @@ FuncFParam
   : BType IDENT {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2.str();
     $$ = ast;
   }
   ;
@@ -986,7 +1033,7 @@ BracketExps
 
 // 定义错误处理函数, 其中第二个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(unique_ptr<BaseAST> &ast, string s) {
-  cerr << "--> error: \n       " << structure << endl;
-  cerr << endl;
+void yyerror(unique_ptr<BaseAST> &ast, yyscan_t scanner, const char *s) {
+  diagnostics() << "--> error: " << s << "\n       " << context().structure << endl;
+  diagnostics() << endl;
 }
@@ -0,0 +1,49 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0) threads = hardwareThreads();
+  for (int i = 0; i < threads; i++) workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  has_task.notify_all();
+  for (auto& worker : workers) worker.join();
+}
+
+int ThreadPool::hardwareThreads() {
+  int n = std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  has_task.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  all_done.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void ThreadPool::work() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    has_task.wait(lock, [this] { return stopping || !tasks.empty(); });
+    if (tasks.empty()) return;  // stopping and nothing left
+    auto task = std::move(tasks.front());
+    tasks.pop_front();
+    running++;
+    lock.unlock();
+    task();
+    lock.lock();
+    running--;
+    if (tasks.empty() && running == 0) all_done.notify_all();
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool with a fixed number of threads. Tasks start in the order they were
+// submitted; wait blocks until all of them are done.
+class ThreadPool {
+  public:
+    // threads <= 0 uses one per core
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+    int size() const { return workers.size(); }
+
+    static int hardwareThreads();
+
+  private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable has_task, all_done;
+    int running = 0;
+    bool stopping = false;
+
+    void work();
+};
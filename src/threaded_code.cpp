@@ -0,0 +1,318 @@
+#include "threaded_code.h"
+
+#include <unordered_map>
+#include "purity.h"
+#include "runtime.h"
+
+namespace interp {
+namespace {
+using namespace ir;
+
+// Turns a CompactModule into a Program. Errors name the first thing that
+// cannot be run.
+class Decoder {
+ public:
+  Decoder(const CompactModule& m, Program& program) : m(m), program(program) {}
+  bool decode(string& error);
+
+ private:
+  const CompactModule& m;
+  Program& program;
+  unordered_map<string, int> function_index; // name without '@'
+
+  // per function
+  Function* fn;
+  unordered_map<uint32_t, int32_t> value_slots;
+  unordered_map<int32_t, int32_t> const_slots;
+  unordered_map<uint32_t, bool> vectors;
+  vector<pair<size_t, uint32_t>> fixups;   // code index, label ID
+  unordered_map<uint32_t, int32_t> blocks; // label ID -> code index
+  int32_t max_args;
+
+  void layoutData();
+  bool decodeFunction(const CompactModule::FunctionRange& range, string& error);
+  int32_t constant(int32_t v);
+  bool slot(Operand op, int32_t& s, string& error);
+  bool emit(const Inst& inst, string& error);
+};
+
+void Decoder::layoutData() {
+  auto& data = program.data;
+  uint32_t depth = 0;
+  for (uint32_t i = 0; i < m.insts.size(); i++) {
+    auto& inst = m.insts[i];
+    if (inst.op_code == OpCode::FUNCTION_BEGIN) depth++;
+    if (inst.op_code == OpCode::FUNCTION_END) depth--;
+    if (depth) continue;
+    switch (inst.op_code) {
+      case OpCode::DATA_BEGIN:
+        program.globals[m.labelName(inst.label)] = data.size() * 4;
+        break;
+      case OpCode::DATA_WORD:
+        data.push_back(inst.op1.isImm() ? m.immValue(inst.op1) : 0);
+        break;
+      case OpCode::DATA_SPACE: {
+        int32_t bytes = inst.op1.isImm() ? m.immValue(inst.op1) : 0;
+        data.resize(data.size() + (max(bytes, 0) + 3) / 4);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+int32_t Decoder::constant(int32_t v) {
+  auto [it, inserted] = const_slots.emplace(v, fn->consts.size());
+  if (inserted) fn->consts.push_back(v);
+  return it->second;
+}
+
+bool Decoder::slot(Operand op, int32_t& s, string& error) {
+  if (op.isNull()) {
+    s = 0;
+    return true;
+  }
+  if (op.isImm()) {
+    s = constant(m.immValue(op));
+    return true;
+  }
+  auto& name = m.valueName(op);
+  int c;
+  if (OpName(name).get_const(c)) {
+    s = constant(c);
+    return true;
+  }
+  if (name[0] == '@') {
+    auto it = program.globals.find(name);
+    if (it == program.globals.end()) {
+      error = "unknown global " + name;
+      return false;
+    }
+    s = constant(it->second);
+    return true;
+  }
+  // values are numbered after the constants, see decodeFunction
+  auto [it, inserted] = value_slots.emplace(op.payload(), fn->frame_size);
+  if (inserted) fn->frame_size += vectors.count(op.payload()) ? VLMAX : 1;
+  s = it->second;
+  return true;
+}
+
+bool Decoder::emit(const Inst& inst, string& error) {
+  static const unordered_map<OpCode, Handler> simple = {
+      {OpCode::MOV, H_MOV},     {OpCode::PHI_MOV, H_MOV},
+      {OpCode::ADD, H_ADD},     {OpCode::SUB, H_SUB},
+      {OpCode::MUL, H_MUL},     {OpCode::DIV, H_DIV},
+      {OpCode::MOD, H_MOD},     {OpCode::AND, H_AND},
+      {OpCode::OR, H_OR},       {OpCode::EQ, H_EQ},
+      {OpCode::NE, H_NE},       {OpCode::LT, H_LT},
+      {OpCode::GT, H_GT},       {OpCode::LE, H_LE},
+      {OpCode::GE, H_GE},       {OpCode::SAL, H_SAL},
+      {OpCode::SAR, H_SAR},     {OpCode::cmp, H_CMP},
+      {OpCode::MOVEQ, H_MOVEQ}, {OpCode::MOVNE, H_MOVNE},
+      {OpCode::MOVLT, H_MOVLT}, {OpCode::MOVGT, H_MOVGT},
+      {OpCode::MOVLE, H_MOVLE}, {OpCode::MOVGE, H_MOVGE},
+      {OpCode::LOAD, H_LOAD},   {OpCode::MALLOC_IN_STACK, H_ALLOC},
+      {OpCode::RET, H_RET},     {OpCode::VSETVL, H_VSETVL},
+      {OpCode::VLOAD, H_VLOAD}, {OpCode::VREDSUM, H_VREDSUM},
+  };
+  static const unordered_map<OpCode, Handler> jumps = {
+      {OpCode::jm, H_JM},   {OpCode::JEQ, H_JEQ}, {OpCode::JNE, H_JNE},
+      {OpCode::JLT, H_JLT}, {OpCode::JGT, H_JGT}, {OpCode::JLE, H_JLE},
+      {OpCode::JGE, H_JGE},
+  };
+
+  Code code{nullptr, 0, 0, 0, 0};
+  auto operands = [&](Operand a, Operand b, Operand c) {
+    return slot(a, code.a, error) && slot(b, code.b, error) &&
+           slot(c, code.c, error);
+  };
+  auto push = [&](Handler h) {
+    code.handler = reinterpret_cast<const void*>(uintptr_t(h));
+    fn->code.push_back(code);
+    return true;
+  };
+
+  switch (inst.op_code) {
+    case OpCode::LABEL:
+      blocks[inst.label] = fn->code.size();
+      fn->labels.push_back({int32_t(fn->code.size()), m.labelName(inst.label)});
+      return true;
+    case OpCode::INFO:
+    case OpCode::NOOP:
+      return true;
+    case OpCode::STORE:
+      return operands(inst.op1, inst.op2, inst.op3) && push(H_STORE);
+    case OpCode::VSTORE:
+      return operands(inst.op1, inst.op2, inst.op3) && push(H_VSTORE);
+    case OpCode::VADD:
+    case OpCode::VSUB:
+    case OpCode::VMUL: {
+      bool scalar = !(inst.op2.isValue() && vectors.count(inst.op2.payload()));
+      int k = inst.op_code == OpCode::VADD ? 0 : inst.op_code == OpCode::VSUB ? 1 : 2;
+      return operands(inst.dest, inst.op1, inst.op2) &&
+             push(Handler((scalar ? H_VADDX : H_VADD) + k));
+    }
+    case OpCode::SET_ARG: {
+      // the dest is the argument's position; the slot is fixed up once
+      // the frame size is known
+      if (!inst.dest.isImm() || m.immValue(inst.dest) < 0) {
+        error = "bad argument index";
+        return false;
+      }
+      int32_t k = m.immValue(inst.dest);
+      max_args = max(max_args, k + 1);
+      code.a = -1 - k;
+      return slot(inst.op1, code.b, error) && push(H_SET_ARG);
+    }
+    case OpCode::call: {
+      string callee = inst.label == Inst::NO_LABEL ? "" : m.labelName(inst.label);
+      if (!callee.empty() && callee[0] == '@') callee = callee.substr(1);
+      auto it = function_index.find(callee);
+      if (it != function_index.end()) {
+        code.d = it->second;
+      } else {
+        int b = runtime::find(callee);
+        if (b < 0) {
+          error = "call to undefined function @" + callee;
+          return false;
+        }
+        code.d = -1 - b;
+      }
+      code.c = -1;  // outgoing arguments, fixed up like SET_ARG
+      if (inst.dest.isNull()) {
+        code.a = -2;  // scratch
+        return push(H_CALL);
+      }
+      return slot(inst.dest, code.a, error) && push(H_CALL);
+    }
+    default:
+      break;
+  }
+  auto jump = jumps.find(inst.op_code);
+  if (jump != jumps.end()) {
+    fixups.push_back({fn->code.size(), inst.label});
+    return push(jump->second);
+  }
+  auto h = simple.find(inst.op_code);
+  if (h == simple.end()) {
+    error = "cannot run instruction " + to_string(int(inst.op_code));
+    return false;
+  }
+  return operands(inst.dest, inst.op1, inst.op2) && push(h->second);
+}
+
+bool Decoder::decodeFunction(const CompactModule::FunctionRange& range,
+                             string& error) {
+  value_slots.clear();
+  const_slots.clear();
+  vectors.clear();
+  fixups.clear();
+  blocks.clear();
+  max_args = 0;
+
+  // constants and values share a numbering while decoding; values are
+  // moved after the constants at the end
+  const int32_t VALUE_BASE = 1 << 24;
+  fn->frame_size = VALUE_BASE;
+  constant(0);
+  for (uint32_t i = range.begin; i < range.end; i++) {
+    auto op = m.insts[i].op_code;
+    if ((op == OpCode::VLOAD || op == OpCode::VADD || op == OpCode::VSUB ||
+         op == OpCode::VMUL) && m.insts[i].dest.isValue()) {
+      vectors[m.insts[i].dest.payload()] = true;
+    }
+  }
+  auto header = m.insts[range.begin].label;
+  for (auto& param : functionParams(IR(OpCode::FUNCTION_BEGIN,
+                                       header == Inst::NO_LABEL ? "" : m.labelName(header)))) {
+    // a parameter the body never mentions is copied to the scratch slot
+    Operand op = m.findValue(param);
+    int32_t s = -2;
+    if (!op.isNull() && !slot(op, s, error)) return false;
+    fn->params.push_back(s);
+  }
+  for (uint32_t i = range.begin + 1; i + 1 < range.end; i++) {
+    if (!emit(m.insts[i], error)) return false;
+  }
+  // falling off the end returns 0, like a void function
+  fn->code.push_back({reinterpret_cast<const void*>(uintptr_t(H_RET)), 0, 0, 0, 0});
+
+  for (auto [at, label] : fixups) {
+    auto it = blocks.find(label);
+    if (it == blocks.end()) {
+      error = "jump to unknown block " + m.labelName(label);
+      return false;
+    }
+    fn->code[at].d = it->second;
+  }
+
+  int32_t consts = fn->consts.size();
+  int32_t values = fn->frame_size - VALUE_BASE;
+  int32_t out_args = consts + values;
+  int32_t scratch = out_args + max_args;
+  fn->frame_size = scratch + 1;
+  auto relocate = [&](int32_t& s) {
+    if (s >= VALUE_BASE) s = s - VALUE_BASE + consts;
+  };
+  for (auto& p : fn->params) p == -2 ? p = scratch : (relocate(p), p);
+  for (auto& code : fn->code) {
+    auto h = Handler(reinterpret_cast<uintptr_t>(code.handler));
+    if (h == H_SET_ARG) {
+      code.a = out_args + (-1 - code.a);
+    } else {
+      relocate(code.a);
+    }
+    relocate(code.b);
+    if (h == H_CALL) {
+      code.c = out_args;
+      if (code.a == -2) code.a = scratch;
+    } else {
+      relocate(code.c);
+    }
+  }
+  return true;
+}
+
+bool Decoder::decode(string& error) {
+  layoutData();
+  if (program.data.size() > MEMORY_BYTES / 4) {
+    error = "globals do not fit in " + to_string(MEMORY_BYTES >> 20) + " MiB";
+    return false;
+  }
+  program.functions.resize(m.functions.size());
+  for (size_t k = 0; k < m.functions.size(); k++) {
+    program.functions[k].name = m.labelName(m.functions[k].name);
+    function_index[program.functions[k].name] = k;
+  }
+  auto main_fn = function_index.find("main");
+  if (main_fn == function_index.end()) {
+    error = "no @main";
+    return false;
+  }
+  program.main_index = main_fn->second;
+  for (size_t k = 0; k < m.functions.size(); k++) {
+    fn = &program.functions[k];
+    if (!decodeFunction(m.functions[k], error)) {
+      error += " in @" + fn->name;
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool decode(const CompactModule& m, Program& program, string& error) {
+  return Decoder(m, program).decode(error);
+}
+
+void readBack(const Program& program, const int32_t* memory, Readback& readback) {
+  readback.words.clear();
+  auto it = program.globals.find(readback.global);
+  if (it == program.globals.end()) return;
+  size_t first = it->second / 4;
+  if (first + readback.count > program.data.size()) return;
+  readback.words.assign(memory + first, memory + first + readback.count);
+}
+}  // namespace interp
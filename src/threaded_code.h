@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "compact_ir.h"
+#include "interp.h"
+
+// The decoded form of a module that -run interprets and -jit compiles: per
+// function, an array of instructions whose operands are frame slots.
+namespace interp {
+    const int VLMAX = 4;                      // 32-bit elements in a 128-bit vector
+    const uint32_t MEMORY_BYTES = 64u << 20;  // globals, then stack arrays
+
+    // Handler numbers. decode() leaves them in Code::handler; the interpreter
+    // swaps in its label addresses, the JIT reads them with handlerOf().
+    enum Handler {
+        H_MOV, H_ADD, H_SUB, H_MUL, H_DIV, H_MOD, H_AND, H_OR,
+        H_EQ, H_NE, H_LT, H_GT, H_LE, H_GE, H_SAL, H_SAR,
+        H_CMP, H_JM, H_JEQ, H_JNE, H_JLT, H_JGT, H_JLE, H_JGE,
+        H_MOVEQ, H_MOVNE, H_MOVLT, H_MOVGT, H_MOVLE, H_MOVGE,
+        H_LOAD, H_STORE, H_ALLOC, H_SET_ARG, H_CALL, H_RET,
+        H_VSETVL, H_VLOAD, H_VSTORE, H_VADD, H_VSUB, H_VMUL,
+        H_VADDX, H_VSUBX, H_VMULX, H_VREDSUM,
+        HANDLER_COUNT,
+    };
+
+    // one threaded-code instruction; a, b, c are frame slots unless noted
+    struct Code {
+        const void* handler;
+        int32_t a, b, c;
+        // jump target (index into code), or the callee: a function index,
+        // or -1 - runtime::Builtin
+        int32_t d;
+    };
+
+    // Frame layout: [constants | values | outgoing arguments | scratch].
+    // Slot 0 is the constant 0, which also stands for a missing operand.
+    struct Function {
+        string name;
+        vector<Code> code;
+        vector<int32_t> consts;
+        vector<int32_t> params;  // slots the arguments are copied to
+        int32_t frame_size = 0;
+        vector<pair<int32_t, string>> labels;  // (code index, block label)
+    };
+
+    struct Program {
+        vector<Function> functions;
+        vector<int32_t> data;  // initial memory: the globals
+        int main_index = -1;
+        unordered_map<string, int32_t> globals;  // name -> address
+    };
+
+    inline Handler handlerOf(const Code& code) {
+        return Handler(reinterpret_cast<uintptr_t>(code.handler));
+    }
+
+    // false with the first thing that cannot be run in error
+    bool decode(const ir::CompactModule& m, Program& program, string& error);
+
+    // Fills readback.words from memory (MEMORY_BYTES of it) after a run.
+    void readBack(const Program& program, const int32_t* memory, Readback& readback);
+}  // namespace interp
@@ -0,0 +1,346 @@
+// Runs the cases in tests/ir. Each is a module in the text form IR::print
+// writes, with directives in `;` comments:
+//
+//   ; passes: licm,local_cse    --passes= for the optimized run
+//   ; stdin: 5 6                a line of input, may repeat
+//   ; stdout: 11                a line of expected output, may repeat
+//   ; stderr: bad address       text expected on stderr, which is otherwise
+//                               expected to be empty
+//   ; exit: 3                   expected exit status, 0 if not given
+//   ; check: = load %p          the optimized IR has lines containing these,
+//                               in this order
+//   ; check-not: store          and no line containing this
+//
+// The module runs as written and optimized, with -run and (on x86-64) -jit,
+// each in a child process; every run has to give the expected output and
+// status.
+//
+// usage: ir_test [-v] case.ir...   -v prints the optimized IR
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "compact_ir.h"
+#include "config.h"
+#include "context.h"
+#include "interp.h"
+#include "ir.h"
+#include "jit.h"
+#include "optimize.h"
+
+using namespace std;
+using namespace ir;
+
+namespace {
+struct Case {
+  string path;
+  IRList irs;
+  string passes;
+  string stdin_text, stdout_text;
+  vector<string> stderr_texts, checks, check_nots;
+  int exit_code = 0;
+};
+
+struct ParseError {
+  string message;
+};
+
+string trim(const string& s) {
+  size_t b = s.find_first_not_of(" \t\r");
+  if (b == string::npos) return "";
+  size_t e = s.find_last_not_of(" \t\r");
+  return s.substr(b, e - b + 1);
+}
+
+// the comma-separated operands after a mnemonic
+vector<string> splitOperands(const string& s) {
+  vector<string> out;
+  stringstream ss(s);
+  for (string item; getline(ss, item, ',');) out.push_back(trim(item));
+  return out;
+}
+
+OpName operand(const string& s) {
+  if (s.empty()) throw ParseError{"missing operand"};
+  char* end;
+  long v = strtol(s.c_str(), &end, 10);
+  if (*end == '\0') return OpName(int(v));
+  if (s[0] != '%' && s[0] != '@') throw ParseError{"bad operand '" + s + "'"};
+  return OpName(s);
+}
+
+// "base[offset]"
+void address(const string& s, OpName& base, OpName& offset) {
+  size_t open = s.find('[');
+  if (open == string::npos || s.back() != ']') throw ParseError{"bad address '" + s + "'"};
+  base = operand(trim(s.substr(0, open)));
+  offset = operand(trim(s.substr(open + 1, s.size() - open - 2)));
+}
+
+const map<string, OpCode> binary_ops = {
+    {"eq", OpCode::EQ},       {"ne", OpCode::NE},       {"add", OpCode::ADD},
+    {"sub", OpCode::SUB},     {"mul", OpCode::MUL},     {"div", OpCode::DIV},
+    {"mod", OpCode::MOD},     {"or", OpCode::OR},       {"and", OpCode::AND},
+    {"lt", OpCode::LT},       {"gt", OpCode::GT},       {"le", OpCode::LE},
+    {"ge", OpCode::GE},       {"shl", OpCode::SAL},     {"sar", OpCode::SAR},
+    {"moveq", OpCode::MOVEQ}, {"movne", OpCode::MOVNE}, {"movle", OpCode::MOVLE},
+    {"movlt", OpCode::MOVLT}, {"movge", OpCode::MOVGE}, {"movgt", OpCode::MOVGT},
+    {"vadd", OpCode::VADD},   {"vsub", OpCode::VSUB},   {"vmul", OpCode::VMUL},
+    {"vredsum", OpCode::VREDSUM},
+};
+const map<string, OpCode> unary_ops = {
+    {"mov", OpCode::MOV},
+    {"phi_mov", OpCode::PHI_MOV},
+    {"alloca", OpCode::MALLOC_IN_STACK},
+    {"vsetvl", OpCode::VSETVL},
+};
+const map<string, OpCode> jumps = {
+    {"jump", OpCode::jm}, {"jeq", OpCode::JEQ}, {"jne", OpCode::JNE}, {"jle", OpCode::JLE},
+    {"jlt", OpCode::JLT}, {"jge", OpCode::JGE}, {"jgt", OpCode::JGT},
+};
+
+// `%d = op ...`
+IR parseAssignment(const string& dest, const string& op, const string& rest) {
+  OpName d = operand(dest);
+  if (op == "call") return IR(OpCode::call, d, rest);
+  if (op == "load" || op == "vload") {
+    OpName base, offset;
+    address(rest, base, offset);
+    return IR(op == "load" ? OpCode::LOAD : OpCode::VLOAD, d, base, offset);
+  }
+  auto args = splitOperands(rest);
+  if (unary_ops.count(op) && args.size() == 1) {
+    return IR(unary_ops.at(op), d, operand(args[0]));
+  }
+  if (binary_ops.count(op) && args.size() == 2) {
+    return IR(binary_ops.at(op), d, operand(args[0]), operand(args[1]));
+  }
+  throw ParseError{"unknown instruction '" + op + "'"};
+}
+
+IR parseInstruction(const string& line, bool& in_data) {
+  if (line.compare(0, 4, "fun ") == 0) return IR(OpCode::FUNCTION_BEGIN, line);
+  if (line == "}") {
+    if (in_data) {
+      in_data = false;
+      return IR(OpCode::DATA_END);
+    }
+    return IR(OpCode::FUNCTION_END, line);
+  }
+  if (line.back() == ':') return IR(OpCode::LABEL, line.substr(0, line.size() - 1));
+
+  stringstream ss(line);
+  string first, second;
+  ss >> first >> second;
+  string rest;
+  getline(ss, rest);
+  rest = trim(rest);
+  if (first == "data") {
+    in_data = true;
+    return IR(OpCode::DATA_BEGIN, second);
+  }
+  if (first == "word") return IR(OpCode::DATA_WORD, OpName(), operand(second));
+  if (first == "space") return IR(OpCode::DATA_SPACE, OpName(), operand(second));
+  if (first == "ret") {
+    return second.empty() ? IR(OpCode::RET) : IR(OpCode::RET, OpName(), operand(second));
+  }
+  if (jumps.count(first)) return IR(jumps.at(first), second);
+  if (first == "call") return IR(OpCode::call, second);
+  if (second == "=") {
+    stringstream rs(rest);
+    string op;
+    rs >> op;
+    string args;
+    getline(rs, args);
+    return parseAssignment(first, op, trim(args));
+  }
+
+  auto args = splitOperands(trim(line.substr(first.size())));
+  if (first == "cmp" && args.size() == 2) {
+    return IR(OpCode::cmp, OpName(), operand(args[0]), operand(args[1]));
+  }
+  if (first == "arg" && args.size() == 2) {
+    return IR(OpCode::SET_ARG, operand(args[0]), operand(args[1]));
+  }
+  if ((first == "store" || first == "vstore") && args.size() == 2) {
+    OpName base, offset;
+    address(args[1], base, offset);
+    return IR(first == "store" ? OpCode::STORE : OpCode::VSTORE, OpName(), base, offset,
+              operand(args[0]));
+  }
+  throw ParseError{"unknown instruction '" + first + "'"};
+}
+
+bool parseCase(const string& path, Case& c, string& error) {
+  ifstream ifs(path);
+  if (!ifs) {
+    error = "cannot open";
+    return false;
+  }
+  c.path = path;
+  bool in_data = false;
+  int line_no = 0;
+  for (string raw; getline(ifs, raw);) {
+    line_no++;
+    string line = trim(raw);
+    if (line.empty()) continue;
+    if (line[0] == ';') {
+      size_t colon = line.find(':');
+      if (colon == string::npos) continue;
+      string key = trim(line.substr(1, colon - 1)), value = trim(line.substr(colon + 1));
+      if (key == "passes") c.passes = value;
+      else if (key == "stdin") c.stdin_text += value + "\n";
+      else if (key == "stdout") c.stdout_text += value + "\n";
+      else if (key == "stderr") c.stderr_texts.push_back(value);
+      else if (key == "exit") c.exit_code = atoi(value.c_str());
+      else if (key == "check") c.checks.push_back(value);
+      else if (key == "check-not") c.check_nots.push_back(value);
+      continue;
+    }
+    try {
+      c.irs.push_back(parseInstruction(line, in_data));
+    } catch (const ParseError& e) {
+      error = "line " + to_string(line_no) + ": " + e.message;
+      return false;
+    }
+  }
+  return true;
+}
+
+string print(const IRList& irs) {
+  stringstream ss;
+  for (auto& ir : irs) ir.print(ss);
+  return ss.str();
+}
+
+string readFile(FILE* f) {
+  string out;
+  rewind(f);
+  char buffer[4096];
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), f)) > 0;) out.append(buffer, n);
+  return out;
+}
+
+struct Result {
+  int status;
+  string out, err;
+};
+
+// runs @main in a child, so runtime errors and output stay apart from ours
+Result execute(const CompactModule& m, bool use_jit, const string& input) {
+  FILE* in = tmpfile();
+  FILE* out = tmpfile();
+  FILE* err = tmpfile();
+  fputs(input.c_str(), in);
+  fflush(in);
+  rewind(in);
+  fflush(nullptr);
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fileno(in), 0);
+    dup2(fileno(out), 1);
+    dup2(fileno(err), 2);
+    int code;
+    bool ran = use_jit ? jit::run(m, code) : interp::run(m, code);
+    exit(ran ? code : 99);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  Result r{WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status), readFile(out),
+           readFile(err)};
+  fclose(in);
+  fclose(out);
+  fclose(err);
+  return r;
+}
+
+bool checkResult(const Case& c, const string& what, const Result& r) {
+  bool ok = true;
+  auto fail = [&](const string& message) {
+    printf("FAIL %s (%s): %s\n", c.path.c_str(), what.c_str(), message.c_str());
+    ok = false;
+  };
+  if (r.status != c.exit_code) {
+    fail("exit " + to_string(r.status) + ", expected " + to_string(c.exit_code));
+  }
+  if (r.out != c.stdout_text) fail("stdout\n" + r.out + "expected\n" + c.stdout_text);
+  for (auto& text : c.stderr_texts) {
+    if (r.err.find(text) == string::npos) fail("stderr has no '" + text + "':\n" + r.err);
+  }
+  if (c.stderr_texts.empty() && !r.err.empty()) fail("stderr\n" + r.err);
+  return ok;
+}
+
+bool checkIr(const Case& c, const string& text) {
+  bool ok = true;
+  vector<string> lines;
+  stringstream ss(text);
+  for (string line; getline(ss, line);) lines.push_back(line);
+  size_t next = 0;
+  for (auto& check : c.checks) {
+    while (next < lines.size() && lines[next].find(check) == string::npos) next++;
+    if (next == lines.size()) {
+      printf("FAIL %s: no '%s' in order in\n%s", c.path.c_str(), check.c_str(), text.c_str());
+      return false;
+    }
+    next++;
+  }
+  for (auto& check : c.check_nots) {
+    if (text.find(check) != string::npos) {
+      printf("FAIL %s: '%s' in\n%s", c.path.c_str(), check.c_str(), text.c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool runCase(const string& path, bool verbose) {
+  Case c;
+  string error;
+  if (!parseCase(path, c, error)) {
+    printf("FAIL %s: %s\n", path.c_str(), error.c_str());
+    return false;
+  }
+  CompilationContext ctx;
+  CompilationContext::Scope scope(ctx);
+  IRList optimized = c.irs;
+  config::passes = c.passes;
+  config::rvv = c.passes.find("loop_vectorize") != string::npos;
+  if (!c.passes.empty()) optimize(optimized);
+  string text = print(optimized);
+  if (verbose) printf("%s:\n%s", path.c_str(), text.c_str());
+
+  bool ok = checkIr(c, text);
+  vector<pair<string, bool>> executors = {{"run", false}};
+#if defined(__x86_64__)
+  executors.push_back({"jit", true});
+#endif
+  for (auto& [name, use_jit] : executors) {
+    ok &= checkResult(c, name + ", as written",
+                      execute(CompactModule::fromList(c.irs), use_jit, c.stdin_text));
+    ok &= checkResult(c, name + ", optimized",
+                      execute(CompactModule::fromList(optimized), use_jit, c.stdin_text));
+  }
+  return ok;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool verbose = false;
+  int failed = 0, total = 0;
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "-v") {
+      verbose = true;
+      continue;
+    }
+    total++;
+    if (!runCase(argv[i], verbose)) failed++;
+  }
+  printf("ir_test: %d of %d cases passed\n", total - failed, total);
+  return failed ? 1 : 0;
+}
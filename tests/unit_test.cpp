@@ -0,0 +1,226 @@
+// Golden and round-trip checks for the pieces whose output is stored or
+// compared across runs: the XXH64 hash, the binary IR image, cache keys and
+// the hand-written lexer against the Flex one.
+//
+// usage: unit_test
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "compact_ir.h"
+#include "config.h"
+#include "hash.h"
+#include "ir.h"
+#include "ir_image.h"
+#include "lexer.h"
+#include "source_buffer.h"
+#include "sysy.tab.hpp"
+
+int yylex(YYSTYPE *yylval, yyscan_t scanner);
+namespace lexer {
+int lex(YYSTYPE *yylval, yyscan_t scanner);
+}
+
+using namespace std;
+using namespace ir;
+
+namespace {
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);          \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+// published XXH64 values (xxHash and python-xxhash test suites)
+void testHash() {
+  struct Vector {
+    const char* text;
+    uint64_t seed;
+    uint64_t hash;
+  };
+  const Vector vectors[] = {
+      {"", 0, 0xef46db3751d8e999ULL},
+      {"a", 0, 0xd24ec4f1a98c6e5bULL},
+      {"abc", 0, 0x44bc2cf5ad770999ULL},
+      {"xxhash", 0, 0x32dd38952c4bc720ULL},
+      {"xxhash", 20141025, 0xb559b98d844e0635ULL},
+      // over 32 bytes, through the four-lane loop
+      {"Nobody inspects the spammish repetition", 0, 0xfbcea83c8a378bf1ULL},
+  };
+  for (auto& v : vectors) CHECK(xxh64(string_view(v.text), v.seed) == v.hash);
+  CHECK(toHex(0xef46db3751d8e999ULL) == "ef46db3751d8e999");
+  CHECK(toHex(1) == "0000000000000001");
+}
+
+IRList sampleModule() {
+  IRList irs;
+  irs.push_back(IR(OpCode::DATA_BEGIN, "@g"));
+  irs.push_back(IR(OpCode::DATA_WORD, OpName(), OpName(1 << 30)));
+  irs.push_back(IR(OpCode::DATA_SPACE, OpName(), OpName(8)));
+  irs.push_back(IR(OpCode::DATA_END));
+  irs.push_back(IR(OpCode::FUNCTION_BEGIN, "fun @main(): i32 {"));
+  irs.push_back(IR(OpCode::LABEL, "%_b_0"));
+  irs.push_back(IR(OpCode::call, OpName("%n"), "@getint"));
+  irs.push_back(IR(OpCode::ADD, OpName("%x"), OpName("%n"), OpName(-(1 << 30) - 5)));
+  irs.push_back(IR(OpCode::STORE, OpName(), OpName("@g"), OpName(4), OpName("%x")));
+  irs.push_back(IR(OpCode::cmp, OpName(), OpName("%x"), OpName(0)));
+  irs.push_back(IR(OpCode::JLT, "%_b_0"));
+  irs.push_back(IR(OpCode::RET, OpName(), OpName("%x")));
+  irs.push_back(IR(OpCode::FUNCTION_END, "}"));
+  return irs;
+}
+
+string print(const IRList& irs) {
+  stringstream ss;
+  for (auto& ir : irs) ir.print(ss);
+  return ss.str();
+}
+
+// ImageView wants 8-byte aligned data
+struct Aligned {
+  vector<uint64_t> words;
+  size_t size;
+  explicit Aligned(const string& data) : words(data.size() / 8 + 1), size(data.size()) {
+    memcpy(words.data(), data.data(), size);
+  }
+  string_view view() const { return {reinterpret_cast<const char*>(words.data()), size}; }
+  char* bytes() { return reinterpret_cast<char*>(words.data()); }
+};
+
+void testImage() {
+  IRList irs = sampleModule();
+  CompactModule m = CompactModule::fromList(irs);
+  string data = encodeImage(m);
+  CHECK(isImage(data));
+
+  Aligned image(data);
+  ImageView view;
+  string error;
+  CHECK(view.open(image.view(), error));
+  CHECK(view.instCount() == m.insts.size());
+  CHECK(view.functionCount() == 1);
+  CompactModule back = view.toModule();
+  CHECK(print(back.toList()) == print(irs));
+  CHECK(encodeImage(back) == data);
+
+  // a flipped bit anywhere after the header fails the checksum
+  Aligned corrupt(data);
+  corrupt.bytes()[sizeof(ImageHeader) + 3] ^= 1;
+  CHECK(!view.open(corrupt.view(), error));
+  CHECK(!view.open(image.view().substr(0, data.size() - 8), error));
+
+  // well-formed images that toModule could not rebuild with the same IDs
+  auto rejected = [&](string bad) {
+    ImageHeader h;
+    memcpy(&h, bad.data(), sizeof(h));
+    h.checksum = xxh64(bad.data() + sizeof(h), bad.size() - sizeof(h));
+    memcpy(&bad[0], &h, sizeof(h));
+    Aligned aligned(bad);
+    return !view.open(aligned.view(), error);
+  };
+  string repeated = data;
+  repeated.replace(repeated.rfind("%x"), 2, "%n");
+  CHECK(rejected(repeated));
+  CompactModule shifted = m;
+  shifted.functions[0].begin++;
+  CHECK(rejected(encodeImage(shifted)));
+  CompactModule twice = m;
+  twice.functions.push_back(m.functions[0]);
+  CHECK(rejected(encodeImage(twice)));
+}
+
+void testCacheKey() {
+  const string source = "int main() { return 1; }";
+  string key = cache::key("-koopa", source);
+  CHECK(key.size() == 32);
+  CHECK(key.find_first_not_of("0123456789abcdef") == string::npos);
+  CHECK(cache::key("-koopa", source) == key);
+  CHECK(cache::key("-riscv", source) != key);
+  CHECK(cache::key("-koopa", source + " ") != key);
+
+  // every option that changes the output changes the key
+  auto changes = [&](auto& option, auto value) {
+    auto saved = option;
+    option = value;
+    bool changed = cache::key("-koopa", source) != key;
+    option = saved;
+    return changed;
+  };
+  CHECK(changes(config::opt_level, config::opt_level + 1));
+  CHECK(changes(config::passes, string("licm")));
+  CHECK(changes(config::rvv, !config::rvv));
+  CHECK(changes(config::memoize, !config::memoize));
+  CHECK(changes(config::memo_size, config::memo_size + 1));
+  CHECK(cache::key("-koopa", source) == key);
+}
+
+struct Token {
+  int token;
+  int int_val;
+  string text;
+  bool operator==(const Token& other) const {
+    return token == other.token && int_val == other.int_val && text == other.text;
+  }
+};
+
+vector<Token> lexAll(const string& text, bool hand) {
+  config::hand_lexer = hand;
+  SourceBuffer source;
+  source.assign(text);
+  lexer::Scanner scanner(source);
+  vector<Token> tokens;
+  YYSTYPE yylval;
+  while (int token = hand ? lexer::lex(&yylval, scanner.get()) : yylex(&yylval, scanner.get())) {
+    Token t{token, 0, ""};
+    if (token == IDENT) t.text = yylval.text_val.str();
+    if (token == INT_CONST) t.int_val = yylval.int_val;
+    tokens.push_back(t);
+  }
+  return tokens;
+}
+
+void testLexer() {
+  const char* sources[] = {
+      "",
+      "   \n\t\r  ",
+      "int main() { return 0; }",
+      "const int N = 10; void f(int a[], int b) { if (a[0] <= b && b != 3 || !b) "
+      "while (1) { break; continue; } else return; }",
+      "x>=y x<y x>y x==y x=y x%y x/y x*y x-y x+y & | !",
+      "_a1 A_ intx returnx ifelse voidint constant while_ __ aAzZ09_",
+      "0 7 010 0777 0x1f 0XAbC 0x 08 09 2147483647 2147483648 99999999999999999999",
+      "a // line comment\nb /* block\n comment */ c /**/ d /* * / */ e",
+      "a /* never closed",
+      "a // comment at the end",
+      "a/b/ /c",
+      "@ # $ ` ~ ? : ; , . [ ] ( ) { }",
+      "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789012345",
+  };
+  for (auto text : sources) {
+    auto flex = lexAll(text, false), hand = lexAll(text, true);
+    if (flex != hand) printf("lexers disagree on: %s\n", text);
+    CHECK(flex == hand);
+  }
+  config::hand_lexer = false;
+}
+}  // namespace
+
+int main() {
+  testHash();
+  testImage();
+  testCacheKey();
+  testLexer();
+  if (failures) {
+    printf("unit_test: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("unit_test: all checks passed\n");
+  return 0;
+}